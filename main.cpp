@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <signal.h>
+#include <pthread.h>
 #include "net/internet/http/server.h"
 #include "net/internet/http/version.h"
 
@@ -10,9 +11,15 @@
 
 static void print_usage(const char* program);
 static void signal_handler(int nsignal);
+static void* run_worker(void* arg);
 
 net::internet::http::server server;
 
+// Additional workers (the first worker runs in the main thread).
+static net::internet::http::server* workers = NULL;
+static pthread_t* threads = NULL;
+static unsigned nworkers = 0;
+
 int main(int argc, char** argv)
 {
 	const char* config_file = NULL;
@@ -54,12 +61,89 @@ int main(int argc, char** argv)
 	sigaction(SIGTERM, &act, NULL);
 	sigaction(SIGINT, &act, NULL);
 
-	if (!server.create(config_file ? config_file : CONFIG_FILE, mime_types_file ? mime_types_file : MIME_TYPES_FILE)) {
+	if (!config_file) {
+		config_file = CONFIG_FILE;
+	}
+
+	if (!mime_types_file) {
+		mime_types_file = MIME_TYPES_FILE;
+	}
+
+	if (!server.create(config_file, mime_types_file)) {
 		fprintf(stderr, "Couldn't create HTTP server.\n");
 		return -1;
 	}
 
-	server.start();
+	// Create the additional workers, each one with its own event loop,
+	// timers and connections. The listener sockets are either opened by each
+	// worker (SO_REUSEPORT) or shared with the first worker.
+	unsigned n = server.workers() - 1;
+	if (n > 0) {
+		if ((workers = new (std::nothrow) net::internet::http::server[n]) == NULL) {
+			fprintf(stderr, "Couldn't create workers.\n");
+			return -1;
+		}
+
+		if ((threads = (pthread_t*) malloc(n * sizeof(pthread_t))) == NULL) {
+			fprintf(stderr, "Couldn't create workers.\n");
+
+			delete [] workers;
+			return -1;
+		}
+
+		for (unsigned i = 0; i < n; i++) {
+			if (!server.reuse_port()) {
+				workers[i].share_listeners(server);
+			}
+
+			if (!workers[i].create(config_file, mime_types_file)) {
+				fprintf(stderr, "Couldn't create HTTP server.\n");
+
+				delete [] workers;
+				free(threads);
+
+				return -1;
+			}
+		}
+
+		// Block the signals in the worker threads.
+		sigset_t set, oldset;
+		sigemptyset(&set);
+		sigaddset(&set, SIGTERM);
+		sigaddset(&set, SIGINT);
+		pthread_sigmask(SIG_BLOCK, &set, &oldset);
+
+		for (; nworkers < n; nworkers++) {
+			if (pthread_create(&threads[nworkers], NULL, run_worker, &workers[nworkers]) != 0) {
+				break;
+			}
+		}
+
+		pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+		if (nworkers < n) {
+			fprintf(stderr, "Couldn't create workers.\n");
+
+			server.stop();
+		}
+	}
+
+	if (nworkers == n) {
+		server.start();
+	}
+
+	for (unsigned i = 0; i < nworkers; i++) {
+		workers[i].stop();
+	}
+
+	for (unsigned i = 0; i < nworkers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if (workers) {
+		delete [] workers;
+		free(threads);
+	}
 
 	return 0;
 }
@@ -76,3 +160,9 @@ void signal_handler(int nsignal)
 
 	server.stop();
 }
+
+void* run_worker(void* arg)
+{
+	static_cast<net::internet::http::server*>(arg)->start();
+	return NULL;
+}
@@ -5,6 +5,12 @@
 const unsigned net::iselector::READ = EPOLLIN;
 const unsigned net::iselector::WRITE = EPOLLOUT;
 
+#ifdef EPOLLEXCLUSIVE
+const unsigned net::iselector::EXCLUSIVE = EPOLLEXCLUSIVE;
+#else
+const unsigned net::iselector::EXCLUSIVE = 0;
+#endif
+
 net::selector::selector()
 {
 	_M_fd = -1;
@@ -29,11 +35,11 @@ bool net::selector::create()
 		return false;
 	}
 
-	if ((_M_fd = epoll_create(_M_fdset.size())) < 0) {
+	if ((_M_fd = epoll_create(MAX_EVENTS)) < 0) {
 		return false;
 	}
 
-	if ((_M_events = (struct epoll_event*) malloc(_M_fdset.size() * sizeof(struct epoll_event))) == NULL) {
+	if ((_M_events = (struct epoll_event*) malloc(MAX_EVENTS * sizeof(struct epoll_event))) == NULL) {
 		return false;
 	}
 
@@ -43,8 +49,9 @@ bool net::selector::create()
 bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
 {
 	if (!_M_fdset.add(fd, type, handler)) {
-		// The file descriptor has been already inserted.
-		return true;
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
 	}
 
 	struct epoll_event ev;
@@ -52,7 +59,7 @@ bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* hand
 	if (type == fdset::FD_SOCKET) {
 		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
 	} else {
-		ev.events = EPOLLIN;
+		ev.events = EPOLLIN | (events & EXCLUSIVE);
 	}
 
 	ev.data.u64 = 0;
@@ -90,12 +97,12 @@ bool net::selector::remove(unsigned fd)
 bool net::selector::process_events()
 {
 	int ret;
-	if ((ret = epoll_wait(_M_fd, _M_events, _M_fdset.size(), -1)) <= 0) {
-		post_events_wait();
+	if ((ret = epoll_wait(_M_fd, _M_events, MAX_EVENTS, -1)) <= 0) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
@@ -105,12 +112,12 @@ bool net::selector::process_events()
 bool net::selector::process_events(unsigned timeout)
 {
 	int ret;
-	if ((ret = epoll_wait(_M_fd, _M_events, _M_fdset.size(), timeout)) <= 0) {
-		post_events_wait();
+	if ((ret = epoll_wait(_M_fd, _M_events, MAX_EVENTS, timeout)) <= 0) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
@@ -3,10 +3,13 @@
 #include <sys/resource.h>
 #include "net/fdset.h"
 
+size_t net::fdset::_M_total_used = 0;
+
 net::fdset::fdset()
 {
 	_M_entries = NULL;
 	_M_size = 0;
+	_M_capacity = 0;
 	_M_used = 0;
 
 	_M_index = NULL;
@@ -19,6 +22,8 @@ net::fdset::~fdset()
 			close(_M_index[i]);
 		}
 
+		__atomic_sub_fetch(&_M_total_used, _M_used, __ATOMIC_RELAXED);
+
 		free(_M_index);
 	}
 
@@ -35,25 +40,73 @@ bool net::fdset::create()
 		return false;
 	}
 
-	if ((_M_entries = (struct fdentry*) malloc(rlim.rlim_cur * sizeof(struct fdentry))) == NULL) {
+	_M_size = rlim.rlim_cur;
+
+	// The arrays grow when a higher descriptor is added.
+	size_t capacity = (_M_size < INITIAL_CAPACITY) ? _M_size : INITIAL_CAPACITY;
+
+	if ((_M_entries = (struct fdentry*) malloc(capacity * sizeof(struct fdentry))) == NULL) {
 		return false;
 	}
 
-	if ((_M_index = (unsigned*) malloc(rlim.rlim_cur * sizeof(unsigned))) == NULL) {
+	if ((_M_index = (unsigned*) malloc(capacity * sizeof(unsigned))) == NULL) {
 		return false;
 	}
 
-	_M_size = rlim.rlim_cur;
+	_M_capacity = capacity;
 
-	for (size_t i = 0; i < _M_size; i++) {
+	for (size_t i = 0; i < _M_capacity; i++) {
 		_M_entries[i].index = -1;
 	}
 
 	return true;
 }
 
+bool net::fdset::grow(unsigned fd)
+{
+	if (fd >= _M_size) {
+		return false;
+	}
+
+	size_t capacity = _M_capacity;
+	do {
+		capacity *= 2;
+	} while (capacity <= fd);
+
+	if (capacity > _M_size) {
+		capacity = _M_size;
+	}
+
+	fdentry* entries;
+	if ((entries = (struct fdentry*) realloc(_M_entries, capacity * sizeof(struct fdentry))) == NULL) {
+		return false;
+	}
+
+	_M_entries = entries;
+
+	// The index holds at most one entry per descriptor.
+	unsigned* index;
+	if ((index = (unsigned*) realloc(_M_index, capacity * sizeof(unsigned))) == NULL) {
+		return false;
+	}
+
+	_M_index = index;
+
+	for (size_t i = _M_capacity; i < capacity; i++) {
+		_M_entries[i].index = -1;
+	}
+
+	_M_capacity = capacity;
+
+	return true;
+}
+
 bool net::fdset::add(unsigned fd, fdtype type, io::event_handler* handler)
 {
+	if ((fd >= _M_capacity) && (!grow(fd))) {
+		return false;
+	}
+
 	if (_M_entries[fd].index != -1) {
 		// Already inserted.
 		return false;
@@ -65,13 +118,15 @@ bool net::fdset::add(unsigned fd, fdtype type, io::event_handler* handler)
 
 	_M_index[_M_used++] = fd;
 
+	__atomic_add_fetch(&_M_total_used, 1, __ATOMIC_RELAXED);
+
 	return true;
 }
 
 bool net::fdset::remove(unsigned fd)
 {
 	int index;
-	if ((index = _M_entries[fd].index) == -1) {
+	if ((fd >= _M_capacity) || ((index = _M_entries[fd].index) == -1)) {
 		// Not inserted.
 		return false;
 	}
@@ -80,6 +135,8 @@ bool net::fdset::remove(unsigned fd)
 
 	_M_used--;
 
+	__atomic_sub_fetch(&_M_total_used, 1, __ATOMIC_RELAXED);
+
 	if ((size_t) index < _M_used) {
 		_M_index[index] = _M_index[_M_used];
 		_M_entries[_M_index[index]].index = index;
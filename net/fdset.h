@@ -9,7 +9,8 @@ namespace net {
 			enum fdtype {
 				FD_NONE,
 				FD_SOCKET,
-				FD_LISTENER
+				FD_LISTENER,
+				FD_NOTIFIER
 			};
 
 			// Constructor.
@@ -21,12 +22,19 @@ namespace net {
 			// Create.
 			bool create();
 
-			// Get size.
+			// Get size (maximum number of descriptors).
 			size_t size() const;
 
+			// Get capacity (the arrays grow on demand up to the size).
+			size_t capacity() const;
+
 			// Get count.
 			size_t count() const;
 
+			// Get number of descriptors in use by all the sets of the
+			// process (the workers share the descriptor limit).
+			static size_t total_count();
+
 			// Add descriptor.
 			bool add(unsigned fd, fdtype type, io::event_handler* handler);
 
@@ -46,6 +54,9 @@ namespace net {
 			int fd(unsigned index) const;
 
 		protected:
+			// Initial capacity.
+			static const size_t INITIAL_CAPACITY = 1024;
+
 			struct fdentry {
 				int index;
 				fdtype type;
@@ -54,9 +65,16 @@ namespace net {
 
 			fdentry* _M_entries;
 			size_t _M_size;
+			size_t _M_capacity;
 			size_t _M_used;
 
 			unsigned* _M_index;
+
+			// Number of descriptors in use by all the sets of the process.
+			static size_t _M_total_used;
+
+			// Grow arrays to hold the descriptor 'fd'.
+			bool grow(unsigned fd);
 	};
 
 	inline size_t fdset::size() const
@@ -64,24 +82,34 @@ namespace net {
 		return _M_size;
 	}
 
+	inline size_t fdset::capacity() const
+	{
+		return _M_capacity;
+	}
+
 	inline size_t fdset::count() const
 	{
 		return _M_used;
 	}
 
+	inline size_t fdset::total_count()
+	{
+		return __atomic_load_n(&_M_total_used, __ATOMIC_RELAXED);
+	}
+
 	inline int fdset::index(unsigned fd) const
 	{
-		return _M_entries[fd].index;
+		return (fd < _M_capacity) ? _M_entries[fd].index : -1;
 	}
 
 	inline fdset::fdtype fdset::type(unsigned fd) const
 	{
-		return (_M_entries[fd].index != -1) ? _M_entries[fd].type : FD_NONE;
+		return ((fd < _M_capacity) && (_M_entries[fd].index != -1)) ? _M_entries[fd].type : FD_NONE;
 	}
 
 	inline io::event_handler* fdset::handler(unsigned fd) const
 	{
-		return (_M_entries[fd].index != -1) ? _M_entries[fd].handler : NULL;
+		return ((fd < _M_capacity) && (_M_entries[fd].index != -1)) ? _M_entries[fd].handler : NULL;
 	}
 
 	inline int fdset::fd(unsigned index) const
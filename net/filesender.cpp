@@ -242,118 +242,135 @@
 
 		off_t net::filesender::sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, bool& want_read, bool& want_write)
 		{
-			off_t written = 0;
-
-			// If there is still data in the buffer...
-			if (!_M_output.empty()) {
-				ssize_t ret;
-				if ((ret = s.write(_M_output.data(), _M_output.length(), want_read, want_write)) < 0) {
-					return -1;
-				}
-
-				offset += ret;
-				written = ret;
-
-				_M_output.clear();
-
-				if (written == count) {
-					return count;
-				}
+		#if HAVE_KTLS
+			// Encrypted by the kernel: no copy through user space.
+			if (s.ktls_send()) {
+				return s.sendfile(f.fd(), offset, count, want_read, want_write);
 			}
+		#endif // HAVE_KTLS
 
-			void* data;
-			if ((data = mmap(NULL, filesize, PROT_READ, MAP_SHARED, f.fd(), 0)) == MAP_FAILED) {
-				want_read = false;
-				want_write = false;
-
-				return -1;
-			}
+			off_t written = 0;
 
 			do {
-				off_t bytes = MIN((off_t) READ_BUFFER_SIZE, count - written);
-				if (!_M_output.append((const char*) data + offset, bytes)) {
-					munmap(data, filesize);
-
+				size_t len;
+				const char* data;
+				if ((data = map(f, filesize, offset, len)) == NULL) {
 					want_read = false;
 					want_write = false;
 
 					return -1;
 				}
 
-				ssize_t ret;
-				if ((ret = s.write(_M_output.data(), bytes, want_read, want_write)) < 0) {
-					munmap(data, filesize);
+				// Retry the last write or write the next record.
+				size_t bytes;
+				if (_M_pending > 0) {
+					bytes = _M_pending;
+				} else {
+					bytes = MIN(MIN(RECORD_SIZE, len), (size_t) (count - written));
+				}
 
+				ssize_t ret;
+				if ((ret = s.write(data, bytes, want_read, want_write)) < 0) {
 					if ((!want_read) && (!want_write)) {
 						return -1;
 					} else {
+						_M_pending = bytes;
+
 						return (written == 0) ? -1 : written;
 					}
 				} else {
+					_M_pending = 0;
+
 					offset += ret;
 					written += ret;
-
-					_M_output.clear();
 				}
 			} while (written < count);
 
-			munmap(data, filesize);
-
 			return count;
 		}
 
 		off_t net::filesender::sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, int timeout)
 		{
-			off_t written = 0;
-
-			// If there is still data in the buffer...
-			if (!_M_output.empty()) {
-				ssize_t ret;
-				if ((ret = s.write(_M_output.data(), _M_output.length(), timeout)) < 0) {
-					return -1;
-				}
-
-				offset += ret;
-				written = ret;
-
-				_M_output.clear();
-
-				if (written == count) {
-					return count;
-				}
+		#if HAVE_KTLS
+			// Encrypted by the kernel: no copy through user space.
+			if (s.ktls_send()) {
+				return s.sendfile(f.fd(), offset, count, timeout);
 			}
+		#endif // HAVE_KTLS
 
-			void* data;
-			if ((data = mmap(NULL, filesize, PROT_READ, MAP_SHARED, f.fd(), 0)) == MAP_FAILED) {
-				return -1;
-			}
+			off_t written = 0;
 
 			do {
-				off_t bytes = MIN((off_t) READ_BUFFER_SIZE, count - written);
-				if (!_M_output.append((const char*) data + offset, bytes)) {
-					munmap(data, filesize);
+				size_t len;
+				const char* data;
+				if ((data = map(f, filesize, offset, len)) == NULL) {
 					return -1;
 				}
 
+				// Retry the last write or write the next record.
+				size_t bytes;
+				if (_M_pending > 0) {
+					bytes = _M_pending;
+					_M_pending = 0;
+				} else {
+					bytes = MIN(MIN(RECORD_SIZE, len), (size_t) (count - written));
+				}
+
 				ssize_t ret;
-				if ((ret = s.write(_M_output.data(), bytes, timeout)) < 0) {
-					munmap(data, filesize);
+				if ((ret = s.write(data, bytes, timeout)) < 0) {
 					return -1;
 				} else {
 					offset += ret;
 					written += ret;
-
-					_M_output.clear();
 				}
 			} while (written < count);
 
-			munmap(data, filesize);
-
 			return count;
 		}
+
+		const char* net::filesender::map(fs::file& f, off_t filesize, off_t offset, size_t& len)
+		{
+			// If the window doesn't contain 'offset'...
+			if ((!_M_map) || (f.fd() != _M_mapfd) || (offset < _M_mapoff) || (offset >= _M_mapoff + (off_t) _M_maplen)) {
+				unmap();
+
+				off_t off = offset - (offset % MAP_WINDOW_SIZE);
+				size_t maplen = MIN(MAP_WINDOW_SIZE, (size_t) (filesize - off));
+
+				void* data;
+				if ((data = mmap(NULL, maplen, PROT_READ, MAP_SHARED, f.fd(), off)) == MAP_FAILED) {
+					return NULL;
+				}
+
+				_M_map = data;
+				_M_maplen = maplen;
+				_M_mapoff = off;
+				_M_mapfd = f.fd();
+			}
+
+			off_t off = offset - _M_mapoff;
+			len = _M_maplen - off;
+
+			return (const char*) _M_map + off;
+		}
+
+		void net::filesender::unmap()
+		{
+			if (_M_map) {
+				munmap(_M_map, _M_maplen);
+				_M_map = NULL;
+			}
+		}
 	#else
 		off_t net::filesender::sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, bool& want_read, bool& want_write)
 		{
+		#if HAVE_KTLS
+			// Encrypted by the kernel: no copy through user space.
+			if (s.ktls_send()) {
+				return s.sendfile(f.fd(), offset, count, want_read, want_write);
+			}
+		#endif // HAVE_KTLS
+
 			off_t written = 0;
 
 			// If there is still data in the buffer...
@@ -382,7 +399,7 @@
 			}
 		#endif // !HAVE_PREAD
 
-			off_t bytes = MIN(READ_BUFFER_SIZE, count - written);
+			off_t bytes = MIN((off_t) RECORD_SIZE, count - written);
 			if (!_M_output.allocate(bytes)) {
 				want_read = false;
 				want_write = false;
@@ -418,13 +435,20 @@
 						return count;
 					}
 
-					bytes = MIN(READ_BUFFER_SIZE, count - written);
+					bytes = MIN((off_t) RECORD_SIZE, count - written);
 				}
 			} while (true);
 		}
 
 		off_t net::filesender::sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, int timeout)
 		{
+		#if HAVE_KTLS
+			// Encrypted by the kernel: no copy through user space.
+			if (s.ktls_send()) {
+				return s.sendfile(f.fd(), offset, count, timeout);
+			}
+		#endif // HAVE_KTLS
+
 			off_t written = 0;
 
 			// If there is still data in the buffer...
@@ -450,7 +474,7 @@
 			}
 		#endif // !HAVE_PREAD
 
-			off_t bytes = MIN(READ_BUFFER_SIZE, count - written);
+			off_t bytes = MIN((off_t) RECORD_SIZE, count - written);
 			if (!_M_output.allocate(bytes)) {
 				return -1;
 			}
@@ -474,7 +498,7 @@
 						return count;
 					}
 
-					bytes = MIN(READ_BUFFER_SIZE, count - written);
+					bytes = MIN((off_t) RECORD_SIZE, count - written);
 				}
 			} while (true);
 		}
@@ -17,9 +17,20 @@ namespace net {
 			static off_t sendfile(socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, int timeout = -1);
 
 #if HAVE_SSL
-			// Reset.
+			// Constructor.
+			filesender();
+
+			// Destructor.
+			~filesender();
+
+			// Reset (after each response).
 			void reset();
 
+	#if !HAVE_MMAP
+			// Get output buffer.
+			string::buffer& output();
+	#endif // !HAVE_MMAP
+
 			off_t sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, bool& want_read, bool& want_write);
 			off_t sendfile(ssl_socket& s, fs::file& f, off_t filesize, off_t& offset, off_t count, int timeout = -1);
 #endif // HAVE_SSL
@@ -28,15 +39,80 @@ namespace net {
 			static const size_t READ_BUFFER_SIZE = 8 * 1024;
 
 #if HAVE_SSL
+			// Maximum payload of a TLS record.
+			static const size_t RECORD_SIZE = 16 * 1024;
+
+	#if HAVE_MMAP
+			// Size of the window of the file mapped (multiple of the page
+			// size and of RECORD_SIZE).
+			static const size_t MAP_WINDOW_SIZE = 4 * 1024 * 1024;
+
+			// Window of the file mapped (kept for the whole response, the
+			// records are written directly from the mapped pages).
+			void* _M_map;
+			size_t _M_maplen;
+			off_t _M_mapoff;
+			int _M_mapfd;
+
+			// Bytes of the last write which has to be retried (OpenSSL
+			// requires the same buffer and length).
+			size_t _M_pending;
+
+			// Map the window of the file which contains 'offset' (if not
+			// mapped yet). Returns a pointer to the data at 'offset' and
+			// the number of bytes mapped from there.
+			const char* map(fs::file& f, off_t filesize, off_t offset, size_t& len);
+
+			// Unmap window.
+			void unmap();
+	#else
 			string::buffer _M_output;
+	#endif // HAVE_MMAP
 #endif // HAVE_SSL
 	};
 
 #if HAVE_SSL
-	inline void filesender::reset()
-	{
-		_M_output.clear();
-	}
+	#if HAVE_MMAP
+		inline filesender::filesender()
+		{
+			_M_map = NULL;
+			_M_maplen = 0;
+			_M_mapoff = 0;
+			_M_mapfd = -1;
+
+			_M_pending = 0;
+		}
+
+		inline filesender::~filesender()
+		{
+			unmap();
+		}
+
+		inline void filesender::reset()
+		{
+			unmap();
+
+			_M_pending = 0;
+		}
+	#else
+		inline filesender::filesender()
+		{
+		}
+
+		inline filesender::~filesender()
+		{
+		}
+
+		inline void filesender::reset()
+		{
+			_M_output.clear();
+		}
+
+		inline string::buffer& filesender::output()
+		{
+			return _M_output;
+		}
+	#endif // HAVE_MMAP
 #endif // HAVE_SSL
 }
 
@@ -0,0 +1,410 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <new>
+
+#if HAVE_ZLIB
+	#include <zlib.h>
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+	#include <zstd.h>
+#endif // HAVE_ZSTD
+
+#include "net/internet/http/compressor.h"
+
+net::internet::http::compressor::~compressor()
+{
+	if (_M_running) {
+		pthread_mutex_lock(&_M_mutex);
+		_M_stop = true;
+		pthread_cond_signal(&_M_cond);
+		pthread_mutex_unlock(&_M_mutex);
+
+		pthread_join(_M_thread, NULL);
+
+		// Release the entries of the jobs not finished.
+		job* j = _M_pending;
+		while (j) {
+			job* next = j->next;
+
+			j->success = false;
+			finish(j);
+
+			j = next;
+		}
+
+		j = _M_done;
+		while (j) {
+			job* next = j->next;
+			finish(j);
+			j = next;
+		}
+
+		pthread_cond_destroy(&_M_cond);
+		pthread_mutex_destroy(&_M_mutex);
+	}
+
+	if (_M_pipe[0] != -1) {
+		close(_M_pipe[0]);
+		close(_M_pipe[1]);
+	}
+
+#if HAVE_ZLIB
+	if (_M_deflate_initialized) {
+		deflateEnd(&_M_deflate);
+	}
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+	if (_M_cctx) {
+		ZSTD_freeCCtx(_M_cctx);
+	}
+#endif // HAVE_ZSTD
+}
+
+bool net::internet::http::compressor::create(open_file_cache* cache, int level)
+{
+	if (pipe(_M_pipe) < 0) {
+		_M_pipe[0] = -1;
+		_M_pipe[1] = -1;
+
+		return false;
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		if ((fcntl(_M_pipe[i], F_SETFL, O_NONBLOCK) < 0) || (fcntl(_M_pipe[i], F_SETFD, FD_CLOEXEC) < 0)) {
+			return false;
+		}
+	}
+
+	_M_cache = cache;
+	_M_level = level;
+
+	if (pthread_mutex_init(&_M_mutex, NULL) != 0) {
+		return false;
+	}
+
+	if (pthread_cond_init(&_M_cond, NULL) != 0) {
+		pthread_mutex_destroy(&_M_mutex);
+		return false;
+	}
+
+	// The signals are handled by the main thread.
+	sigset_t set, oldset;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &oldset);
+
+	int ret = pthread_create(&_M_thread, NULL, run, this);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	if (ret != 0) {
+		pthread_cond_destroy(&_M_cond);
+		pthread_mutex_destroy(&_M_mutex);
+
+		return false;
+	}
+
+	_M_running = true;
+
+	return true;
+}
+
+unsigned char net::internet::http::compressor::select(unsigned accepted)
+{
+#if HAVE_ZSTD
+	if (accepted & (1 << content_encoding::ZSTD)) {
+		return content_encoding::ZSTD;
+	}
+#endif // HAVE_ZSTD
+
+#if HAVE_ZLIB
+	if (accepted & (1 << content_encoding::GZIP)) {
+		return content_encoding::GZIP;
+	}
+#endif // HAVE_ZLIB
+
+	return content_encoding::IDENTITY;
+}
+
+bool net::internet::http::compressor::compress(open_file_cache::entry* e, unsigned char encoding)
+{
+	if ((!_M_running) || (_M_njobs == kMaxJobs)) {
+		return false;
+	}
+
+	job* j;
+	if ((j = new (std::nothrow) job) == NULL) {
+		return false;
+	}
+
+	j->e = e;
+	j->encoding = encoding;
+	j->fd = e->fd;
+	j->size = e->buf.st_size;
+	j->success = false;
+	j->next = NULL;
+
+	e->refcount++;
+	e->compressing |= (1 << encoding);
+
+	_M_njobs++;
+
+	pthread_mutex_lock(&_M_mutex);
+
+	if (_M_pending_tail) {
+		_M_pending_tail->next = j;
+	} else {
+		_M_pending = j;
+	}
+
+	_M_pending_tail = j;
+
+	pthread_cond_signal(&_M_cond);
+	pthread_mutex_unlock(&_M_mutex);
+
+	return true;
+}
+
+bool net::internet::http::compressor::compress(const char* data, size_t len, unsigned char encoding, int level, string::buffer& out)
+{
+	switch (encoding) {
+#if HAVE_ZLIB
+		case content_encoding::GZIP:
+			{
+				z_stream strm;
+				memset(&strm, 0, sizeof(z_stream));
+
+				// 15 + 16: gzip header and trailer.
+				if (deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+					return false;
+				}
+
+				size_t bound = deflateBound(&strm, len);
+				if (!out.allocate(bound)) {
+					deflateEnd(&strm);
+					return false;
+				}
+
+				strm.next_in = (Bytef*) data;
+				strm.avail_in = len;
+				strm.next_out = (Bytef*) out.end();
+				strm.avail_out = bound;
+
+				int ret = deflate(&strm, Z_FINISH);
+				size_t total = strm.total_out;
+
+				deflateEnd(&strm);
+
+				if (ret != Z_STREAM_END) {
+					return false;
+				}
+
+				out.increment_length(total);
+
+				return true;
+			}
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+		case content_encoding::ZSTD:
+			{
+				size_t bound = ZSTD_compressBound(len);
+				if (!out.allocate(bound)) {
+					return false;
+				}
+
+				size_t ret = ZSTD_compress(out.end(), bound, data, len, level);
+				if (ZSTD_isError(ret)) {
+					return false;
+				}
+
+				out.increment_length(ret);
+
+				return true;
+			}
+#endif // HAVE_ZSTD
+
+		default:
+			return false;
+	}
+}
+
+bool net::internet::http::compressor::compress_inline(const char* data, size_t len, unsigned char encoding, string::buffer& out)
+{
+	switch (encoding) {
+#if HAVE_ZLIB
+		case content_encoding::GZIP:
+			if (!_M_deflate_initialized) {
+				memset(&_M_deflate, 0, sizeof(z_stream));
+
+				// 15 + 16: gzip header and trailer.
+				if (deflateInit2(&_M_deflate, kInlineLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+					return false;
+				}
+
+				_M_deflate_initialized = true;
+			} else if (deflateReset(&_M_deflate) != Z_OK) {
+				return false;
+			}
+
+			_M_deflate.next_in = (Bytef*) data;
+			_M_deflate.avail_in = len;
+			_M_deflate.next_out = (Bytef*) out.end();
+			_M_deflate.avail_out = out.remaining();
+
+			// If the compressed data doesn't fit, it's not worth it.
+			if (deflate(&_M_deflate, Z_FINISH) != Z_STREAM_END) {
+				return false;
+			}
+
+			out.increment_length(_M_deflate.total_out);
+
+			return true;
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+		case content_encoding::ZSTD:
+			{
+				if ((!_M_cctx) && ((_M_cctx = ZSTD_createCCtx()) == NULL)) {
+					return false;
+				}
+
+				size_t ret = ZSTD_compressCCtx(_M_cctx, out.end(), out.remaining(), data, len, kInlineLevel);
+				if (ZSTD_isError(ret)) {
+					return false;
+				}
+
+				out.increment_length(ret);
+
+				return true;
+			}
+#endif // HAVE_ZSTD
+
+		default:
+			return false;
+	}
+}
+
+bool net::internet::http::compressor::on_readable()
+{
+	char buf[64];
+	ssize_t ret;
+
+	do {
+		ret = read(_M_pipe[0], buf, sizeof(buf));
+	} while ((ret > 0) || ((ret < 0) && (errno == EINTR)));
+
+	pthread_mutex_lock(&_M_mutex);
+	job* j = _M_done;
+	_M_done = NULL;
+	pthread_mutex_unlock(&_M_mutex);
+
+	while (j) {
+		job* next = j->next;
+		finish(j);
+		j = next;
+	}
+
+	return true;
+}
+
+void* net::internet::http::compressor::run(void* arg)
+{
+	static_cast<compressor*>(arg)->run();
+	return NULL;
+}
+
+void net::internet::http::compressor::run()
+{
+	pthread_mutex_lock(&_M_mutex);
+
+	do {
+		while ((!_M_pending) && (!_M_stop)) {
+			pthread_cond_wait(&_M_cond, &_M_mutex);
+		}
+
+		if (_M_stop) {
+			break;
+		}
+
+		job* j = _M_pending;
+		if ((_M_pending = j->next) == NULL) {
+			_M_pending_tail = NULL;
+		}
+
+		pthread_mutex_unlock(&_M_mutex);
+
+		j->success = process(j, _M_level);
+
+		pthread_mutex_lock(&_M_mutex);
+
+		j->next = _M_done;
+		_M_done = j;
+
+		// Wake up the event loop (once until it collects the jobs done).
+		if (!j->next) {
+			char c = 0;
+			while ((write(_M_pipe[1], &c, 1) < 0) && (errno == EINTR));
+		}
+	} while (true);
+
+	pthread_mutex_unlock(&_M_mutex);
+}
+
+bool net::internet::http::compressor::process(job* j, int level)
+{
+	char* data;
+	if ((data = (char*) malloc(j->size)) == NULL) {
+		return false;
+	}
+
+	off_t off = 0;
+	while (off < j->size) {
+		ssize_t ret;
+		if ((ret = pread(j->fd, data + off, j->size - off, off)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		} else if (ret == 0) {
+			// The file has been truncated.
+			break;
+		}
+
+		off += ret;
+	}
+
+	// Keep the compressed body only if it's smaller.
+	bool success = ((off == j->size) && (compress(data, j->size, j->encoding, level, j->out)) && (j->out.length() < (size_t) j->size));
+
+	free(data);
+
+	if (!success) {
+		j->out.free();
+	}
+
+	return success;
+}
+
+void net::internet::http::compressor::finish(job* j)
+{
+	open_file_cache::entry* e = j->e;
+
+	// If the file couldn't be compressed, it's not compressed again while
+	// the entry is cached.
+	if ((j->success) && (_M_cache->compressed(e, j->encoding, j->out))) {
+		_M_files++;
+	}
+
+	e->release();
+
+	_M_njobs--;
+
+	delete j;
+}
@@ -0,0 +1,207 @@
+#ifndef HTTP_COMPRESSOR_H
+#define HTTP_COMPRESSOR_H
+
+#include <sys/types.h>
+#include <pthread.h>
+
+#if HAVE_ZLIB
+	#include <zlib.h>
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+	#include <zstd.h>
+#endif // HAVE_ZSTD
+
+#include "io/event_handler.h"
+#include "net/internet/http/open_file_cache.h"
+#include "net/internet/http/content_encoding.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			// On-the-fly compression (gzip and, if built with HAVE_ZSTD,
+			// zstd). The files are compressed by a background thread (one
+			// per worker) so the event loop never waits for them: the
+			// response which requests the compression is sent uncompressed
+			// and, once compressed, the body is kept in the entry of the
+			// cache of open files and served from memory.
+			class compressor : public io::event_handler {
+				public:
+					static const int kDefaultLevel = 6;
+					static const int kMaxLevel = 9;
+
+					// Sizes of the files to compress [bytes].
+					static const unsigned kDefaultMinLength = 256;
+					static const unsigned kDefaultMaxLength = 1024 * 1024;
+					static const unsigned kMaxMaxLength = 64 * 1024 * 1024;
+
+					// Level of the generated bodies (compressed by the
+					// event loop).
+					static const int kInlineLevel = 1;
+
+					// Maximum size of the generated bodies to compress
+					// [bytes] (bigger ones, such as long directory
+					// listings, are sent uncompressed rather than stalling
+					// the event loop).
+					static const size_t kMaxInlineLength = 8 * 1024;
+
+					// Maximum number of files waiting to be compressed.
+					static const unsigned kMaxJobs = 256;
+
+					// Constructor.
+					compressor();
+
+					// Destructor.
+					~compressor();
+
+					// Create (starts the background thread).
+					bool create(open_file_cache* cache, int level);
+
+					// Is the compressor running?
+					bool enabled() const;
+
+					// Get descriptor to be watched (-1 if none).
+					int fd() const;
+
+					// Select the content coding to compress with (the first
+					// one supported and accepted: zstd, gzip) or IDENTITY.
+					static unsigned char select(unsigned accepted);
+
+					// Compress the file of the entry in background (the
+					// entry is referenced until the compression finishes).
+					bool compress(open_file_cache::entry* e, unsigned char encoding);
+
+					// Compress buffer.
+					static bool compress(const char* data, size_t len, unsigned char encoding, int level, string::buffer& out);
+
+					// Compress a generated body (at kInlineLevel, called by
+					// the event loop). The compressed data is appended to
+					// 'out' only if it fits in the space available, the
+					// compression contexts are reused between calls.
+					bool compress_inline(const char* data, size_t len, unsigned char encoding, string::buffer& out);
+
+					// Get number of files compressed.
+					unsigned long long files() const;
+
+					// On readable.
+					bool on_readable();
+
+					// On writable.
+					bool on_writable();
+
+				private:
+					struct job {
+						// Only accessed by the event loop.
+						open_file_cache::entry* e;
+
+						unsigned char encoding;
+
+						int fd;
+						off_t size;
+
+						string::buffer out;
+						bool success;
+
+						job* next;
+					};
+
+					open_file_cache* _M_cache;
+					int _M_level;
+
+					pthread_t _M_thread;
+					bool _M_running;
+
+					pthread_mutex_t _M_mutex;
+					pthread_cond_t _M_cond;
+
+					// Jobs waiting to be processed (FIFO) and jobs done
+					// (protected by the mutex).
+					job* _M_pending;
+					job* _M_pending_tail;
+					job* _M_done;
+					bool _M_stop;
+
+					// Number of jobs not finished yet (only accessed by the
+					// event loop).
+					unsigned _M_njobs;
+
+					unsigned long long _M_files;
+
+					// Pipe to wake up the event loop.
+					int _M_pipe[2];
+
+#if HAVE_ZLIB
+					// Deflate stream of the inline compressions.
+					z_stream _M_deflate;
+					bool _M_deflate_initialized;
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+					// Context of the inline compressions.
+					ZSTD_CCtx* _M_cctx;
+#endif // HAVE_ZSTD
+
+					// Thread function.
+					static void* run(void* arg);
+					void run();
+
+					// Compress the file of the job.
+					static bool process(job* j, int level);
+
+					// Finish job (called by the event loop).
+					void finish(job* j);
+			};
+
+			inline compressor::compressor()
+			{
+				_M_cache = NULL;
+				_M_level = kDefaultLevel;
+
+				_M_running = false;
+
+				_M_pending = NULL;
+				_M_pending_tail = NULL;
+				_M_done = NULL;
+				_M_stop = false;
+
+				_M_njobs = 0;
+
+				_M_files = 0;
+
+				_M_pipe[0] = -1;
+				_M_pipe[1] = -1;
+
+#if HAVE_ZLIB
+				_M_deflate_initialized = false;
+#endif // HAVE_ZLIB
+
+#if HAVE_ZSTD
+				_M_cctx = NULL;
+#endif // HAVE_ZSTD
+			}
+
+			inline bool compressor::enabled() const
+			{
+				return _M_running;
+			}
+
+			inline int compressor::fd() const
+			{
+				return _M_pipe[0];
+			}
+
+			inline unsigned long long compressor::files() const
+			{
+				return _M_files;
+			}
+
+			inline bool compressor::on_writable()
+			{
+				return true;
+			}
+		}
+	}
+}
+
+#endif // HTTP_COMPRESSOR_H
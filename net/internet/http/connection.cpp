@@ -1,10 +1,13 @@
 #include <stdlib.h>
+#include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "net/internet/http/connection.h"
 #include "net/internet/http/server.h"
 #include "net/internet/http/error.h"
+#include "net/internet/http/status.h"
 #include "net/internet/http/version.h"
+#include "net/internet/http/http2/session.h"
 #include "net/tcp_connection.inl"
 #include "net/internet/url.h"
 #include "net/internet/scheme.h"
@@ -12,12 +15,15 @@
 #include "net/internet/limits.h"
 #include "string/memcasemem.h"
 #include "string/memrchr.h"
+#include "string/scan.h"
 #include "util/number.h"
 #include "macros/macros.h"
 
 bool net::internet::http::connection::on_timer(unsigned id)
 {
-	_M_timer_set = 0;
+	if (!idle_expired()) {
+		return true;
+	}
 
 	_M_server->delete_connection(this);
 
@@ -42,6 +48,15 @@ bool net::internet::http::connection::run()
 					if (!completed) {
 						return true;
 					}
+
+					// HTTP/2 negotiated (ALPN)?
+					if (_M_ssl_socket.alpn_selected("h2", 2)) {
+						if (!start_http2()) {
+							return false;
+						}
+
+						break;
+					}
 				}
 #endif // HAVE_SSL
 
@@ -51,6 +66,15 @@ bool net::internet::http::connection::run()
 			case kReadingRequestLine:
 				// If all the received data has been already processed...
 				if (_M_inp == (off_t) _M_in.length()) {
+					// Send the queued responses before reading more data.
+					if (!_M_out.empty()) {
+						if (!send_queued_responses()) {
+							return false;
+						}
+
+						break;
+					}
+
 					if (!_M_readable) {
 						return true;
 					}
@@ -66,6 +90,28 @@ bool net::internet::http::connection::run()
 					}
 				}
 
+				// A new request has begun.
+				_M_idle_time = _M_max_idle_time;
+
+				// HTTP/2 with prior knowledge (only in the first request of a
+				// cleartext connection)?
+				if (_M_new_connection) {
+					_M_new_connection = 0;
+
+#if HAVE_SSL
+					if (!_M_https)
+#endif // HAVE_SSL
+					{
+						if ((_M_inp == 0) && (static_cast<server*>(_M_server)->http2()) && (http2::session::preface(_M_in.data(), _M_in.length()))) {
+							if (!start_http2()) {
+								return false;
+							}
+
+							break;
+						}
+					}
+				}
+
 				if ((ret = parse_request_line()) != 0) {
 					_M_state = kPreparingErrorPage;
 				} else {
@@ -78,6 +124,15 @@ bool net::internet::http::connection::run()
 			case kAfterRequestLine:
 				// If all the received data has been already processed...
 				if (_M_inp == (off_t) _M_in.length()) {
+					// Send the queued responses before reading more data.
+					if (!_M_out.empty()) {
+						if (!send_queued_responses()) {
+							return false;
+						}
+
+						break;
+					}
+
 					if (!_M_readable) {
 						_M_state = kReadingHeaders;
 						return true;
@@ -119,6 +174,15 @@ bool net::internet::http::connection::run()
 
 				break;
 			case kReadingHeaders:
+				// Send the queued responses before reading more data.
+				if (!_M_out.empty()) {
+					if (!send_queued_responses()) {
+						return false;
+					}
+
+					break;
+				}
+
 				if (!_M_readable) {
 					return true;
 				}
@@ -157,26 +221,45 @@ bool net::internet::http::connection::run()
 
 				break;
 			case kProcessingRequest:
+				// Borrow the output buffer.
+				if (!borrow_buffer(_M_out, kOutputBufferSize)) {
+					return false;
+				}
+
 				if ((ret = process_request()) != 0) {
 					_M_state = kPreparingErrorPage;
 				} else {
-					if (!modify(tcp_server::WRITE)) {
-						return false;
+					// The headers and the file are sent in the same packets.
+					if (((_M_state == kSendingHeaders) && (_M_method == method::GET) && (_M_filesize > 0)) || (_M_state == kSendingParts)) {
+						_M_socket.cork();
+					}
+
+					if (!queue_response()) {
+						if (!modify(tcp_server::WRITE)) {
+							return false;
+						}
 					}
 				}
 
 				break;
 			case kPreparingErrorPage:
-				if (!error::build_page(*this, ret)) {
+				// Borrow the output buffer.
+				if (!borrow_buffer(_M_out, kOutputBufferSize)) {
 					return false;
 				}
 
-				if (!modify(tcp_server::WRITE)) {
+				if (!error::build_page(*this, ret)) {
 					return false;
 				}
 
 				_M_state = (_M_method == method::HEAD) ? kSendingHeaders : kSendingTwoBuffers;
 
+				if (!queue_response()) {
+					if (!modify(tcp_server::WRITE)) {
+						return false;
+					}
+				}
+
 				break;
 			case kSendingTwoBuffers:
 				if (!_M_writable) {
@@ -240,84 +323,87 @@ bool net::internet::http::connection::run()
 						_M_state = kRequestCompleted;
 					}
 				} else {
-					const util::range* range = _M_ranges.get(_M_nrange);
+					const util::range* range = _M_ranges.get(0);
 					if (!sendfile(_M_file, _M_filesize, range)) {
 						return false;
 					}
 
 					// If everything has been sent...
 					if (_M_outp == range->to + 1) {
-						if (_M_ranges.count() == 1) {
-							_M_socket.uncork();
-
-							_M_state = kRequestCompleted;
-						} else {
-							_M_out.clear();
-
-							// Last part?
-							if (++_M_nrange == _M_ranges.count()) {
-								if (!_M_out.format("\r\n--%0*u--\r\n", headers::BOUNDARY_LEN, _M_boundary)) {
-									return false;
-								}
-
-								_M_state = kSendingMultipartFooter;
-							} else {
-								if (!build_part_header()) {
-									return false;
-								}
-
-								_M_state = kSendingPartHeader;
-							}
+						_M_socket.uncork();
 
-							_M_outp = 0;
-						}
+						_M_state = kRequestCompleted;
 					}
 				}
 
 				break;
-			case kSendingPartHeader:
+			case kSendingParts:
 				if (!_M_writable) {
 					return true;
 				}
 
-				if (!write()) {
-					return false;
-				}
-
-				// If everything has been sent...
-				if (_M_outp == (off_t) _M_out.length()) {
-					_M_outp = _M_ranges.get(_M_nrange)->from;
-					_M_state = kSendingBody;
-				}
-
-				break;
-			case kSendingMultipartFooter:
-				if (!_M_writable) {
-					return true;
-				}
+				if (!_M_part_body) {
+					// Headers of the part (after the headers of the response
+					// for the first one) or footer.
+					size_t end = (_M_nrange < _M_ranges.count()) ? _M_parts[_M_nrange] : _M_out.length();
+					if (!write(_M_out, end)) {
+						return false;
+					}
 
-				if (!write()) {
-					return false;
-				}
+					// If everything has been sent...
+					if (_M_outp == (off_t) end) {
+						if (_M_nrange == _M_ranges.count()) {
+							_M_socket.uncork();
 
-				// If everything has been sent...
-				if (_M_outp == (off_t) _M_out.length()) {
-					_M_socket.uncork();
+							_M_state = kRequestCompleted;
+						} else {
+							_M_outp = _M_ranges.get(_M_nrange)->from;
+							_M_part_body = 1;
+						}
+					}
+				} else {
+					const util::range* range = _M_ranges.get(_M_nrange);
+					if (!sendfile(_M_file, _M_filesize, range)) {
+						return false;
+					}
 
-					_M_state = kRequestCompleted;
+					// If everything has been sent...
+					if (_M_outp == range->to + 1) {
+						_M_outp = _M_parts[_M_nrange++];
+						_M_part_body = 0;
+					}
 				}
 
 				break;
 			case kRequestCompleted:
+				_M_server->request_completed(_M_nreads);
+
 				// Close connection?
 				if (!_M_keep_alive) {
 					return false;
 				} else {
-					if (!modify(tcp_server::READ)) {
-						return false;
-					}
+					// Wait for the next request at most the keep-alive timeout.
+					_M_idle_time = _M_keep_alive_timeout;
+
+					if (!_M_response_queued) {
+						if (!modify(tcp_server::READ)) {
+							return false;
+						}
+
+						reset();
 
-					reset();
+						if (!add_timer()) {
+							return false;
+						}
+					} else {
+						// Keep the queued responses.
+						string::buffer out;
+						out.swap(_M_out);
+
+						reset();
+
+						_M_out.swap(out);
+					}
 
 					// If there is more data in the input buffer.
 					size_t left;
@@ -331,18 +417,186 @@ bool net::internet::http::connection::run()
 
 					_M_inp = 0;
 
+					// Don't keep the buffers while the connection is idle.
+					if (_M_out.empty()) {
+						release_buffers();
+					}
+
 					_M_state = kReadingRequestLine;
 				}
 
 				break;
+			case kSendingQueuedResponses:
+				if (!_M_writable) {
+					return true;
+				}
+
+				if (!write()) {
+					return false;
+				}
+
+				// If everything has been sent...
+				if (_M_outp == (off_t) _M_out.length()) {
+					if (!modify(tcp_server::READ)) {
+						return false;
+					}
+
+					_M_out.clear();
+					_M_outp = 0;
+
+					// Don't keep the buffers while the connection is idle.
+					release_buffers();
+
+					_M_state = _M_resume_state;
+				}
+
+				break;
+			case kHttp2:
+				return _M_http2->run();
 		}
 	} while (true);
 }
 
-bool net::internet::http::connection::add_common_headers(headers& h)
+bool net::internet::http::connection::send_queued_responses()
+{
+	if (!modify(tcp_server::WRITE)) {
+		return false;
+	}
+
+	_M_resume_state = _M_state;
+	_M_state = kSendingQueuedResponses;
+
+	return true;
+}
+
+bool net::internet::http::connection::process_http2_request(string::buffer& request, string::buffer& response, http2::stream& s)
+{
+	_reset();
+
+	// Process the request as if it had been received on this connection: the
+	// input and output buffers are replaced by the request and the response.
+	off_t inp = _M_inp;
+	_M_inp = 0;
+
+	_M_in.swap(request);
+
+	response.clear();
+	_M_out.swap(response);
+
+	unsigned short ret;
+	if ((ret = parse_request_line()) == 0) {
+		if (_M_substate != 26) {
+			ret = error::BAD_REQUEST;
+		} else {
+			switch (_M_headers.parse(_M_in.data() + _M_inp, _M_in.length() - _M_inp)) {
+				case headers::PARSE_END_OF_HEADER:
+					ret = process_request();
+					break;
+				case headers::PARSE_NO_MEMORY:
+					ret = error::INTERNAL_SERVER_ERROR;
+					break;
+				case headers::PARSE_HEADERS_TOO_LARGE:
+					ret = error::REQUEST_ENTITY_TOO_LARGE;
+					break;
+				default:
+					ret = error::BAD_REQUEST;
+			}
+		}
+	}
+
+	bool success = true;
+
+	if (ret != 0) {
+		_M_out.clear();
+
+		if (error::build_page(*this, ret)) {
+			_M_state = kSendingTwoBuffers;
+		} else {
+			success = false;
+		}
+	}
+
+	if (success) {
+		if (_M_method == method::HEAD) {
+			// No body.
+		} else if (_M_state == kSendingHeaders) {
+			// The body is read from the file.
+			if (_M_filesize > 0) {
+				s.file.fd(_M_file.fd());
+				_M_file.fd(-1);
+
+				s.open_file = _M_open_file;
+				_M_open_file = NULL;
+
+				if (_M_ranges.count() == 1) {
+					const util::range* range = _M_ranges.get(0);
+
+					s.offset = range->from;
+					s.end = range->to + 1;
+				} else {
+					s.end = _M_filesize;
+				}
+			}
+		} else {
+			// The body is held in memory.
+			if (_M_bodyp == &_M_body) {
+				s.body.swap(_M_body);
+				s.bodyp = &s.body;
+			} else {
+				s.bodyp = _M_bodyp;
+
+				// The body might belong to the cache of open files.
+				s.open_file = _M_open_file;
+				_M_open_file = NULL;
+			}
+
+			s.end = s.bodyp->length();
+		}
+	}
+
+	_M_in.swap(request);
+	_M_inp = inp;
+
+	_M_out.swap(response);
+
+	close_file();
+
+	_M_state = kHttp2;
+
+	return success;
+}
+
+bool net::internet::http::connection::start_http2()
+{
+	if ((_M_http2 = new (std::nothrow) http2::session()) == NULL) {
+		return false;
+	}
+
+	if (!_M_http2->create(this)) {
+		return false;
+	}
+
+	_M_state = kHttp2;
+
+	return true;
+}
+
+void net::internet::http::connection::free_http2()
+{
+	if (_M_http2) {
+		delete _M_http2;
+		_M_http2 = NULL;
+	}
+}
+
+void net::internet::http::connection::update_keep_alive(unsigned& timeout, unsigned& max_requests)
 {
+	static_cast<server*>(_M_server)->keep_alive(_M_vhost, timeout, max_requests);
+
+	_M_keep_alive_timeout = timeout;
+
 	// Keep-Alive?
-	if (++_M_nrequests == kMaxRequestsPerConnection) {
+	if ((max_requests > 0) && (++_M_nrequests >= max_requests)) {
 		_M_keep_alive = 0;
 	} else {
 		const header_value* v;
@@ -358,10 +612,18 @@ bool net::internet::http::connection::add_common_headers(headers& h)
 			_M_keep_alive = (_M_http_version == HTTP_1_1);
 		}
 	}
+}
+
+bool net::internet::http::connection::add_common_headers(headers& h)
+{
+	unsigned timeout, max_requests;
+	update_keep_alive(timeout, max_requests);
 
 	h.reset();
 
-	if (!h.add(header_name::DATE, _M_server->utc_time())) {
+	unsigned short len;
+	const char* date = _M_server->gmt_date(len);
+	if (!h.add(header_name::DATE, header_value(date, len))) {
 		return false;
 	}
 
@@ -369,6 +631,18 @@ bool net::internet::http::connection::add_common_headers(headers& h)
 		if (!h.add(header_name::CONNECTION, header_value("Keep-Alive", 10))) {
 			return false;
 		}
+
+		char keep_alive[32];
+		int len;
+		if (max_requests > 0) {
+			len = snprintf(keep_alive, sizeof(keep_alive), "timeout=%u, max=%u", timeout, max_requests - _M_nrequests);
+		} else {
+			len = snprintf(keep_alive, sizeof(keep_alive), "timeout=%u", timeout);
+		}
+
+		if (!h.add(header_name::KEEP_ALIVE, header_value(keep_alive, len))) {
+			return false;
+		}
 	} else {
 		if (!h.add(header_name::CONNECTION, header_value("close", 5))) {
 			return false;
@@ -783,6 +1057,11 @@ unsigned short net::internet::http::connection::parse_request_line()
 						if (c < ' ') {
 							return error::BAD_REQUEST;
 						}
+
+						// Skip the following path characters at once.
+						size_t n = MIN(string::scan::path(d + 1, end), skip_limit());
+						d += n;
+						_M_inp += n;
 				}
 
 				break;
@@ -839,6 +1118,12 @@ unsigned short net::internet::http::connection::parse_request_line()
 						default:
 							return error::BAD_REQUEST;
 					}
+				} else {
+					// Skip the following unreserved characters and
+					// sub-delimiters at once.
+					size_t n = MIN(string::scan::query(d + 1, end), skip_limit());
+					d += n;
+					_M_inp += n;
 				}
 
 				break;
@@ -882,6 +1167,12 @@ unsigned short net::internet::http::connection::parse_request_line()
 						default:
 							return error::BAD_REQUEST;
 					}
+				} else {
+					// Skip the following unreserved characters and
+					// sub-delimiters at once.
+					size_t n = MIN(string::scan::query(d + 1, end), skip_limit());
+					d += n;
+					_M_inp += n;
 				}
 
 				break;
@@ -1413,6 +1704,30 @@ unsigned short net::internet::http::connection::process_request()
 		return error::NOT_IMPLEMENTED;
 	}
 
+	// Server status page?
+	const string::buffer& status_url = static_cast<server*>(_M_server)->status_url();
+	if ((!status_url.empty()) && (_M_path.length() == status_url.length()) && (memcmp(_M_path.data(), status_url.data(), status_url.length()) == 0)) {
+		// Skip '?'.
+		const char* query = _M_in.data() + _M_query + 1;
+		unsigned short querylen = (_M_querylen > 0) ? _M_querylen - 1 : 0;
+
+		status::format fmt = status::FORMAT_TEXT;
+		if (((querylen == 4) && (memcmp(query, "json", 4) == 0)) ||
+		    ((querylen == 11) && (memcmp(query, "format=json", 11) == 0))) {
+			fmt = status::FORMAT_JSON;
+		}
+
+		if (!status::build(*static_cast<server*>(_M_server), fmt, _M_body)) {
+			return error::INTERNAL_SERVER_ERROR;
+		}
+
+		if (fmt == status::FORMAT_JSON) {
+			return prepare_body_response("application/json", 16);
+		} else {
+			return prepare_body_response("text/plain; charset=UTF-8", 25);
+		}
+	}
+
 	// Check that the path is not too long.
 	size_t rootlen = _M_vhost->rootlen();
 	if (rootlen + ((_M_path.empty()) ? 1 : _M_path.length()) > PATH_MAX) {
@@ -1433,198 +1748,574 @@ unsigned short net::internet::http::connection::process_request()
 
 	path[pathlen] = 0;
 
-	// Get file status.
-	struct stat buf;
-	if (stat(path, &buf) < 0) {
-		return error::NOT_FOUND;
-	}
+	open_file_cache& cache = static_cast<server*>(_M_server)->open_files();
+	unsigned now = static_cast<server*>(_M_server)->current_msec();
 
-	// Directory?
+	struct stat buf;
 	const char* index = NULL;
-	if (S_ISDIR(buf.st_mode)) {
-		// If the directory name doesn't end with '/'...
-		if (path[pathlen - 1] != '/') {
-			return error::MOVED_PERMANENTLY;
-		}
-
-		// Search index file.
-		unsigned short indexlen;
-		for (unsigned i = 0; ((index = _M_vhost->index(i, indexlen, _M_mime_type, _M_mime_type_len)) != NULL); i++) {
-			if (pathlen + indexlen < sizeof(path)) {
-				memcpy(path + pathlen, index, indexlen + 1);
-				if ((stat(path, &buf) == 0) && (S_ISREG(buf.st_mode))) {
-					pathlen += indexlen;
-					break;
-				}
-			}
 
-			index = NULL;
-		}
+	// Length of the key of the cache (the path without the index file).
+	size_t keylen = 0;
 
-		// If no index file has been found...
-		if (!index) {
-			// If the directory listing is not enabled...
-			dirlisting* dirlisting;
-			if ((dirlisting = _M_vhost->get_directory_listing()) == NULL) {
-				return error::NOT_FOUND;
-			}
+	// Cached?
+	if ((cache.enabled()) && ((_M_open_file = cache.get(_M_vhost->parent(), path, pathlen, now)) != NULL)) {
+		buf = _M_open_file->buf;
 
-			// Build directory listing.
-			if (!dirlisting->build(path + rootlen, pathlen - rootlen, _M_body)) {
-				return error::INTERNAL_SERVER_ERROR;
-			}
+		if ((index = _M_open_file->mime_type) != NULL) {
+			_M_mime_type = _M_open_file->mime_type;
+			_M_mime_type_len = _M_open_file->mime_type_len;
+		}
 
-			// Add common headers.
-			if (!add_common_headers(_M_headers)) {
-				return error::INTERNAL_SERVER_ERROR;
-			}
+		_M_file.fd(_M_open_file->fd);
+	} else {
+		// Get file status.
+		if (stat(path, &buf) < 0) {
+			return error::NOT_FOUND;
+		}
 
-			// Add Content-Type header.
-			if (!_M_headers.add(header_name::CONTENT_TYPE, header_value("text/html; charset=UTF-8", 24))) {
-				return error::INTERNAL_SERVER_ERROR;
-			}
+		keylen = pathlen;
 
-			// Add Content-Length header.
-			if (!_M_headers.add(header_name::CONTENT_LENGTH, (uint64_t) _M_body.length())) {
-				return error::INTERNAL_SERVER_ERROR;
+		// Directory?
+		if (S_ISDIR(buf.st_mode)) {
+			// If the directory name doesn't end with '/'...
+			if (path[pathlen - 1] != '/') {
+				return error::MOVED_PERMANENTLY;
 			}
 
-			// Add Status-Line.
-			if (!_M_out.append("HTTP/1.1 200 OK\r\n", 17)) {
-				return error::INTERNAL_SERVER_ERROR;
-			}
+			// Search index file.
+			unsigned short indexlen;
+			for (unsigned i = 0; ((index = _M_vhost->index(i, indexlen, _M_mime_type, _M_mime_type_len)) != NULL); i++) {
+				if (pathlen + indexlen < sizeof(path)) {
+					memcpy(path + pathlen, index, indexlen + 1);
+					if ((stat(path, &buf) == 0) && (S_ISREG(buf.st_mode))) {
+						pathlen += indexlen;
+						break;
+					}
+				}
 
-			// Serialize headers.
-			if (!_M_headers.serialize(_M_out)) {
-				return error::INTERNAL_SERVER_ERROR;
+				index = NULL;
 			}
 
-			_M_bodyp = &_M_body;
+			// If no index file has been found...
+			if (!index) {
+				// If the directory listing is not enabled...
+				dirlisting* dirlisting;
+				if ((dirlisting = _M_vhost->get_directory_listing()) == NULL) {
+					return error::NOT_FOUND;
+				}
 
-			_M_state = (_M_method == method::HEAD) ? kSendingHeaders : kSendingTwoBuffers;
+				// Build directory listing.
+				if (!dirlisting->build(path + rootlen, pathlen - rootlen, _M_body)) {
+					return error::INTERNAL_SERVER_ERROR;
+				}
 
-			return 0;
+				return prepare_body_response("text/html; charset=UTF-8", 24);
+			}
+		} else if (!S_ISREG(buf.st_mode)) {
+			return error::NOT_FOUND;
 		}
-	} else if (!S_ISREG(buf.st_mode)) {
-		return error::NOT_FOUND;
 	}
 
-	_M_filesize = buf.st_size;
+	// Status of the file (not of the variant).
+	struct stat filebuf = buf;
 
-	// File.
-	if ((_M_method == method::GET) && (_M_filesize > 0)) {
-		if (!_M_file.open(path, O_RDONLY)) {
-			return error::INTERNAL_SERVER_ERROR;
+	// Get MIME type.
+	if (!index) {
+		unsigned short extlen;
+		if ((_M_extension == 0) || ((extlen = _M_path.length() - _M_extension) == 0)) {
+			_M_mime_type = mime::types::DEFAULT_MIME_TYPE;
+			_M_mime_type_len = mime::types::DEFAULT_MIME_TYPE_LEN;
+		} else {
+			_M_mime_type = static_cast<server*>(_M_server)->mime_type(_M_path.data() + _M_extension, extlen, _M_mime_type_len);
 		}
 	}
 
-	// If the If-Modified-Since header is present...
-	time_t t;
-	if (_M_headers.get_header_time(header_name::IF_MODIFIED_SINCE, t)) {
-		_M_last_modified = buf.st_mtime;
+	// Content codings accepted by the client.
+	unsigned accepted = 0;
+	if ((_M_vhost->precompressed()) || (_M_vhost->compression())) {
+		accepted = accepted_encodings();
+	}
 
-		if (t == _M_last_modified) {
-			return error::NOT_MODIFIED;
+	// Precompressed variant ("file.css.br", "file.css.gz"...)?
+	if (_M_vhost->precompressed()) {
+		if (_M_open_file) {
+			const open_file_cache::variant* variants = _M_open_file->variants;
+
+			select_variant(variants, buf, accepted);
+
+			// The descriptor of the variant is owned by the entry.
+			if (_M_encoding != content_encoding::IDENTITY) {
+				buf = variants[_M_encoding].buf;
+				_M_file.fd(variants[_M_encoding].fd);
+			}
+		} else {
+			// The variants are opened only if the body is sent.
+			open_file_cache::variant variants[content_encoding::COUNT];
+			stat_variants(path, pathlen, variants);
+
+			select_variant(variants, buf, accepted);
+
+			if (_M_encoding != content_encoding::IDENTITY) {
+				buf = variants[_M_encoding].buf;
+			}
 		}
 	}
 
-	if (!_M_headers.get_ranges(_M_filesize, _M_ranges)) {
-		_M_ranges.reset();
-
-		if (!_M_out.append("HTTP/1.1 200 OK\r\n", 17)) {
-			return error::INTERNAL_SERVER_ERROR;
+	// Compressed on the fly (full responses of cached files)?
+	const string::buffer* compressed = NULL;
+	if ((_M_encoding == content_encoding::IDENTITY) &&
+	    (_M_vhost->compression()) &&
+	    (_M_open_file) &&
+	    (static_cast<server*>(_M_server)->compression().enabled()) &&
+	    (static_cast<server*>(_M_server)->compressible(_M_mime_type, _M_mime_type_len, buf.st_size))) {
+		_M_vary = 1;
+
+		if (!_M_headers.get_header_value(header_name::RANGE)) {
+			compressed = compressed_file(accepted);
 		}
+	}
+
+	_M_filesize = buf.st_size;
+	_M_last_modified = buf.st_mtime;
+
+	// ETag and Last-Modified (of the file, with the content coding).
+	const file_headers_cache::entry* e = static_cast<server*>(_M_server)->file_headers(buf, _M_encoding);
+
+	// Conditional request (evaluated before opening the file)?
+	if ((ret = evaluate_preconditions(e)) != 0) {
+		return ret;
+	}
+
+	// Range request (a full response is sent if the If-Range condition is
+	// false)?
+	if ((!_M_headers.get_ranges(_M_filesize, _M_ranges)) || (!if_range(e))) {
+		_M_ranges.reset();
 	} else if (_M_ranges.count() == 0) {
 		return error::REQUESTED_RANGE_NOT_SATISFIABLE;
 	} else {
-		if (!_M_out.append("HTTP/1.1 206 Partial Content\r\n", 30)) {
+		// Too many bytes requested (overlapping ranges)?
+		off_t max = static_cast<server*>(_M_server)->max_range_bytes();
+		if ((max > 0) && (_M_ranges.length() > max)) {
+			return error::REQUESTED_RANGE_NOT_SATISFIABLE;
+		}
+
+		_M_ranges.coalesce();
+
+		if ((_M_ranges.count() > 1) && (_M_encoding != content_encoding::IDENTITY)) {
+			// The parts of a multipart response can't carry the content
+			// coding: send the whole variant.
+			_M_ranges.reset();
+		}
+	}
+
+	if (compressed) {
+		_M_filesize = compressed->length();
+	}
+
+	// File (if not opened yet).
+	if ((_M_method == method::GET) && (_M_filesize > 0) && (_M_file.fd() == -1)) {
+		if (!open_file(path, pathlen, keylen, filebuf, buf, index, now)) {
 			return error::INTERNAL_SERVER_ERROR;
 		}
 	}
 
-	if (!add_common_headers(_M_headers)) {
+	_M_bodysize = compute_content_length();
+
+	if (_M_ranges.count() > 1) {
+		_M_boundary = static_cast<server*>(_M_server)->boundary();
+	}
+
+	if (!add_file_headers(e)) {
 		return error::INTERNAL_SERVER_ERROR;
 	}
 
-	char buffer[128];
-	header_value value;
-	value.value = buffer;
-	value.len = snprintf(buffer, sizeof(buffer), "\"%x-%x\"", buf.st_mtime, _M_filesize);
+	// Multipart response: the headers of the parts are built at once.
+	if ((_M_ranges.count() > 1) && (_M_method == method::GET)) {
+		if (!build_parts()) {
+			return error::INTERNAL_SERVER_ERROR;
+		}
 
-	if (!_M_headers.add(header_name::ETAG, value)) {
-		return error::INTERNAL_SERVER_ERROR;
+		_M_state = kSendingParts;
+		return 0;
 	}
 
-	if (!_M_headers.add(header_name::ACCEPT_RANGES, header_value("bytes", 5))) {
-		return error::INTERNAL_SERVER_ERROR;
+	// Body compressed on the fly (served from memory)?
+	if ((compressed) && (_M_method == method::GET)) {
+		_M_bodyp = compressed;
+		_M_state = kSendingTwoBuffers;
+		return 0;
 	}
 
-	// Add MIME type.
-	if (!index) {
+	// Small file served from memory (headers and body with a single
+	// writev())?
+	if ((_M_open_file) && (_M_encoding == content_encoding::IDENTITY) && (_M_ranges.count() == 0) && (_M_method == method::GET) && (_M_vhost->memory_cache())) {
+		if ((_M_bodyp = cache.body(_M_open_file)) != NULL) {
+			_M_state = kSendingTwoBuffers;
+			return 0;
+		}
+	}
+
+	_M_state = kSendingHeaders;
+
+	return 0;
+}
+
+void net::internet::http::connection::open_variants(char* path, size_t pathlen, open_file_cache::variant* variants)
+{
+	for (unsigned char i = 0; i < content_encoding::COUNT; i++) {
+		variants[i].fd = -1;
+		variants[i].buf.st_mode = 0;
+
 		unsigned short extlen;
-		if ((_M_extension == 0) || ((extlen = _M_path.length() - _M_extension) == 0)) {
-			_M_mime_type = mime::types::DEFAULT_MIME_TYPE;
-			_M_mime_type_len = mime::types::DEFAULT_MIME_TYPE_LEN;
-		} else {
-			_M_mime_type = static_cast<server*>(_M_server)->mime_type(_M_path.data() + _M_extension, extlen, _M_mime_type_len);
+		const char* extension = content_encoding::extension(i, extlen);
+
+		if (pathlen + extlen <= PATH_MAX) {
+			memcpy(path + pathlen, extension, extlen + 1);
+
+			int fd;
+			if ((fd = open(path, O_RDONLY)) != -1) {
+				if ((fstat(fd, &variants[i].buf) == 0) && (S_ISREG(variants[i].buf.st_mode))) {
+					variants[i].fd = fd;
+				} else {
+					variants[i].buf.st_mode = 0;
+					close(fd);
+				}
+			}
 		}
 	}
 
-	if (!_M_headers.add(header_name::CONTENT_TYPE, header_value(_M_mime_type, _M_mime_type_len))) {
-		return error::INTERNAL_SERVER_ERROR;
+	path[pathlen] = 0;
+}
+
+void net::internet::http::connection::stat_variants(char* path, size_t pathlen, open_file_cache::variant* variants)
+{
+	for (unsigned char i = 0; i < content_encoding::COUNT; i++) {
+		variants[i].fd = -1;
+		variants[i].buf.st_mode = 0;
+
+		unsigned short extlen;
+		const char* extension = content_encoding::extension(i, extlen);
+
+		if (pathlen + extlen <= PATH_MAX) {
+			memcpy(path + pathlen, extension, extlen + 1);
+
+			if ((stat(path, &variants[i].buf) < 0) || (!S_ISREG(variants[i].buf.st_mode))) {
+				variants[i].buf.st_mode = 0;
+			}
+		}
 	}
 
-	_M_bodysize = compute_content_length();
-	if (!_M_headers.add(header_name::CONTENT_LENGTH, _M_bodysize)) {
-		return error::INTERNAL_SERVER_ERROR;
+	path[pathlen] = 0;
+}
+
+bool net::internet::http::connection::open_file(char* path, size_t pathlen, size_t keylen, const struct stat& filebuf, const struct stat& buf, const char* index, unsigned now)
+{
+	open_file_cache& cache = static_cast<server*>(_M_server)->open_files();
+
+	if (cache.enabled()) {
+		int fd;
+		if ((fd = open(path, O_RDONLY)) < 0) {
+			return false;
+		}
+
+		struct stat st;
+		if ((fstat(fd, &st) == 0) && (same_file(st, filebuf))) {
+			// The precompressed variants are looked up once per entry.
+			if ((_M_open_file = cache.add(_M_vhost->parent(), path, keylen, path, fd, st, index ? _M_mime_type : NULL, index ? _M_mime_type_len : 0, now)) != NULL) {
+				if (_M_vhost->precompressed()) {
+					open_variants(path, pathlen, _M_open_file->variants);
+				}
+
+				if (_M_encoding == content_encoding::IDENTITY) {
+					_M_file.fd(fd);
+					return true;
+				}
+
+				// The descriptor of the variant is owned by the entry.
+				const open_file_cache::variant* v = &_M_open_file->variants[_M_encoding];
+				if ((v->fd != -1) && (same_file(v->buf, buf))) {
+					_M_file.fd(v->fd);
+					return true;
+				}
+
+				// The variant has changed: the entry is kept in the
+				// cache, but not used by this response.
+				_M_open_file->release();
+				_M_open_file = NULL;
+
+				fd = -1;
+			}
+		}
+
+		if (fd != -1) {
+			if (_M_encoding == content_encoding::IDENTITY) {
+				_M_file.fd(fd);
+				return true;
+			}
+
+			close(fd);
+		}
 	}
 
-	if (!_M_headers.add_time(header_name::LAST_MODIFIED, buf.st_mtime)) {
-		return error::INTERNAL_SERVER_ERROR;
+	if (_M_encoding != content_encoding::IDENTITY) {
+		unsigned short extlen;
+		const char* extension = content_encoding::extension(_M_encoding, extlen);
+		memcpy(path + pathlen, extension, extlen + 1);
 	}
 
-	switch (_M_ranges.count()) {
-		case 0:
-			break;
-		case 1:
-			{
-				const util::range* range = _M_ranges.get(0);
+	return _M_file.open(path, O_RDONLY);
+}
 
-				value.len = snprintf(buffer, sizeof(buffer), "bytes %lld-%lld/%lld", range->from, range->to, _M_filesize);
+unsigned net::internet::http::connection::accepted_encodings() const
+{
+	const header_value* v;
+	if ((v = _M_headers.get_header_value(header_name::ACCEPT_ENCODING)) == NULL) {
+		return 0;
+	}
 
-				if (!_M_headers.add(header_name::CONTENT_RANGE, value)) {
-					return error::INTERNAL_SERVER_ERROR;
-				}
+	return content_encoding::accepted(v->value, v->len);
+}
+
+void net::internet::http::connection::select_variant(const open_file_cache::variant* variants, const struct stat& buf, unsigned accepted)
+{
+	// The smallest variant accepted, if smaller than the file (on a tie,
+	// the first one: br, zstd, gzip).
+	off_t size = buf.st_size;
+
+	for (unsigned char i = 0; i < content_encoding::COUNT; i++) {
+		if (variants[i].buf.st_mode != 0) {
+			_M_vary = 1;
+
+			if ((accepted & (1 << i)) && (variants[i].buf.st_size < size)) {
+				_M_encoding = i;
+				size = variants[i].buf.st_size;
 			}
+		}
+	}
+}
 
-			break;
-		default:
-			_M_boundary = static_cast<server*>(_M_server)->boundary();
+const string::buffer* net::internet::http::connection::compressed_file(unsigned accepted)
+{
+	unsigned char encoding;
+	if ((encoding = compressor::select(accepted)) == content_encoding::IDENTITY) {
+		return NULL;
+	}
+
+	server* srv = static_cast<server*>(_M_server);
+
+	const string::buffer* body;
+	if ((body = srv->open_files().compressed(_M_open_file, encoding)) != NULL) {
+		_M_encoding = encoding;
+		return body;
+	}
+
+	// Compress the file in background (this response is sent
+	// uncompressed).
+	if ((_M_open_file->compressing & (1 << encoding)) == 0) {
+		srv->compression().compress(_M_open_file, encoding);
+	}
+
+	return NULL;
+}
+
+unsigned short net::internet::http::connection::evaluate_preconditions(const file_headers_cache::entry* e) const
+{
+	const header_value* v;
+	time_t t;
+
+	// If-Match (strong comparison) or, if not present, If-Unmodified-Since.
+	if ((v = _M_headers.get_header_value(header_name::IF_MATCH)) != NULL) {
+		if (!match_etag(v, e, false)) {
+			return error::PRECONDITION_FAILED;
+		}
+	} else if (_M_headers.get_header_time(header_name::IF_UNMODIFIED_SINCE, t)) {
+		if (_M_last_modified > t) {
+			return error::PRECONDITION_FAILED;
+		}
+	}
+
+	// If-None-Match (weak comparison) or, if not present, If-Modified-Since.
+	// Only GET and HEAD are supported: a match means "304 Not Modified".
+	if ((v = _M_headers.get_header_value(header_name::IF_NONE_MATCH)) != NULL) {
+		if (match_etag(v, e, true)) {
+			return error::NOT_MODIFIED;
+		}
+	} else if (_M_headers.get_header_time(header_name::IF_MODIFIED_SINCE, t)) {
+		if (_M_last_modified <= t) {
+			return error::NOT_MODIFIED;
+		}
+	}
 
-			value.len = snprintf(buffer, sizeof(buffer), "multipart/byteranges; boundary=%0*u", headers::BOUNDARY_LEN, _M_boundary);
+	return 0;
+}
 
-			if (!_M_headers.add(header_name::CONTENT_TYPE, value)) {
-				return error::INTERNAL_SERVER_ERROR;
+bool net::internet::http::connection::if_range(const file_headers_cache::entry* e) const
+{
+	const header_value* v;
+	if ((v = _M_headers.get_header_value(header_name::IF_RANGE)) == NULL) {
+		return true;
+	}
+
+	// Entity tag (strong comparison)?
+	if (((v->len > 0) && (*v->value == '"')) || ((v->len > 1) && (v->value[0] == 'W') && (v->value[1] == '/'))) {
+		return match_etag(v, e, false);
+	}
+
+	// The date has to match exactly.
+	time_t t;
+	return ((_M_headers.get_header_time(header_name::IF_RANGE, t)) && (t == _M_last_modified));
+}
+
+bool net::internet::http::connection::match_etag(const header_value* v, const file_headers_cache::entry* e, bool weak)
+{
+	const char* tag = e->tag();
+	size_t taglen = e->taglen();
+
+	const char* ptr = v->value;
+	const char* end = ptr + v->len;
+
+	do {
+		// Skip separators.
+		while ((ptr < end) && ((IS_WHITE_SPACE(*ptr)) || (*ptr == ','))) {
+			ptr++;
+		}
+
+		if (ptr == end) {
+			return false;
+		}
+
+		// Any entity tag?
+		if (*ptr == '*') {
+			return true;
+		}
+
+		// Weak entity tag?
+		bool weak_tag;
+		if ((end - ptr > 2) && (ptr[0] == 'W') && (ptr[1] == '/')) {
+			weak_tag = true;
+			ptr += 2;
+		} else {
+			weak_tag = false;
+		}
+
+		if (*ptr != '"') {
+			return false;
+		}
+
+		const char* quote;
+		if ((quote = (const char*) memchr(ptr + 1, '"', end - ptr - 1)) == NULL) {
+			return false;
+		}
+
+		// The entity tags generated by the server are strong.
+		if (((weak) || (!weak_tag)) && ((size_t) (quote + 1 - ptr) == taglen) && (memcmp(ptr, tag, taglen) == 0)) {
+			return true;
+		}
+
+		ptr = quote + 1;
+	} while (true);
+}
+
+bool net::internet::http::connection::add_file_headers(const file_headers_cache::entry* e)
+{
+	// The headers are appended directly to the output buffer, most of them
+	// precomputed (per virtual host or per file).
+	if (_M_ranges.count() == 0) {
+		if (!_M_out.append("HTTP/1.1 200 OK\r\n", 17)) {
+			return false;
+		}
+	} else {
+		if (!_M_out.append("HTTP/1.1 206 Partial Content\r\n", 30)) {
+			return false;
+		}
+	}
+
+	unsigned timeout, max_requests;
+	update_keep_alive(timeout, max_requests);
+
+	unsigned short len;
+	const char* date = _M_server->gmt_date(len);
+	if ((!_M_out.append("Date: ", 6)) || (!_M_out.append(date, len)) || (!_M_out.append("\r\n", 2))) {
+		return false;
+	}
+
+	if (_M_keep_alive) {
+		// If the adaptive keep-alive policy hasn't lowered the timeout...
+		if (timeout == _M_vhost->keep_alive_timeout()) {
+			const char* keep_alive = _M_vhost->keep_alive_header(len);
+			if (!_M_out.append(keep_alive, len)) {
+				return false;
+			}
+		} else {
+			if (!_M_out.format("Connection: Keep-Alive\r\nKeep-Alive: timeout=%u", timeout)) {
+				return false;
+			}
+		}
+
+		if (max_requests > 0) {
+			if (!_M_out.format(", max=%u\r\n", max_requests - _M_nrequests)) {
+				return false;
+			}
+		} else {
+			if (!_M_out.append("\r\n", 2)) {
+				return false;
 			}
+		}
+	} else {
+		if (!_M_out.append("Connection: close\r\n", 19)) {
+			return false;
+		}
 	}
 
-	if (!_M_headers.serialize(_M_out)) {
-		return error::INTERNAL_SERVER_ERROR;
+	// Full response of a cached file: the rest of the headers are built
+	// once per file.
+	if ((_M_ranges.count() == 0) && (_M_open_file) && (_M_encoding == content_encoding::IDENTITY)) {
+		const string::buffer* h;
+		if ((h = static_cast<server*>(_M_server)->open_files().headers(_M_open_file, _M_mime_type, _M_mime_type_len, e, _M_vary)) == NULL) {
+			return false;
+		}
+
+		return _M_out.append(h->data(), h->length());
 	}
 
-	if ((_M_ranges.count() > 1) && (_M_method == method::GET)) {
-		if (!build_part_header()) {
-			return error::INTERNAL_SERVER_ERROR;
+	if ((!_M_out.append("Server: " WEBSERVER_NAME "\r\n", 8 + sizeof(WEBSERVER_NAME) - 1 + 2)) || (!_M_out.append(e->etag, e->etaglen)) || (!_M_out.append("Accept-Ranges: bytes\r\n", 22))) {
+		return false;
+	}
+
+	if (_M_ranges.count() <= 1) {
+		if ((!_M_out.append("Content-Type: ", 14)) || (!_M_out.append(_M_mime_type, _M_mime_type_len)) || (!_M_out.append("\r\n", 2))) {
+			return false;
+		}
+
+		if (_M_encoding != content_encoding::IDENTITY) {
+			const char* name = content_encoding::name(_M_encoding, len);
+			if ((!_M_out.append("Content-Encoding: ", 18)) || (!_M_out.append(name, len)) || (!_M_out.append("\r\n", 2))) {
+				return false;
+			}
+		}
+	} else {
+		if (!_M_out.format("Content-Type: multipart/byteranges; boundary=%0*u\r\n", headers::BOUNDARY_LEN, _M_boundary)) {
+			return false;
 		}
 	}
 
-	if ((_M_method == method::GET) && (_M_filesize > 0)) {
-		_M_socket.cork();
+	if ((!_M_out.format("Content-Length: %lld\r\n", _M_bodysize)) || (!_M_out.append(e->last_modified, e->last_modified_len))) {
+		return false;
 	}
 
-	_M_state = kSendingHeaders;
+	if ((_M_vary) && (!_M_out.append("Vary: Accept-Encoding\r\n", 23))) {
+		return false;
+	}
 
-	return 0;
+	if (_M_ranges.count() == 1) {
+		const util::range* range = _M_ranges.get(0);
+
+		if (!_M_out.format("Content-Range: bytes %lld-%lld/%lld\r\n", range->from, range->to, _M_filesize)) {
+			return false;
+		}
+	}
+
+	return _M_out.append("\r\n", 2);
 }
 
 off_t net::internet::http::connection::compute_content_length() const
@@ -1657,3 +2348,73 @@ off_t net::internet::http::connection::compute_content_length() const
 			}
 	}
 }
+
+unsigned short net::internet::http::connection::prepare_body_response(const char* content_type, unsigned short content_type_len)
+{
+	// Compress the body (only the small generated bodies, they are
+	// compressed by the event loop at a low level)? The request headers are
+	// reused for the response, Accept-Encoding has to be read first.
+	unsigned char encoding = content_encoding::IDENTITY;
+	bool vary = false;
+
+	if ((_M_vhost->compression()) && (_M_body.length() <= compressor::kMaxInlineLength) && (static_cast<server*>(_M_server)->compressible(content_type, content_type_len, _M_body.length()))) {
+		if ((encoding = compressor::select(accepted_encodings())) != content_encoding::IDENTITY) {
+			// The compressed body is only useful if it's smaller: a
+			// buffer of the size of the body is borrowed from the pool.
+			string::buffer out;
+			if ((borrow_buffer(out, _M_body.length())) && (static_cast<server*>(_M_server)->compression().compress_inline(_M_body.data(), _M_body.length(), encoding, out)) && (out.length() < _M_body.length())) {
+				_M_body.swap(out);
+			} else {
+				encoding = content_encoding::IDENTITY;
+			}
+
+			release_buffer(out);
+		}
+
+		vary = true;
+	}
+
+	// Add common headers.
+	if (!add_common_headers(_M_headers)) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	// Add Content-Type header.
+	if (!_M_headers.add(header_name::CONTENT_TYPE, header_value(content_type, content_type_len))) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	// Add Content-Encoding and Vary headers.
+	if (encoding != content_encoding::IDENTITY) {
+		unsigned short len;
+		const char* name = content_encoding::name(encoding, len);
+		if (!_M_headers.add(header_name::CONTENT_ENCODING, header_value(name, len))) {
+			return error::INTERNAL_SERVER_ERROR;
+		}
+	}
+
+	if ((vary) && (!_M_headers.add(header_name::VARY, header_value("Accept-Encoding", 15)))) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	// Add Content-Length header.
+	if (!_M_headers.add(header_name::CONTENT_LENGTH, (uint64_t) _M_body.length())) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	// Add Status-Line.
+	if (!_M_out.append("HTTP/1.1 200 OK\r\n", 17)) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	// Serialize headers.
+	if (!_M_headers.serialize(_M_out)) {
+		return error::INTERNAL_SERVER_ERROR;
+	}
+
+	_M_bodyp = &_M_body;
+
+	_M_state = (_M_method == method::HEAD) ? kSendingHeaders : kSendingTwoBuffers;
+
+	return 0;
+}
@@ -7,18 +7,30 @@
 #include "net/internet/http/method.h"
 #include "net/internet/http/headers.h"
 #include "net/internet/http/vhost.h"
+#include "net/internet/http/file_headers_cache.h"
+#include "net/internet/http/open_file_cache.h"
 #include "util/ranges.h"
 #include "macros/macros.h"
 
 namespace net {
 	namespace internet {
 		namespace http {
+			namespace http2 {
+				class session;
+				struct stream;
+			}
+
 			struct connection : public tcp_connection {
 				public:
-					static const unsigned kMaxRequestsPerConnection = 10;
-
 					static const size_t kRequestLineMaxLen = 32 * 1024;
 
+					// Initial size of the output buffer.
+					static const size_t kOutputBufferSize = 4 * 1024;
+
+					// Maximum size of the responses queued in the output buffer
+					// (pipelined requests).
+					static const size_t kMaxQueuedResponsesSize = 64 * 1024;
+
 					// HTTP states.
 					static const unsigned char kHandshaking = 0;
 					static const unsigned char kReadingRequestLine = 1;
@@ -29,9 +41,10 @@ namespace net {
 					static const unsigned char kSendingTwoBuffers = 6;
 					static const unsigned char kSendingHeaders = 7;
 					static const unsigned char kSendingBody = 8;
-					static const unsigned char kSendingPartHeader = 9;
-					static const unsigned char kSendingMultipartFooter = 10;
-					static const unsigned char kRequestCompleted = 11;
+					static const unsigned char kSendingParts = 9;
+					static const unsigned char kRequestCompleted = 10;
+					static const unsigned char kSendingQueuedResponses = 11;
+					static const unsigned char kHttp2 = 12;
 
 					// HTTP versions.
 					static const unsigned char HTTP_0_9 = 0;
@@ -46,8 +59,17 @@ namespace net {
 					unsigned _M_nrange;
 					unsigned _M_boundary;
 
+					// Multipart response: the headers of all the parts and the
+					// footer are built in _M_out after the headers of the
+					// response. The part 'i' is sent after _M_out up to
+					// _M_parts[i] (from the end of the previous part).
+					size_t _M_parts[headers::MAX_RANGES];
+
 					unsigned short _M_nrequests;
 
+					// Keep-alive timeout advertised to the client [seconds].
+					unsigned short _M_keep_alive_timeout;
+
 					unsigned short _M_url;
 					unsigned short _M_urllen;
 
@@ -79,8 +101,16 @@ namespace net {
 
 					fs::file _M_file;
 					off_t _M_filesize;
+
+					// Entry of the cache of open files which holds the
+					// descriptor of _M_file (NULL if _M_file owns it).
+					open_file_cache::entry* _M_open_file;
 					time_t _M_last_modified;
 
+					// Content coding of the file sent (a precompressed
+					// variant) or content_encoding::IDENTITY.
+					unsigned char _M_encoding;
+
 					off_t _M_bodysize;
 
 					unsigned _M_substate:5;
@@ -94,6 +124,30 @@ namespace net {
 					unsigned _M_http_version:2;
 					unsigned _M_keep_alive:1;
 
+					// Has the response been queued in the output buffer?
+					unsigned _M_response_queued:1;
+
+					// Does the file have precompressed variants ("Vary:
+					// Accept-Encoding")?
+					unsigned _M_vary:1;
+
+					// State to resume after sending the queued responses.
+					unsigned _M_resume_state:5;
+
+					// No request has been received yet?
+					unsigned _M_new_connection:1;
+
+					// Multipart response: is the body of the part _M_nrange
+					// being sent (or the data in _M_out before it)?
+					unsigned _M_part_body:1;
+
+					// HTTP/2 session (NULL for HTTP/1.x connections).
+					http2::session* _M_http2;
+
+					// Slab of the connection (index in the slabs of the
+					// server).
+					size_t _M_slab;
+
 					// Constructor.
 					connection();
 
@@ -103,6 +157,9 @@ namespace net {
 					// Free.
 					virtual void free();
 
+					// Release the I/O buffers.
+					virtual void release_buffers();
+
 					// Reset.
 					virtual void reset();
 
@@ -115,24 +172,108 @@ namespace net {
 					// Add common headers.
 					bool add_common_headers(headers& h);
 
+					// Process a request received on an HTTP/2 stream (translated
+					// to HTTP/1.1): the response headers are built in 'response'
+					// and the body is handed over to the stream.
+					bool process_http2_request(string::buffer& request, string::buffer& response, http2::stream& s);
+
 				private:
+					friend class http2::session;
+
+					// Start HTTP/2 session.
+					bool start_http2();
+
+					// Free HTTP/2 session.
+					void free_http2();
+
 					// Reset.
 					void _reset();
 
+					// Close the file of the response (or release it if it
+					// belongs to the cache of open files).
+					void close_file();
+
+					// Decide whether the connection is kept alive after the
+					// current request.
+					void update_keep_alive(unsigned& timeout, unsigned& max_requests);
+
 					// Parse request line.
 					unsigned short parse_request_line();
 
+					// Get number of characters which can be skipped after the
+					// current one without exceeding kRequestLineMaxLen.
+					size_t skip_limit() const;
+
 					// Parse path.
 					unsigned short parse_path();
 
 					// Process request.
 					unsigned short process_request();
 
+					// Queue the response in the output buffer (if there are
+					// pipelined requests and the response is held in memory).
+					bool queue_response();
+
+					// Send the queued responses before reading more data.
+					bool send_queued_responses();
+
+					// Prepare 200 response with _M_body as body.
+					unsigned short prepare_body_response(const char* content_type, unsigned short content_type_len);
+
+					// Open the precompressed variants of the file 'path'
+					// (the variants not found have fd = -1 and
+					// st_mode = 0).
+					static void open_variants(char* path, size_t pathlen, open_file_cache::variant* variants);
+
+					// Get the status of the precompressed variants of the
+					// file 'path' without opening them (fd = -1; the
+					// variants not found have st_mode = 0).
+					static void stat_variants(char* path, size_t pathlen, open_file_cache::variant* variants);
+
+					// Open the file (or the variant selected) to send its
+					// body and add it to the cache of open files.
+					// 'filebuf' and 'buf' are the status of the file and of
+					// the variant when the request was evaluated; if the
+					// file has been replaced since then, it is not cached.
+					bool open_file(char* path, size_t pathlen, size_t keylen, const struct stat& filebuf, const struct stat& buf, const char* index, unsigned now);
+
+					// Are both the same version of the same file?
+					static bool same_file(const struct stat& buf1, const struct stat& buf2);
+
+					// Get the content codings accepted by the client
+					// (bitmask of 1 << encoding).
+					unsigned accepted_encodings() const;
+
+					// Select the smallest precompressed variant accepted by
+					// the client (sets _M_encoding and _M_vary).
+					void select_variant(const open_file_cache::variant* variants, const struct stat& buf, unsigned accepted);
+
+					// Get the file compressed on the fly (sets _M_encoding)
+					// or, if not compressed yet, start compressing it.
+					const string::buffer* compressed_file(unsigned accepted);
+
+					// Evaluate the preconditions of the request (RFC 7232):
+					// returns 0 if the request has to be processed,
+					// NOT_MODIFIED or PRECONDITION_FAILED otherwise.
+					unsigned short evaluate_preconditions(const file_headers_cache::entry* e) const;
+
+					// Does the If-Range condition (if any) allow a partial
+					// response?
+					bool if_range(const file_headers_cache::entry* e) const;
+
+					// Does the list of entity tags match the entity tag
+					// of the file?
+					static bool match_etag(const header_value* v, const file_headers_cache::entry* e, bool weak);
+
+					// Add the response headers of a file to _M_out.
+					bool add_file_headers(const file_headers_cache::entry* e);
+
 					// Compute Content-Length.
 					off_t compute_content_length() const;
 
-					// Build part header.
-					bool build_part_header();
+					// Build the headers of the parts and the footer of a
+					// multipart response.
+					bool build_parts();
 
 					static int hex(const char* src, const char* end);
 			};
@@ -140,28 +281,55 @@ namespace net {
 			inline connection::connection() : _M_file(-1)
 			{
 				_M_nrange = 0;
+				_M_part_body = 0;
+
+				_M_vhost = NULL;
 
 				_M_nrequests = 0;
+				_M_keep_alive_timeout = 0;
+
 				_M_substate = 0;
 
 				_M_http_version = HTTP_0_9;
 				_M_keep_alive = 0;
+
+				_M_response_queued = 0;
+				_M_vary = 0;
+
+				_M_new_connection = 1;
+
+				_M_http2 = NULL;
+
+				_M_open_file = NULL;
+				_M_encoding = content_encoding::IDENTITY;
 			}
 
 			inline connection::~connection()
 			{
-				if (_M_file.fd() != -1) {
-					_M_file.close();
-				}
+				close_file();
+
+				free_http2();
 			}
 
 			inline void connection::free()
 			{
-				tcp_connection::free();
-
 				_M_nrequests = 0;
 
 				_reset();
+
+				_M_new_connection = 1;
+
+				free_http2();
+
+				tcp_connection::free();
+			}
+
+			inline void connection::release_buffers()
+			{
+				tcp_connection::release_buffers();
+
+				release_buffer(_M_path);
+				release_buffer(_M_body);
 			}
 
 			inline void connection::reset()
@@ -170,12 +338,35 @@ namespace net {
 				_reset();
 			}
 
+			inline bool connection::same_file(const struct stat& buf1, const struct stat& buf2)
+			{
+				return ((buf1.st_ino == buf2.st_ino) &&
+				        (buf1.st_dev == buf2.st_dev) &&
+				        (buf1.st_size == buf2.st_size) &&
+				        (buf1.st_mtime == buf2.st_mtime));
+			}
+
+			inline void connection::close_file()
+			{
+				if (_M_open_file) {
+					_M_open_file->release();
+					_M_open_file = NULL;
+				} else if (_M_file.fd() != -1) {
+					_M_file.close();
+				}
+
+				_M_file.fd(-1);
+			}
+
 			inline void connection::_reset()
 			{
 				_M_headers.reset();
 
+				_M_vhost = NULL;
+
 				_M_ranges.reset();
 				_M_nrange = 0;
+				_M_part_body = 0;
 
 				if (_M_path.capacity() > 32) {
 					_M_path.free();
@@ -189,22 +380,68 @@ namespace net {
 					_M_body.clear();
 				}
 
-				if (_M_file.fd() != -1) {
-					_M_file.close();
-					_M_file.fd(-1);
-				}
+				close_file();
+
+				_M_encoding = content_encoding::IDENTITY;
 
 				_M_substate = 0;
 
 				_M_http_version = HTTP_0_9;
 				_M_keep_alive = 0;
+
+				_M_response_queued = 0;
+				_M_vary = 0;
 			}
 
-			inline bool connection::build_part_header()
+			inline size_t connection::skip_limit() const
 			{
-				const util::range* range = _M_ranges.get(_M_nrange);
+				return ((size_t) _M_inp + 1 < kRequestLineMaxLen) ? kRequestLineMaxLen - _M_inp - 1 : 0;
+			}
+
+			inline bool connection::queue_response()
+			{
+				// If there are no pipelined requests or the connection will be
+				// closed...
+				if ((_M_inp == (off_t) _M_in.length()) || (!_M_keep_alive)) {
+					return false;
+				}
+
+				if (_M_state == kSendingTwoBuffers) {
+					if (_M_out.length() + _M_bodyp->length() > kMaxQueuedResponsesSize) {
+						return false;
+					}
+
+					if (!_M_out.append(_M_bodyp->data(), _M_bodyp->length())) {
+						return false;
+					}
+				} else if ((_M_method != method::HEAD) && (_M_filesize > 0)) {
+					// The body has to be read from a file.
+					return false;
+				} else if (_M_out.length() > kMaxQueuedResponsesSize) {
+					return false;
+				}
+
+				_M_response_queued = 1;
+
+				_M_state = kRequestCompleted;
+
+				return true;
+			}
+
+			inline bool connection::build_parts()
+			{
+				size_t nranges = _M_ranges.count();
+				for (size_t i = 0; i < nranges; i++) {
+					const util::range* range = _M_ranges.get(i);
+
+					if (!_M_out.format("\r\n--%0*u\r\nContent-Type: %.*s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n", headers::BOUNDARY_LEN, _M_boundary, _M_mime_type_len, _M_mime_type, range->from, range->to, _M_filesize)) {
+						return false;
+					}
+
+					_M_parts[i] = _M_out.length();
+				}
 
-				return _M_out.format("\r\n--%0*u\r\nContent-Type: %.*s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n", headers::BOUNDARY_LEN, _M_boundary, _M_mime_type_len, _M_mime_type, range->from, range->to, _M_filesize);
+				return _M_out.format("\r\n--%0*u--\r\n", headers::BOUNDARY_LEN, _M_boundary);
 			}
 
 			inline int connection::hex(const char* src, const char* end)
@@ -0,0 +1,93 @@
+#include <string.h>
+#include <strings.h>
+#include "net/internet/http/content_encoding.h"
+#include "macros/macros.h"
+
+const struct net::internet::http::content_encoding::_encoding net::internet::http::content_encoding::_M_encodings[] = {
+	{"br", 2, ".br", 3},
+	{"zstd", 4, ".zst", 4},
+	{"gzip", 4, ".gz", 3}
+};
+
+unsigned net::internet::http::content_encoding::accepted(const char* value, size_t len)
+{
+	// Content codings accepted and rejected (q=0) explicitly.
+	unsigned accepted = 0;
+	unsigned rejected = 0;
+
+	// Has "*" been accepted?
+	bool any = false;
+
+	const char* end = value + len;
+	const char* ptr = value;
+
+	while (ptr < end) {
+		// Skip separators.
+		while ((ptr < end) && ((*ptr == ',') || (IS_WHITE_SPACE(*ptr)))) {
+			ptr++;
+		}
+
+		if (ptr == end) {
+			break;
+		}
+
+		// Content coding.
+		const char* coding = ptr;
+		while ((ptr < end) && (*ptr != ',') && (*ptr != ';') && (!IS_WHITE_SPACE(*ptr))) {
+			ptr++;
+		}
+
+		size_t codinglen = ptr - coding;
+
+		// Weight (only "q=0", "q=0.0"... matter).
+		bool zero = false;
+		while ((ptr < end) && (*ptr != ',')) {
+			if ((*ptr == ';') || (IS_WHITE_SPACE(*ptr))) {
+				ptr++;
+			} else if ((ptr + 1 < end) && ((*ptr == 'q') || (*ptr == 'Q')) && (ptr[1] == '=')) {
+				ptr += 2;
+
+				if ((ptr < end) && (*ptr == '0')) {
+					zero = true;
+
+					if ((++ptr < end) && (*ptr == '.')) {
+						while ((++ptr < end) && (IS_DIGIT(*ptr))) {
+							if (*ptr != '0') {
+								zero = false;
+							}
+						}
+					}
+				}
+			} else {
+				ptr++;
+			}
+		}
+
+		unsigned bit;
+		if ((codinglen == 2) && (strncasecmp(coding, "br", 2) == 0)) {
+			bit = 1 << BROTLI;
+		} else if ((codinglen == 4) && (strncasecmp(coding, "zstd", 4) == 0)) {
+			bit = 1 << ZSTD;
+		} else if (((codinglen == 4) && (strncasecmp(coding, "gzip", 4) == 0)) ||
+		           ((codinglen == 6) && (strncasecmp(coding, "x-gzip", 6) == 0))) {
+			bit = 1 << GZIP;
+		} else if ((codinglen == 1) && (*coding == '*')) {
+			any = !zero;
+			continue;
+		} else {
+			continue;
+		}
+
+		if (zero) {
+			rejected |= bit;
+		} else {
+			accepted |= bit;
+		}
+	}
+
+	if (any) {
+		accepted |= (((1 << COUNT) - 1) & ~rejected);
+	}
+
+	return (accepted & ~rejected);
+}
@@ -0,0 +1,57 @@
+#ifndef HTTP_CONTENT_ENCODING_H
+#define HTTP_CONTENT_ENCODING_H
+
+#include <stdlib.h>
+
+namespace net {
+	namespace internet {
+		namespace http {
+			// Content codings of the precompressed files (siblings of the
+			// file with an extra extension: "file.css.br").
+			struct content_encoding {
+				public:
+					static const unsigned char BROTLI   = 0;
+					static const unsigned char ZSTD     = 1;
+					static const unsigned char GZIP     = 2;
+					static const unsigned char COUNT    = 3;
+					static const unsigned char IDENTITY = COUNT;
+
+					// Get name ("br", "zstd", "gzip").
+					static const char* name(unsigned char encoding, unsigned short& len);
+
+					// Get extension of the precompressed file (".br", ".zst",
+					// ".gz").
+					static const char* extension(unsigned char encoding, unsigned short& len);
+
+					// Parse Accept-Encoding (returns the content codings
+					// accepted, as a bitmask of 1 << encoding).
+					static unsigned accepted(const char* value, size_t len);
+
+				private:
+					struct _encoding {
+						const char* name;
+						unsigned short len;
+
+						const char* extension;
+						unsigned short extension_len;
+					};
+
+					static const struct _encoding _M_encodings[];
+			};
+
+			inline const char* content_encoding::name(unsigned char encoding, unsigned short& len)
+			{
+				len = _M_encodings[encoding].len;
+				return _M_encodings[encoding].name;
+			}
+
+			inline const char* content_encoding::extension(unsigned char encoding, unsigned short& len)
+			{
+				len = _M_encodings[encoding].extension_len;
+				return _M_encodings[encoding].extension;
+			}
+		}
+	}
+}
+
+#endif // HTTP_CONTENT_ENCODING_H
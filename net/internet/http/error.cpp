@@ -5,8 +5,6 @@
 #include "net/internet/default_ports.h"
 #include "macros/macros.h"
 
-net::internet::http::headers net::internet::http::error::_M_headers;
-
 struct net::internet::http::error::err net::internet::http::error::_M_errors[] = {
 	{MOVED_PERMANENTLY, "Moved Permanently"},
 	{NOT_MODIFIED, "Not Modified"},
@@ -14,6 +12,7 @@ struct net::internet::http::error::err net::internet::http::error::_M_errors[] =
 	{FORBIDDEN, "Forbidden"},
 	{NOT_FOUND, "Not Found"},
 	{LENGTH_REQUIRED, "Length Required"},
+	{PRECONDITION_FAILED, "Precondition Failed"},
 	{REQUEST_ENTITY_TOO_LARGE, "Request Entity Too Large"},
 	{REQUEST_URI_TOO_LONG, "Request-URI Too Long"},
 	{REQUESTED_RANGE_NOT_SATISFIABLE, "Requested Range Not Satisfiable"},
@@ -29,6 +28,9 @@ bool net::internet::http::error::init()
 	for (unsigned i = 0; i < ARRAY_SIZE(_M_errors); i++) {
 		err* e = &_M_errors[i];
 		if (e->status_code != NOT_MODIFIED) {
+			// Every worker calls init().
+			e->body.clear();
+
 			if (!e->body.format(
 				"<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
 				"<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\""
@@ -61,7 +63,10 @@ bool net::internet::http::error::build_page(connection& conn, unsigned short sta
 		return false;
 	}
 
-	if (!conn.add_common_headers(_M_headers)) {
+	// The request headers are not needed anymore, reuse them for the response.
+	headers& h = conn._M_headers;
+
+	if (!conn.add_common_headers(h)) {
 		return false;
 	}
 
@@ -92,28 +97,38 @@ bool net::internet::http::error::build_page(connection& conn, unsigned short sta
 				}
 			}
 
-			if (!_M_headers.add(header_name::LOCATION, value)) {
+			if (!h.add(header_name::LOCATION, value)) {
 				return false;
 			}
 
-			if (!_M_headers.add(header_name::CONTENT_TYPE, header_value("text/html; charset=UTF-8", 24))) {
+			if (!h.add(header_name::CONTENT_TYPE, header_value("text/html; charset=UTF-8", 24))) {
 				return false;
 			}
 
-			if (!_M_headers.add(header_name::CONTENT_LENGTH, (uint64_t) e->body.length())) {
+			if (!h.add(header_name::CONTENT_LENGTH, (uint64_t) e->body.length())) {
 				return false;
 			}
 
 			break;
 		case NOT_MODIFIED:
-			value.len = snprintf(buffer, sizeof(buffer), "\"%x-%x\"", conn._M_last_modified, conn._M_filesize);
+			if (conn._M_encoding == content_encoding::IDENTITY) {
+				value.len = snprintf(buffer, sizeof(buffer), "\"%x-%x\"", conn._M_last_modified, conn._M_filesize);
+			} else {
+				unsigned short len;
+				const char* name = content_encoding::name(conn._M_encoding, len);
+				value.len = snprintf(buffer, sizeof(buffer), "\"%x-%x-%.*s\"", conn._M_last_modified, conn._M_filesize, len, name);
+			}
 
-			if (!_M_headers.add(header_name::ETAG, value)) {
+			if (!h.add(header_name::ETAG, value)) {
 				return error::INTERNAL_SERVER_ERROR;
 			}
 
+			if ((conn._M_vary) && (!h.add(header_name::VARY, header_value("Accept-Encoding", 15)))) {
+				return false;
+			}
+
 			// The 304 response MUST NOT contain a message-body.
-			if (!_M_headers.add_time(header_name::LAST_MODIFIED, conn._M_last_modified)) {
+			if (!h.add_time(header_name::LAST_MODIFIED, conn._M_last_modified)) {
 				return false;
 			}
 
@@ -121,17 +136,17 @@ bool net::internet::http::error::build_page(connection& conn, unsigned short sta
 		case REQUESTED_RANGE_NOT_SATISFIABLE:
 			value.len = snprintf(buffer, sizeof(buffer), "bytes */%lld", conn._M_filesize);
 
-			if (!_M_headers.add(header_name::CONTENT_RANGE, value)) {
+			if (!h.add(header_name::CONTENT_RANGE, value)) {
 				return error::INTERNAL_SERVER_ERROR;
 			}
 
 			// Fall through.
 		default:
-			if (!_M_headers.add(header_name::CONTENT_TYPE, header_value("text/html; charset=UTF-8", 24))) {
+			if (!h.add(header_name::CONTENT_TYPE, header_value("text/html; charset=UTF-8", 24))) {
 				return false;
 			}
 
-			if (!_M_headers.add(header_name::CONTENT_LENGTH, (uint64_t) e->body.length())) {
+			if (!h.add(header_name::CONTENT_LENGTH, (uint64_t) e->body.length())) {
 				return false;
 			}
 	}
@@ -140,7 +155,7 @@ bool net::internet::http::error::build_page(connection& conn, unsigned short sta
 		return false;
 	}
 
-	if (!_M_headers.serialize(conn._M_out)) {
+	if (!h.serialize(conn._M_out)) {
 		return false;
 	}
 
@@ -18,6 +18,7 @@ namespace net {
 					static const unsigned short FORBIDDEN = 403;
 					static const unsigned short NOT_FOUND = 404;
 					static const unsigned short LENGTH_REQUIRED = 411;
+					static const unsigned short PRECONDITION_FAILED = 412;
 					static const unsigned short REQUEST_ENTITY_TOO_LARGE = 413;
 					static const unsigned short REQUEST_URI_TOO_LONG = 414;
 					static const unsigned short REQUESTED_RANGE_NOT_SATISFIABLE = 416;
@@ -42,8 +43,6 @@ namespace net {
 
 					static struct err _M_errors[];
 
-					static headers _M_headers;
-
 					static const struct err* search(unsigned short status_code);
 			};
 		}
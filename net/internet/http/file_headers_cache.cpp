@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <time.h>
+#include "net/internet/http/file_headers_cache.h"
+#include "constants/months_and_days.h"
+
+void net::internet::http::file_headers_cache::build(const struct stat& buf, unsigned char encoding, entry* e)
+{
+	e->dev = buf.st_dev;
+	e->ino = buf.st_ino;
+	e->mtime = buf.st_mtime;
+	e->size = buf.st_size;
+	e->encoding = encoding;
+
+	if (encoding == content_encoding::IDENTITY) {
+		e->etaglen = snprintf(e->etag, sizeof(e->etag), "ETag: \"%x-%x\"\r\n", (unsigned) buf.st_mtime, (unsigned) buf.st_size);
+	} else {
+		unsigned short len;
+		const char* name = content_encoding::name(encoding, len);
+
+		e->etaglen = snprintf(e->etag, sizeof(e->etag), "ETag: \"%x-%x-%.*s\"\r\n", (unsigned) buf.st_mtime, (unsigned) buf.st_size, len, name);
+	}
+
+	struct tm tm;
+	gmtime_r(&buf.st_mtime, &tm);
+
+	e->last_modified_len = snprintf(e->last_modified, sizeof(e->last_modified), "Last-Modified: %s, %02u %s %u %02u:%02u:%02u GMT\r\n", constants::days[tm.tm_wday], tm.tm_mday, constants::months[tm.tm_mon], 1900 + tm.tm_year, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
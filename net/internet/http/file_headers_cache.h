@@ -0,0 +1,87 @@
+#ifndef HTTP_FILE_HEADERS_CACHE_H
+#define HTTP_FILE_HEADERS_CACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include "net/internet/http/content_encoding.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			// Cache of the response headers which only depend on the file
+			// metadata (ETag and Last-Modified). The entity tags of the
+			// precompressed files have the content coding appended, so they
+			// don't match the entity tag of the uncompressed file. Each worker
+			// has its own cache, so no locking is needed.
+			class file_headers_cache {
+				public:
+					// Number of entries (power of 2).
+					static const size_t kSize = 256;
+
+					struct entry {
+						dev_t dev;
+						ino_t ino;
+						time_t mtime;
+						off_t size;
+						unsigned char encoding;
+
+						// "ETag: ...\r\n"
+						char etag[40];
+						unsigned char etaglen;
+
+						// "Last-Modified: ...\r\n"
+						char last_modified[48];
+						unsigned char last_modified_len;
+
+						// Get entity tag (with the quotes).
+						const char* tag() const;
+						size_t taglen() const;
+					};
+
+					// Constructor.
+					file_headers_cache();
+
+					// Get entry (built if not in the cache or if the file has
+					// changed).
+					const entry* get(const struct stat& buf, unsigned char encoding = content_encoding::IDENTITY);
+
+				private:
+					entry _M_entries[kSize];
+
+					// Build entry.
+					static void build(const struct stat& buf, unsigned char encoding, entry* e);
+			};
+
+			inline file_headers_cache::file_headers_cache()
+			{
+				memset(_M_entries, 0, sizeof(_M_entries));
+			}
+
+			inline const char* file_headers_cache::entry::tag() const
+			{
+				// Skip "ETag: ".
+				return etag + 6;
+			}
+
+			inline size_t file_headers_cache::entry::taglen() const
+			{
+				// Without "ETag: " and "\r\n".
+				return etaglen - 8;
+			}
+
+			inline const file_headers_cache::entry* file_headers_cache::get(const struct stat& buf, unsigned char encoding)
+			{
+				entry* e = &_M_entries[((size_t) buf.st_ino ^ ((size_t) buf.st_dev * 0x9e3779b9)) & (kSize - 1)];
+
+				if ((e->ino != buf.st_ino) || (e->dev != buf.st_dev) || (e->mtime != buf.st_mtime) || (e->size != buf.st_size) || (e->encoding != encoding) || (e->etaglen == 0)) {
+					build(buf, encoding, e);
+				}
+
+				return e;
+			}
+		}
+	}
+}
+
+#endif // HTTP_FILE_HEADERS_CACHE_H
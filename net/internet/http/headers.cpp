@@ -1,8 +1,9 @@
 #include <string.h>
 #include "net/internet/http/headers.h"
+#include "string/scan.h"
 #include "macros/macros.h"
 
-const struct net::internet::http::standard_header net::internet::http::headers::_M_standard_headers[] = {
+constexpr const struct net::internet::http::standard_header net::internet::http::headers::_M_standard_headers[] = {
 	{"Accept",               6, REQUEST_HEADER,  1, 0},
 	{"Accept-Charset",      14, REQUEST_HEADER,  1, 0},
 	{"Accept-Encoding",     15, REQUEST_HEADER,  1, 0},
@@ -57,6 +58,78 @@ const struct net::internet::http::standard_header net::internet::http::headers::
 	{"WWW-Authenticate",    16, RESPONSE_HEADER, 1, 0}
 };
 
+// Perfect hash of the standard header names: the length and the first and
+// last characters (case-folded) are packed in a key, which is multiplied by
+// a constant chosen so that no two standard header names collide. The
+// lookup table is built at compile time.
+struct net::internet::http::standard_header_hash {
+	static const unsigned kBits = 7;
+	static const uint32_t kMultiplier = 0x4d665167;
+
+	static const unsigned kNumberHeaders = ARRAY_SIZE(headers::_M_standard_headers);
+
+	// Compute hash.
+	static constexpr unsigned hash(const char* name, size_t len)
+	{
+		return (((uint32_t) len | (((unsigned char) name[0] | 0x20) << 8) | (((unsigned char) name[len - 1] | 0x20) << 16)) * kMultiplier) >> (32 - kBits);
+	}
+
+	// Compute hash of the standard header 'i'.
+	static constexpr unsigned hash(unsigned i)
+	{
+		return hash(headers::_M_standard_headers[i].name, headers::_M_standard_headers[i].len);
+	}
+
+	// Get the standard header whose hash is 'h' (searching from 'i').
+	static constexpr unsigned char slot(unsigned h, unsigned i)
+	{
+		return (i == kNumberHeaders) ? header_name::UNKNOWN : (hash(i) == h) ? i : slot(h, i + 1);
+	}
+
+	// Does the standard header 'i' collide with any of the headers from 'j'?
+	static constexpr bool collides(unsigned i, unsigned j)
+	{
+		return (j == kNumberHeaders) ? false : ((hash(i) == hash(j)) || (collides(i, j + 1)));
+	}
+
+	// Is the hash perfect (from the standard header 'i')?
+	static constexpr bool perfect(unsigned i)
+	{
+		return (i == kNumberHeaders) ? true : ((!collides(i, i + 1)) && (perfect(i + 1)));
+	}
+
+	// Get minimum length of the standard header names (from 'i').
+	static constexpr size_t min_len(unsigned i, size_t len)
+	{
+		return (i == kNumberHeaders) ? len : min_len(i + 1, MIN(headers::_M_standard_headers[i].len, len));
+	}
+
+	// Get maximum length of the standard header names (from 'i').
+	static constexpr size_t max_len(unsigned i, size_t len)
+	{
+		return (i == kNumberHeaders) ? len : max_len(i + 1, MAX(headers::_M_standard_headers[i].len, len));
+	}
+};
+
+static_assert(net::internet::http::standard_header_hash::perfect(0), "The hash of the standard header names is not perfect");
+
+static constexpr size_t kStandardHeaderMinLen = net::internet::http::standard_header_hash::min_len(0, (size_t) -1);
+static constexpr size_t kStandardHeaderMaxLen = net::internet::http::standard_header_hash::max_len(0, 0);
+
+#define SLOT(h) net::internet::http::standard_header_hash::slot(h, 0)
+#define SLOTS4(h) SLOT(h), SLOT(h + 1), SLOT(h + 2), SLOT(h + 3)
+#define SLOTS16(h) SLOTS4(h), SLOTS4(h + 4), SLOTS4(h + 8), SLOTS4(h + 12)
+#define SLOTS64(h) SLOTS16(h), SLOTS16(h + 16), SLOTS16(h + 32), SLOTS16(h + 48)
+
+static constexpr unsigned char kStandardHeaderSlots[1 << net::internet::http::standard_header_hash::kBits] = {
+	SLOTS64(0), SLOTS64(64)
+};
+
+#undef SLOTS64
+#undef SLOTS16
+#undef SLOTS4
+#undef SLOT
+
 bool net::internet::http::headers::get_ranges(off_t filesize, util::ranges& ranges) const
 {
 	const header_value* value;
@@ -352,6 +425,14 @@ bool net::internet::http::headers::add(const header_name& name, const header_val
 
 	_M_used++;
 
+	if (name.value != header_name::UNKNOWN) {
+		for (unsigned type = _M_standard_headers[name.value].type; type <= ENTITY_HEADER; type++) {
+			_M_type_end[type]++;
+		}
+
+		update_index(pos);
+	}
+
 	return true;
 }
 
@@ -368,6 +449,18 @@ bool net::internet::http::headers::remove(unsigned char header)
 		memmove(&_M_headers[pos], &_M_headers[pos + 1], (_M_used - pos) * sizeof(struct header));
 	}
 
+	for (unsigned type = _M_standard_headers[header].type; type <= ENTITY_HEADER; type++) {
+		_M_type_end[type]--;
+	}
+
+	// If there is no previous occurrence of the header...
+	if ((pos == 0) || (_M_headers[pos - 1].name.value != header)) {
+		_M_index[header].generation = 0;
+		update_index(pos);
+	} else {
+		update_index(pos - 1);
+	}
+
 	return true;
 }
 
@@ -429,6 +522,13 @@ net::internet::http::headers::parse_result net::internet::http::headers::parse(c
 					if (++_M_state.namelen > header_name::MAX_LEN) {
 						return PARSE_INVALID_HEADER;
 					}
+
+					// Skip the following token characters at once (without
+					// reaching the limits, which are checked one by one).
+					size_t n = MIN(string::scan::token(ptr, end), MIN(header_name::MAX_LEN - _M_state.namelen, skip_limit()));
+					_M_state.namelen += n;
+					_M_state.size += n;
+					ptr += n;
 				} else {
 					return PARSE_INVALID_HEADER;
 				}
@@ -475,6 +575,11 @@ net::internet::http::headers::parse_result net::internet::http::headers::parse(c
 						}
 
 						_M_state.value_end = 0;
+
+						// Skip the following visible characters at once.
+						size_t n = MIN(string::scan::field_content(ptr, end), skip_limit());
+						_M_state.size += n;
+						ptr += n;
 					}
 				} else {
 					return PARSE_INVALID_HEADER;
@@ -603,55 +708,17 @@ bool net::internet::http::headers::serialize(string::buffer& buf) const
 
 unsigned char net::internet::http::headers::search_standard_header(const char* name, size_t len)
 {
-	int i = 0;
-	int j = ARRAY_SIZE(_M_standard_headers) - 1;
-
-	while (i <= j) {
-		int pivot = (i + j) / 2;
-		int ret = strncasecmp(name, _M_standard_headers[pivot].name, len);
-		if (ret < 0) {
-			j = pivot - 1;
-		} else if (ret == 0) {
-			if (len < _M_standard_headers[pivot].len) {
-				j = pivot - 1;
-			} else if (len == _M_standard_headers[pivot].len) {
-				return pivot;
-			} else {
-				i = pivot + 1;
-			}
-		} else {
-			i = pivot + 1;
-		}
+	// No standard header name has this length?
+	if ((len < kStandardHeaderMinLen) || (len > kStandardHeaderMaxLen)) {
+		return header_name::UNKNOWN;
 	}
 
-	return header_name::UNKNOWN;
-}
-
-bool net::internet::http::headers::search(unsigned char header, unsigned& pos) const
-{
-	header_type type = _M_standard_headers[header].type;
-
-	bool ret = false;
-
-	for (pos = 0; pos < _M_used; pos++) {
-		const struct header* h = &_M_headers[pos];
-
-		if (header == h->name.value) {
-			ret = true;
-		} else if (ret) {
-			pos--;
-			return true;
-		} else if ((h->name.value == header_name::UNKNOWN) || ((int) type < (int) _M_standard_headers[h->name.value].type)) {
-			return false;
-		}
+	unsigned char header = kStandardHeaderSlots[standard_header_hash::hash(name, len)];
+	if ((header == header_name::UNKNOWN) || (_M_standard_headers[header].len != len)) {
+		return header_name::UNKNOWN;
 	}
 
-	if (ret) {
-		pos--;
-		return true;
-	} else {
-		return false;
-	}
+	return (strncasecmp(name, _M_standard_headers[header].name, len) == 0) ? header : header_name::UNKNOWN;
 }
 
 bool net::internet::http::headers::search(const char* name, size_t len, unsigned& pos) const
@@ -681,6 +748,18 @@ bool net::internet::http::headers::search(const char* name, size_t len, unsigned
 	}
 }
 
+void net::internet::http::headers::update_index(unsigned pos)
+{
+	// The standard headers are in the positions [0, _M_type_end[ENTITY_HEADER]).
+	// The last occurrence of each header overwrites the previous ones.
+	for (unsigned end = _M_type_end[ENTITY_HEADER]; pos < end; pos++) {
+		index_entry* entry = &_M_index[_M_headers[pos].name.value];
+
+		entry->generation = _M_generation;
+		entry->pos = pos;
+	}
+}
+
 bool net::internet::http::headers::allocate()
 {
 	if (_M_used == _M_size) {
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include "net/internet/http/date.h"
 #include "util/number.h"
@@ -32,6 +33,8 @@ namespace net {
 				unsigned char single_token;
 			};
 
+			struct standard_header_hash;
+
 			bool is_char(unsigned char c);
 			bool is_control(unsigned char c);
 			bool is_separator(unsigned char c);
@@ -94,6 +97,8 @@ namespace net {
 					static const unsigned char WWW_AUTHENTICATE     = 51;
 					static const unsigned char UNKNOWN              = 0xff;
 
+					static const unsigned char NUMBER_STANDARD_HEADERS = WWW_AUTHENTICATE + 1;
+
 					static const size_t MAX_LEN = 256;
 
 					// Constructor.
@@ -138,6 +143,8 @@ namespace net {
 			};
 
 			class headers {
+				friend struct standard_header_hash;
+
 				public:
 					static const size_t HEADERS_MAX_LEN = 64 * 1024;
 					static const size_t BOUNDARY_LEN = 11;
@@ -232,6 +239,32 @@ namespace net {
 
 					bool _M_ignore_errors;
 
+					// Position of the last occurrence of each standard header.
+					// An entry is only valid if its generation matches
+					// _M_generation, so reset() doesn't have to clear the
+					// index.
+					struct index_entry {
+						unsigned short generation;
+						unsigned short pos;
+					};
+
+					index_entry _M_index[header_name::NUMBER_STANDARD_HEADERS];
+					unsigned short _M_generation;
+
+					// End of each group of standard headers of the same
+					// type (the headers are sorted by type).
+					unsigned short _M_type_end[ENTITY_HEADER + 1];
+
+					// Invalidate index.
+					void invalidate_index();
+
+					// Update index from position 'pos'.
+					void update_index(unsigned pos);
+
+					// Get number of characters which can be skipped after the
+					// current one without reaching HEADERS_MAX_LEN.
+					size_t skip_limit() const;
+
 					// Search standard header.
 					static unsigned char search_standard_header(const char* name, size_t len);
 
@@ -246,6 +279,11 @@ namespace net {
 					int clean(const header_value& value, char* dest) const;
 			};
 
+			inline size_t headers::skip_limit() const
+			{
+				return (_M_state.size + 2 < HEADERS_MAX_LEN) ? HEADERS_MAX_LEN - _M_state.size - 2 : 0;
+			}
+
 			inline bool is_char(unsigned char c)
 			{
 				return ((c >= 0) && (c <= 127));
@@ -338,6 +376,11 @@ namespace net {
 				_M_state.reset();
 
 				_M_ignore_errors = ignore_errors;
+
+				memset(_M_index, 0, sizeof(_M_index));
+				_M_generation = 1;
+
+				memset(_M_type_end, 0, sizeof(_M_type_end));
 			}
 
 			inline headers::~headers()
@@ -358,6 +401,8 @@ namespace net {
 				_M_buf.free();
 
 				_M_state.reset();
+
+				invalidate_index();
 			}
 
 			inline void headers::reset()
@@ -366,6 +411,8 @@ namespace net {
 				_M_buf.clear();
 
 				_M_state.reset();
+
+				invalidate_index();
 			}
 
 			inline const struct header* headers::get_header(unsigned idx) const
@@ -523,6 +570,30 @@ namespace net {
 				return _M_state.size;
 			}
 
+			inline void headers::invalidate_index()
+			{
+				if (++_M_generation == 0) {
+					memset(_M_index, 0, sizeof(_M_index));
+					_M_generation = 1;
+				}
+
+				memset(_M_type_end, 0, sizeof(_M_type_end));
+			}
+
+			inline bool headers::search(unsigned char header, unsigned& pos) const
+			{
+				const index_entry* entry = &_M_index[header];
+				if (entry->generation == _M_generation) {
+					pos = entry->pos;
+					return true;
+				}
+
+				// Position where the header would be inserted.
+				pos = _M_type_end[_M_standard_headers[header].type];
+
+				return false;
+			}
+
 			inline void headers::state::reset()
 			{
 				namelen = 0;
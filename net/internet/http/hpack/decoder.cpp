@@ -0,0 +1,98 @@
+#include "net/internet/http/hpack/decoder.h"
+#include "net/internet/http/hpack/huffman.h"
+
+bool net::internet::http::hpack::decoder::decode(const unsigned char* data, size_t len, field_handler& handler)
+{
+	const unsigned char* end = data + len;
+
+	// The dynamic table size updates must precede the first field.
+	bool first = true;
+
+	while (data < end) {
+		unsigned char c = *data;
+
+		size_t idx;
+		field f;
+
+		if (c & 0x80) {
+			// Indexed header field.
+			if ((!decode_integer(data, end, 7, idx)) || (!_M_table.get(idx, f))) {
+				return false;
+			}
+
+			handler.on_field(f.name, f.namelen, f.value, f.valuelen);
+		} else if ((c & 0xe0) == 0x20) {
+			// Dynamic table size update.
+			if ((!first) || (!decode_integer(data, end, 5, idx)) || (!_M_table.max_size(idx))) {
+				return false;
+			}
+
+			continue;
+		} else {
+			// Literal header field with incremental indexing, without
+			// indexing or never indexed.
+			bool indexing = ((c & 0x40) != 0);
+
+			if (!decode_integer(data, end, indexing ? 6 : 4, idx)) {
+				return false;
+			}
+
+			if (idx == 0) {
+				if ((data == end) || (!decode_string(data, end, _M_name, f.name, f.namelen))) {
+					return false;
+				}
+			} else if (!_M_table.get(idx, f)) {
+				return false;
+			} else if ((indexing) && (idx > table::kNumberStaticEntries)) {
+				// The entry might be evicted when the new one is added.
+				_M_name.clear();
+				if (!_M_name.append(f.name, f.namelen)) {
+					return false;
+				}
+
+				f.name = _M_name.data();
+			}
+
+			if ((data == end) || (!decode_string(data, end, _M_value, f.value, f.valuelen))) {
+				return false;
+			}
+
+			if (indexing) {
+				_M_table.add(f.name, f.namelen, f.value, f.valuelen);
+			}
+
+			handler.on_field(f.name, f.namelen, f.value, f.valuelen);
+		}
+
+		first = false;
+	}
+
+	return true;
+}
+
+bool net::internet::http::hpack::decoder::decode_string(const unsigned char*& data, const unsigned char* end, string::buffer& buf, const char*& s, size_t& len)
+{
+	bool huffman = ((*data & 0x80) != 0);
+
+	size_t n;
+	if ((!decode_integer(data, end, 7, n)) || (n > (size_t) (end - data))) {
+		return false;
+	}
+
+	if (huffman) {
+		buf.clear();
+		if (!huffman::decode(data, n, buf)) {
+			return false;
+		}
+
+		s = buf.data();
+		len = buf.length();
+	} else {
+		s = reinterpret_cast<const char*>(data);
+		len = n;
+	}
+
+	data += n;
+
+	return true;
+}
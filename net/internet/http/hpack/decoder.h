@@ -0,0 +1,96 @@
+#ifndef HPACK_DECODER_H
+#define HPACK_DECODER_H
+
+#include "net/internet/http/hpack/table.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace hpack {
+				class field_handler {
+					public:
+						// Destructor.
+						virtual ~field_handler() {}
+
+						// On header field (name and value are only valid during
+						// the call).
+						virtual void on_field(const char* name, size_t namelen, const char* value, size_t valuelen) = 0;
+				};
+
+				class decoder {
+					public:
+						// Maximum value of an integer.
+						static const size_t kMaxInteger = 0x7fffffff;
+
+						// Create.
+						bool create(size_t max_table_size = table::kDefaultMaxSize);
+
+						// Free.
+						void free();
+
+						// Decode header block (on error, the connection has to be
+						// closed with COMPRESSION_ERROR).
+						bool decode(const unsigned char* data, size_t len, field_handler& handler);
+
+						// Decode integer.
+						static bool decode_integer(const unsigned char*& data, const unsigned char* end, unsigned prefix, size_t& n);
+
+					private:
+						table _M_table;
+
+						// Decoded (Huffman) name and value.
+						string::buffer _M_name;
+						string::buffer _M_value;
+
+						// Decode string.
+						static bool decode_string(const unsigned char*& data, const unsigned char* end, string::buffer& buf, const char*& s, size_t& len);
+				};
+
+				inline bool decoder::create(size_t max_table_size)
+				{
+					return _M_table.create(max_table_size);
+				}
+
+				inline void decoder::free()
+				{
+					_M_table.free();
+
+					_M_name.free();
+					_M_value.free();
+				}
+
+				inline bool decoder::decode_integer(const unsigned char*& data, const unsigned char* end, unsigned prefix, size_t& n)
+				{
+					unsigned mask = (1u << prefix) - 1;
+
+					if ((n = (*data++ & mask)) < mask) {
+						return true;
+					}
+
+					unsigned shift = 0;
+					unsigned char c;
+
+					do {
+						if ((data == end) || (shift > 28)) {
+							return false;
+						}
+
+						c = *data++;
+
+						n += (static_cast<size_t>(c & 0x7f) << shift);
+						if (n > kMaxInteger) {
+							return false;
+						}
+
+						shift += 7;
+					} while (c & 0x80);
+
+					return true;
+				}
+			}
+		}
+	}
+}
+
+#endif // HPACK_DECODER_H
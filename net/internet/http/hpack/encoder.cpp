@@ -0,0 +1,115 @@
+#include "net/internet/http/hpack/encoder.h"
+#include "net/internet/http/hpack/huffman.h"
+
+bool net::internet::http::hpack::encoder::begin(string::buffer& buf)
+{
+	if (_M_size_update) {
+		// Signal the smallest size first (if the table has been shrunk and
+		// grown again since the last header block).
+		if (_M_min_size < _M_table.max_size()) {
+			if (!encode_integer(0x20, 5, _M_min_size, buf)) {
+				return false;
+			}
+		}
+
+		if (!encode_integer(0x20, 5, _M_table.max_size(), buf)) {
+			return false;
+		}
+
+		_M_size_update = false;
+	}
+
+	return true;
+}
+
+bool net::internet::http::hpack::encoder::encode(const char* name, size_t namelen, const char* value, size_t valuelen, bool indexing, string::buffer& buf)
+{
+	bool name_only;
+	size_t idx = _M_table.search(name, namelen, value, valuelen, name_only);
+
+	// Indexed header field?
+	if ((idx != 0) && (!name_only)) {
+		return encode_integer(0x80, 7, idx, buf);
+	}
+
+	if (indexing) {
+		// Literal header field with incremental indexing.
+		if (!encode_integer(0x40, 6, idx, buf)) {
+			return false;
+		}
+	} else {
+		// Literal header field without indexing.
+		if (!encode_integer(0x00, 4, idx, buf)) {
+			return false;
+		}
+	}
+
+	if (idx == 0) {
+		if (!encode_string(name, namelen, buf)) {
+			return false;
+		}
+	}
+
+	if (!encode_string(value, valuelen, buf)) {
+		return false;
+	}
+
+	if (indexing) {
+		_M_table.add(name, namelen, value, valuelen);
+	}
+
+	return true;
+}
+
+bool net::internet::http::hpack::encoder::encode_integer(unsigned char flags, unsigned prefix, size_t n, string::buffer& buf)
+{
+	// At most 1 + 10 bytes.
+	if (!buf.allocate(11)) {
+		return false;
+	}
+
+	unsigned char* data = reinterpret_cast<unsigned char*>(buf.end());
+	unsigned char* begin = data;
+
+	size_t mask = (1u << prefix) - 1;
+
+	if (n < mask) {
+		*data++ = flags | n;
+	} else {
+		*data++ = flags | mask;
+
+		n -= mask;
+
+		while (n >= 128) {
+			*data++ = (n & 0x7f) | 0x80;
+			n >>= 7;
+		}
+
+		*data++ = n;
+	}
+
+	buf.increment_length(data - begin);
+
+	return true;
+}
+
+bool net::internet::http::hpack::encoder::encode_string(const char* s, size_t len, string::buffer& buf)
+{
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(s);
+
+	// Use the Huffman code if it is shorter.
+	size_t huffmanlen = huffman::encoded_length(src, len);
+
+	if (huffmanlen < len) {
+		if ((!encode_integer(0x80, 7, huffmanlen, buf)) || (!buf.allocate(huffmanlen))) {
+			return false;
+		}
+
+		huffman::encode(src, len, reinterpret_cast<unsigned char*>(buf.end()));
+		buf.increment_length(huffmanlen);
+
+		return true;
+	}
+
+	return ((encode_integer(0x00, 7, len, buf)) && (buf.append(s, len)));
+}
@@ -0,0 +1,87 @@
+#ifndef HPACK_ENCODER_H
+#define HPACK_ENCODER_H
+
+#include "net/internet/http/hpack/table.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace hpack {
+				class encoder {
+					public:
+						// Constructor.
+						encoder();
+
+						// Create.
+						bool create(size_t capacity = table::kDefaultMaxSize);
+
+						// Free.
+						void free();
+
+						// Set maximum size of the dynamic table (setting
+						// SETTINGS_HEADER_TABLE_SIZE of the peer).
+						void max_table_size(size_t size);
+
+						// Begin header block.
+						bool begin(string::buffer& buf);
+
+						// Encode header field (the name must be in lowercase). If
+						// 'indexing' is false, the field is not added to the
+						// dynamic table (values which change in every response).
+						bool encode(const char* name, size_t namelen, const char* value, size_t valuelen, bool indexing, string::buffer& buf);
+
+						// Encode integer.
+						static bool encode_integer(unsigned char flags, unsigned prefix, size_t n, string::buffer& buf);
+
+					private:
+						table _M_table;
+
+						// Pending dynamic table size update?
+						bool _M_size_update;
+
+						// Minimum size since the last update.
+						size_t _M_min_size;
+
+						// Encode string.
+						static bool encode_string(const char* s, size_t len, string::buffer& buf);
+				};
+
+				inline encoder::encoder()
+				{
+					_M_size_update = false;
+					_M_min_size = 0;
+				}
+
+				inline bool encoder::create(size_t capacity)
+				{
+					return _M_table.create(capacity);
+				}
+
+				inline void encoder::free()
+				{
+					_M_table.free();
+				}
+
+				inline void encoder::max_table_size(size_t size)
+				{
+					if (size > _M_table.capacity()) {
+						size = _M_table.capacity();
+					}
+
+					if (size != _M_table.max_size()) {
+						if ((!_M_size_update) || (size < _M_min_size)) {
+							_M_min_size = size;
+						}
+
+						_M_table.max_size(size);
+
+						_M_size_update = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif // HPACK_ENCODER_H
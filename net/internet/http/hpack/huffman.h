@@ -0,0 +1,43 @@
+#ifndef HPACK_HUFFMAN_H
+#define HPACK_HUFFMAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace hpack {
+				// Huffman code of HPACK (RFC 7541, Appendix B).
+				class huffman {
+					public:
+						// Decode (the decoded string is appended to 'buf').
+						static bool decode(const unsigned char* src, size_t len, string::buffer& buf);
+
+						// Get length of the encoded string.
+						static size_t encoded_length(const unsigned char* src, size_t len);
+
+						// Encode (returns the end of the encoded string).
+						static unsigned char* encode(const unsigned char* src, size_t len, unsigned char* dest);
+
+					private:
+						static const unsigned kNumberSymbols = 257;
+						static const unsigned short kEOS = 256;
+
+						static const unsigned kMinLength = 5;
+						static const unsigned kMaxLength = 30;
+
+						static const uint32_t kCodes[kNumberSymbols];
+						static const unsigned char kLengths[kNumberSymbols];
+
+						static const unsigned short kSymbols[kNumberSymbols];
+						static const uint32_t kLimits[kMaxLength + 1];
+						static const int kBases[kMaxLength + 1];
+				};
+			}
+		}
+	}
+}
+
+#endif // HPACK_HUFFMAN_H
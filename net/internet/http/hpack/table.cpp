@@ -0,0 +1,242 @@
+#include "net/internet/http/hpack/table.h"
+
+const net::internet::http::hpack::table::static_entry net::internet::http::hpack::table::_M_static_table[kNumberStaticEntries] = {
+	{":authority", 10, "", 0},
+	{":method", 7, "GET", 3},
+	{":method", 7, "POST", 4},
+	{":path", 5, "/", 1},
+	{":path", 5, "/index.html", 11},
+	{":scheme", 7, "http", 4},
+	{":scheme", 7, "https", 5},
+	{":status", 7, "200", 3},
+	{":status", 7, "204", 3},
+	{":status", 7, "206", 3},
+	{":status", 7, "304", 3},
+	{":status", 7, "400", 3},
+	{":status", 7, "404", 3},
+	{":status", 7, "500", 3},
+	{"accept-charset", 14, "", 0},
+	{"accept-encoding", 15, "gzip, deflate", 13},
+	{"accept-language", 15, "", 0},
+	{"accept-ranges", 13, "", 0},
+	{"accept", 6, "", 0},
+	{"access-control-allow-origin", 27, "", 0},
+	{"age", 3, "", 0},
+	{"allow", 5, "", 0},
+	{"authorization", 13, "", 0},
+	{"cache-control", 13, "", 0},
+	{"content-disposition", 19, "", 0},
+	{"content-encoding", 16, "", 0},
+	{"content-language", 16, "", 0},
+	{"content-length", 14, "", 0},
+	{"content-location", 16, "", 0},
+	{"content-range", 13, "", 0},
+	{"content-type", 12, "", 0},
+	{"cookie", 6, "", 0},
+	{"date", 4, "", 0},
+	{"etag", 4, "", 0},
+	{"expect", 6, "", 0},
+	{"expires", 7, "", 0},
+	{"from", 4, "", 0},
+	{"host", 4, "", 0},
+	{"if-match", 8, "", 0},
+	{"if-modified-since", 17, "", 0},
+	{"if-none-match", 13, "", 0},
+	{"if-range", 8, "", 0},
+	{"if-unmodified-since", 19, "", 0},
+	{"last-modified", 13, "", 0},
+	{"link", 4, "", 0},
+	{"location", 8, "", 0},
+	{"max-forwards", 12, "", 0},
+	{"proxy-authenticate", 18, "", 0},
+	{"proxy-authorization", 19, "", 0},
+	{"range", 5, "", 0},
+	{"referer", 7, "", 0},
+	{"refresh", 7, "", 0},
+	{"retry-after", 11, "", 0},
+	{"server", 6, "", 0},
+	{"set-cookie", 10, "", 0},
+	{"strict-transport-security", 25, "", 0},
+	{"transfer-encoding", 17, "", 0},
+	{"user-agent", 10, "", 0},
+	{"vary", 4, "", 0},
+	{"via", 3, "", 0},
+	{"www-authenticate", 16, "", 0}
+};
+
+bool net::internet::http::hpack::table::create(size_t capacity)
+{
+	if ((_M_data = (char*) malloc(capacity)) == NULL) {
+		return false;
+	}
+
+	// Each entry takes at least kEntryOverhead bytes.
+	_M_max_entries = (capacity / kEntryOverhead) + 1;
+
+	if ((_M_entries = (entry*) malloc(_M_max_entries * sizeof(entry))) == NULL) {
+		::free(_M_data);
+		_M_data = NULL;
+
+		return false;
+	}
+
+	_M_capacity = capacity;
+	_M_max_size = capacity;
+
+	return true;
+}
+
+void net::internet::http::hpack::table::free()
+{
+	if (_M_data) {
+		::free(_M_data);
+		_M_data = NULL;
+	}
+
+	if (_M_entries) {
+		::free(_M_entries);
+		_M_entries = NULL;
+	}
+
+	_M_begin = 0;
+	_M_end = 0;
+
+	_M_max_entries = 0;
+	_M_first = 0;
+	_M_count = 0;
+
+	_M_capacity = 0;
+	_M_max_size = 0;
+	_M_size = 0;
+}
+
+bool net::internet::http::hpack::table::get(size_t idx, field& f) const
+{
+	if (idx == 0) {
+		return false;
+	}
+
+	if (idx <= kNumberStaticEntries) {
+		const static_entry* e = &_M_static_table[idx - 1];
+
+		f.name = e->name;
+		f.namelen = e->namelen;
+
+		f.value = e->value;
+		f.valuelen = e->valuelen;
+
+		return true;
+	}
+
+	if ((idx -= kNumberStaticEntries) > _M_count) {
+		return false;
+	}
+
+	const entry* e = dynamic_entry(idx);
+
+	f.name = _M_data + e->off;
+	f.namelen = e->namelen;
+
+	f.value = f.name + e->namelen;
+	f.valuelen = e->valuelen;
+
+	return true;
+}
+
+void net::internet::http::hpack::table::add(const char* name, size_t namelen, const char* value, size_t valuelen)
+{
+	size_t len = namelen + valuelen;
+	size_t size = len + kEntryOverhead;
+
+	// An entry larger than the maximum size empties the table.
+	if (size > _M_max_size) {
+		evict(_M_max_size);
+		return;
+	}
+
+	evict(size);
+
+	// If there is no room at the end, move the entries to the beginning.
+	if (_M_end + len > _M_capacity) {
+		memmove(_M_data, _M_data + _M_begin, _M_end - _M_begin);
+
+		for (size_t i = 0; i < _M_count; i++) {
+			_M_entries[(_M_first + i) % _M_max_entries].off -= _M_begin;
+		}
+
+		_M_end -= _M_begin;
+		_M_begin = 0;
+	}
+
+	entry* e = &_M_entries[(_M_first + _M_count) % _M_max_entries];
+
+	e->off = _M_end;
+	e->namelen = namelen;
+	e->valuelen = valuelen;
+
+	memcpy(_M_data + _M_end, name, namelen);
+	memcpy(_M_data + _M_end + namelen, value, valuelen);
+
+	_M_end += len;
+
+	_M_count++;
+	_M_size += size;
+}
+
+size_t net::internet::http::hpack::table::search(const char* name, size_t namelen, const char* value, size_t valuelen, bool& name_only) const
+{
+	size_t idx = 0;
+
+	for (size_t i = 0; i < kNumberStaticEntries; i++) {
+		const static_entry* e = &_M_static_table[i];
+
+		if ((e->namelen == namelen) && (memcmp(e->name, name, namelen) == 0)) {
+			if ((e->valuelen == valuelen) && (memcmp(e->value, value, valuelen) == 0)) {
+				name_only = false;
+				return i + 1;
+			}
+
+			if (idx == 0) {
+				idx = i + 1;
+			}
+		}
+	}
+
+	for (size_t i = 1; i <= _M_count; i++) {
+		const entry* e = dynamic_entry(i);
+		const char* n = _M_data + e->off;
+
+		if ((e->namelen == namelen) && (memcmp(n, name, namelen) == 0)) {
+			if ((e->valuelen == valuelen) && (memcmp(n + namelen, value, valuelen) == 0)) {
+				name_only = false;
+				return kNumberStaticEntries + i;
+			}
+
+			if (idx == 0) {
+				idx = kNumberStaticEntries + i;
+			}
+		}
+	}
+
+	name_only = true;
+
+	return idx;
+}
+
+void net::internet::http::hpack::table::evict(size_t size)
+{
+	while ((_M_count > 0) && (_M_size + size > _M_max_size)) {
+		entry* e = &_M_entries[_M_first];
+
+		_M_size -= (e->namelen + e->valuelen + kEntryOverhead);
+
+		_M_first = (_M_first + 1) % _M_max_entries;
+
+		if (--_M_count == 0) {
+			_M_begin = 0;
+			_M_end = 0;
+		} else {
+			_M_begin = _M_entries[_M_first].off;
+		}
+	}
+}
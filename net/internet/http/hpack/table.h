@@ -0,0 +1,170 @@
+#ifndef HPACK_TABLE_H
+#define HPACK_TABLE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace hpack {
+				struct field {
+					const char* name;
+					size_t namelen;
+
+					const char* value;
+					size_t valuelen;
+				};
+
+				// Indexing table of HPACK (RFC 7541, section 2.3): the static
+				// table (indices 1 - 61) followed by the dynamic table (the
+				// newest entry first).
+				class table {
+					public:
+						static const size_t kDefaultMaxSize = 4096;
+
+						// Overhead of an entry of the dynamic table [bytes].
+						static const size_t kEntryOverhead = 32;
+
+						static const size_t kNumberStaticEntries = 61;
+
+						// Constructor.
+						table();
+
+						// Destructor.
+						~table();
+
+						// Create (the maximum size can't be increased above
+						// 'capacity').
+						bool create(size_t capacity = kDefaultMaxSize);
+
+						// Free.
+						void free();
+
+						// Get entry.
+						bool get(size_t idx, field& f) const;
+
+						// Add entry to the dynamic table (name and value must
+						// not point to the table).
+						void add(const char* name, size_t namelen, const char* value, size_t valuelen);
+
+						// Search entry (returns 0 if not found). If only the name
+						// matches, 'name_only' is set.
+						size_t search(const char* name, size_t namelen, const char* value, size_t valuelen, bool& name_only) const;
+
+						// Get capacity.
+						size_t capacity() const;
+
+						// Get/set maximum size of the dynamic table.
+						size_t max_size() const;
+						bool max_size(size_t size);
+
+						// Get size of the dynamic table.
+						size_t size() const;
+
+						// Get number of entries of the dynamic table.
+						size_t count() const;
+
+					private:
+						struct static_entry {
+							const char* name;
+							unsigned char namelen;
+
+							const char* value;
+							unsigned char valuelen;
+						};
+
+						static const static_entry _M_static_table[kNumberStaticEntries];
+
+						struct entry {
+							size_t off;
+							size_t namelen;
+							size_t valuelen;
+						};
+
+						// Names and values (contiguous, the oldest entry first).
+						char* _M_data;
+						size_t _M_begin;
+						size_t _M_end;
+
+						// Entries (circular array).
+						entry* _M_entries;
+						size_t _M_max_entries;
+						size_t _M_first;
+						size_t _M_count;
+
+						size_t _M_capacity;
+						size_t _M_max_size;
+						size_t _M_size;
+
+						// Get entry of the dynamic table (1: newest).
+						const entry* dynamic_entry(size_t idx) const;
+
+						// Evict the oldest entries until the table has room for
+						// 'size' bytes.
+						void evict(size_t size);
+				};
+
+				inline table::table()
+				{
+					_M_data = NULL;
+					_M_begin = 0;
+					_M_end = 0;
+
+					_M_entries = NULL;
+					_M_max_entries = 0;
+					_M_first = 0;
+					_M_count = 0;
+
+					_M_capacity = 0;
+					_M_max_size = 0;
+					_M_size = 0;
+				}
+
+				inline table::~table()
+				{
+					free();
+				}
+
+				inline size_t table::capacity() const
+				{
+					return _M_capacity;
+				}
+
+				inline size_t table::max_size() const
+				{
+					return _M_max_size;
+				}
+
+				inline bool table::max_size(size_t size)
+				{
+					if (size > _M_capacity) {
+						return false;
+					}
+
+					_M_max_size = size;
+					evict(0);
+
+					return true;
+				}
+
+				inline size_t table::size() const
+				{
+					return _M_size;
+				}
+
+				inline size_t table::count() const
+				{
+					return _M_count;
+				}
+
+				inline const table::entry* table::dynamic_entry(size_t idx) const
+				{
+					return &_M_entries[(_M_first + _M_count - idx) % _M_max_entries];
+				}
+			}
+		}
+	}
+}
+
+#endif // HPACK_TABLE_H
@@ -0,0 +1,133 @@
+#ifndef HTTP2_FRAME_H
+#define HTTP2_FRAME_H
+
+#include <stdint.h>
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace http2 {
+				// HTTP/2 frame header (RFC 9113, section 4.1).
+				struct frame {
+					public:
+						static const size_t kHeaderLen = 9;
+
+						// Frame types.
+						static const unsigned char DATA = 0x00;
+						static const unsigned char HEADERS = 0x01;
+						static const unsigned char PRIORITY = 0x02;
+						static const unsigned char RST_STREAM = 0x03;
+						static const unsigned char SETTINGS = 0x04;
+						static const unsigned char PUSH_PROMISE = 0x05;
+						static const unsigned char PING = 0x06;
+						static const unsigned char GOAWAY = 0x07;
+						static const unsigned char WINDOW_UPDATE = 0x08;
+						static const unsigned char CONTINUATION = 0x09;
+
+						// Flags.
+						static const unsigned char FLAG_ACK = 0x01;
+						static const unsigned char FLAG_END_STREAM = 0x01;
+						static const unsigned char FLAG_END_HEADERS = 0x04;
+						static const unsigned char FLAG_PADDED = 0x08;
+						static const unsigned char FLAG_PRIORITY = 0x20;
+
+						// Error codes.
+						static const uint32_t NO_ERROR = 0x00;
+						static const uint32_t PROTOCOL_ERROR = 0x01;
+						static const uint32_t INTERNAL_ERROR = 0x02;
+						static const uint32_t FLOW_CONTROL_ERROR = 0x03;
+						static const uint32_t SETTINGS_TIMEOUT = 0x04;
+						static const uint32_t STREAM_CLOSED = 0x05;
+						static const uint32_t FRAME_SIZE_ERROR = 0x06;
+						static const uint32_t REFUSED_STREAM = 0x07;
+						static const uint32_t CANCEL = 0x08;
+						static const uint32_t COMPRESSION_ERROR = 0x09;
+						static const uint32_t CONNECT_ERROR = 0x0a;
+						static const uint32_t ENHANCE_YOUR_CALM = 0x0b;
+						static const uint32_t INADEQUATE_SECURITY = 0x0c;
+						static const uint32_t HTTP_1_1_REQUIRED = 0x0d;
+
+						// Settings.
+						static const unsigned short SETTINGS_HEADER_TABLE_SIZE = 0x01;
+						static const unsigned short SETTINGS_ENABLE_PUSH = 0x02;
+						static const unsigned short SETTINGS_MAX_CONCURRENT_STREAMS = 0x03;
+						static const unsigned short SETTINGS_INITIAL_WINDOW_SIZE = 0x04;
+						static const unsigned short SETTINGS_MAX_FRAME_SIZE = 0x05;
+						static const unsigned short SETTINGS_MAX_HEADER_LIST_SIZE = 0x06;
+
+						static const size_t kSettingLen = 6;
+
+						// Minimum value of SETTINGS_MAX_FRAME_SIZE.
+						static const size_t kMinMaxFrameSize = 16 * 1024;
+
+						// Maximum value of SETTINGS_MAX_FRAME_SIZE.
+						static const size_t kMaxMaxFrameSize = (1 << 24) - 1;
+
+						// Maximum size of a flow-control window.
+						static const int64_t kMaxWindowSize = 0x7fffffff;
+
+						uint32_t length;
+						unsigned char type;
+						unsigned char flags;
+						uint32_t stream_id;
+
+						// Parse frame header.
+						void parse(const unsigned char* data);
+
+						// Append frame header.
+						static bool serialize(size_t length, unsigned char type, unsigned char flags, uint32_t stream_id, string::buffer& buf);
+
+						// Read 32-bit integer.
+						static uint32_t get32(const unsigned char* data);
+
+						// Write 32-bit integer.
+						static void put32(uint32_t n, unsigned char* data);
+				};
+
+				inline void frame::parse(const unsigned char* data)
+				{
+					length = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+					type = data[3];
+					flags = data[4];
+					stream_id = get32(data + 5) & 0x7fffffff;
+				}
+
+				inline bool frame::serialize(size_t length, unsigned char type, unsigned char flags, uint32_t stream_id, string::buffer& buf)
+				{
+					if (!buf.allocate(kHeaderLen)) {
+						return false;
+					}
+
+					unsigned char* data = reinterpret_cast<unsigned char*>(buf.end());
+
+					data[0] = static_cast<unsigned char>(length >> 16);
+					data[1] = static_cast<unsigned char>(length >> 8);
+					data[2] = static_cast<unsigned char>(length);
+					data[3] = type;
+					data[4] = flags;
+					put32(stream_id, data + 5);
+
+					buf.increment_length(kHeaderLen);
+
+					return true;
+				}
+
+				inline uint32_t frame::get32(const unsigned char* data)
+				{
+					return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+				}
+
+				inline void frame::put32(uint32_t n, unsigned char* data)
+				{
+					data[0] = static_cast<unsigned char>(n >> 24);
+					data[1] = static_cast<unsigned char>(n >> 16);
+					data[2] = static_cast<unsigned char>(n >> 8);
+					data[3] = static_cast<unsigned char>(n);
+				}
+			}
+		}
+	}
+}
+
+#endif // HTTP2_FRAME_H
@@ -0,0 +1,1122 @@
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <new>
+#include "net/internet/http/http2/session.h"
+#include "net/internet/http/connection.h"
+#include "net/internet/http/server.h"
+#include "net/tcp_connection.inl"
+#include "macros/macros.h"
+
+const char net::internet::http::http2::session::kPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+net::internet::http::http2::session::~session()
+{
+	stream* s;
+	while ((s = _M_streams) != NULL) {
+		_M_streams = s->next;
+		delete s;
+	}
+
+	while ((s = _M_free_streams) != NULL) {
+		_M_free_streams = s->next;
+		delete s;
+	}
+}
+
+bool net::internet::http::http2::session::create(connection* conn)
+{
+	_M_conn = conn;
+
+	if ((!_M_decoder.create()) || (!_M_encoder.create())) {
+		return false;
+	}
+
+	// The server connection preface is a SETTINGS frame.
+	return send_settings();
+}
+
+bool net::internet::http::http2::session::run()
+{
+	string::buffer& out = _M_conn->_M_out;
+
+	bool progress;
+
+	do {
+		progress = false;
+
+		// Read and process frames (unless too many frames are pending).
+		if ((_M_conn->_M_readable) && (!_M_goaway_sent) && (out.length() - _M_conn->_M_outp < kMaxPendingOutput)) {
+			size_t count;
+			if (!_M_conn->read(count)) {
+				return false;
+			}
+
+			if (count > 0) {
+				if (!process_input()) {
+					return false;
+				}
+
+				progress = true;
+			}
+		}
+
+		if (_M_conn->_M_writable) {
+			// If all the frames have been sent, prepare more.
+			if (_M_conn->_M_outp == (off_t) out.length()) {
+				out.clear();
+				_M_conn->_M_outp = 0;
+
+				if ((!_M_goaway_sent) && (!fill())) {
+					return false;
+				}
+			}
+
+			if (_M_conn->_M_outp < (off_t) out.length()) {
+				if (!_M_conn->write()) {
+					return false;
+				}
+
+				progress = true;
+			}
+		}
+	} while (progress);
+
+	bool pending = (_M_conn->_M_outp < (off_t) out.length());
+
+	if (!pending) {
+		// Close the connection after GOAWAY.
+		if ((_M_goaway_sent) || ((_M_draining) && (_M_nstreams == 0))) {
+			return false;
+		}
+
+		if (_M_nstreams == 0) {
+			// Wait for the next request at most the keep-alive timeout.
+			unsigned timeout, max_requests;
+			static_cast<server*>(_M_conn->_M_server)->keep_alive(NULL, timeout, max_requests);
+
+			if (_M_conn->_M_idle_time != timeout) {
+				_M_conn->_M_idle_time = timeout;
+
+				if (!_M_conn->add_timer()) {
+					return false;
+				}
+			}
+
+			// Don't keep the buffers while the connection is idle.
+			out.clear();
+			_M_conn->_M_outp = 0;
+
+			_M_conn->release_buffers();
+		}
+	}
+
+	if (_M_nstreams > 0) {
+		_M_conn->_M_idle_time = tcp_connection::_M_max_idle_time;
+	}
+
+	unsigned events = 0;
+
+	if ((!_M_goaway_sent) && (out.length() - _M_conn->_M_outp < kMaxPendingOutput)) {
+		events |= tcp_server::READ;
+	}
+
+	if (pending) {
+		events |= tcp_server::WRITE;
+	}
+
+	return _M_conn->modify(events);
+}
+
+void net::internet::http::http2::session::on_field(const char* name, size_t namelen, const char* value, size_t valuelen)
+{
+	if ((_M_malformed) || (namelen == 0)) {
+		_M_malformed = 1;
+		return;
+	}
+
+	// The request is translated to HTTP/1.1: NUL, CR and LF are not allowed
+	// in the values.
+	for (size_t i = 0; i < valuelen; i++) {
+		switch (value[i]) {
+			case 0:
+			case '\r':
+			case '\n':
+				_M_malformed = 1;
+				return;
+		}
+	}
+
+	// Pseudo-header field?
+	if (*name == ':') {
+		// The pseudo-header fields must precede the regular fields.
+		if (_M_regular_fields) {
+			_M_malformed = 1;
+			return;
+		}
+
+		unsigned field;
+		string::buffer* buf;
+
+		if ((namelen == 7) && (memcmp(name, ":method", 7) == 0)) {
+			field = kMethod;
+			buf = &_M_method;
+		} else if ((namelen == 5) && (memcmp(name, ":path", 5) == 0)) {
+			field = kPath;
+			buf = &_M_path;
+		} else if ((namelen == 10) && (memcmp(name, ":authority", 10) == 0)) {
+			field = kAuthority;
+			buf = &_M_authority;
+		} else if ((namelen == 7) && (memcmp(name, ":scheme", 7) == 0)) {
+			field = kScheme;
+			buf = NULL;
+		} else {
+			_M_malformed = 1;
+			return;
+		}
+
+		// Duplicated?
+		if (_M_pseudo_headers & field) {
+			_M_malformed = 1;
+			return;
+		}
+
+		_M_pseudo_headers |= field;
+
+		if ((buf) && (!buf->append(value, valuelen))) {
+			_M_no_memory = 1;
+			_M_malformed = 1;
+		}
+
+		return;
+	}
+
+	_M_regular_fields = 1;
+
+	// The names must be in lowercase.
+	for (size_t i = 0; i < namelen; i++) {
+		unsigned char c = (unsigned char) name[i];
+		if ((!header_name::valid_character(c)) || ((c >= 'A') && (c <= 'Z'))) {
+			_M_malformed = 1;
+			return;
+		}
+	}
+
+	if (connection_specific(name, namelen)) {
+		_M_malformed = 1;
+		return;
+	}
+
+	switch (namelen) {
+		case 2:
+			if (memcmp(name, "te", 2) == 0) {
+				// TE may only contain "trailers".
+				if ((valuelen != 8) || (memcmp(value, "trailers", 8) != 0)) {
+					_M_malformed = 1;
+				}
+
+				return;
+			}
+
+			break;
+		case 4:
+			// :authority takes precedence over Host.
+			if ((memcmp(name, "host", 4) == 0) && (_M_pseudo_headers & kAuthority)) {
+				return;
+			}
+
+			break;
+		case 5:
+			// Range is added at the end (if valid).
+			if (memcmp(name, "range", 5) == 0) {
+				if (_M_nranges++ == 0) {
+					if (!_M_range.append(value, valuelen)) {
+						_M_no_memory = 1;
+						_M_malformed = 1;
+					}
+				}
+
+				return;
+			}
+
+			break;
+	}
+
+	// If the fields are already too large, the request will be rejected.
+	if (_M_fields.length() > headers::HEADERS_MAX_LEN) {
+		return;
+	}
+
+	if ((!_M_fields.append(name, namelen)) || (!_M_fields.append(": ", 2)) || (!_M_fields.append(value, valuelen)) || (!_M_fields.append("\r\n", 2))) {
+		_M_no_memory = 1;
+		_M_malformed = 1;
+	}
+}
+
+bool net::internet::http::http2::session::process_input()
+{
+	string::buffer& in = _M_conn->_M_in;
+
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(in.data());
+	size_t len = in.length();
+	size_t pos = _M_conn->_M_inp;
+
+	if (!_M_preface_received) {
+		size_t n = MIN(len - pos, kPrefaceLen);
+
+		// Not HTTP/2?
+		if (memcmp(data + pos, kPreface, n) != 0) {
+			return false;
+		}
+
+		if (n < kPrefaceLen) {
+			return true;
+		}
+
+		pos += kPrefaceLen;
+
+		_M_preface_received = 1;
+	}
+
+	while ((!_M_goaway_sent) && (len - pos >= frame::kHeaderLen)) {
+		frame f;
+		f.parse(data + pos);
+
+		if (f.length > kMaxFrameSize) {
+			if (!send_goaway(frame::FRAME_SIZE_ERROR)) {
+				return false;
+			}
+
+			break;
+		}
+
+		// If the frame has not been completely received yet...
+		if (len - pos < frame::kHeaderLen + f.length) {
+			break;
+		}
+
+		if (!process_frame(f, data + pos + frame::kHeaderLen)) {
+			return false;
+		}
+
+		pos += (frame::kHeaderLen + f.length);
+	}
+
+	// Keep the incomplete frame at the beginning of the input buffer.
+	if ((_M_goaway_sent) || (pos == len)) {
+		in.clear();
+	} else if (pos > 0) {
+		memmove(in.data(), in.data() + pos, len - pos);
+		in.length(len - pos);
+	}
+
+	_M_conn->_M_inp = 0;
+
+	// The request bodies are discarded: give the connection window back.
+	if ((_M_consumed > 0) && (!_M_goaway_sent)) {
+		if (!send_window_update(0, _M_consumed)) {
+			return false;
+		}
+
+		_M_consumed = 0;
+	}
+
+	return true;
+}
+
+bool net::internet::http::http2::session::process_frame(const frame& f, const unsigned char* payload)
+{
+	// A header block must be followed by its CONTINUATION frames.
+	if (_M_continuation) {
+		if ((f.type != frame::CONTINUATION) || (f.stream_id != _M_header_block_stream)) {
+			return send_goaway(frame::PROTOCOL_ERROR);
+		}
+
+		return process_continuation(f, payload);
+	}
+
+	// The first frame must be SETTINGS.
+	if ((!_M_settings_received) && ((f.type != frame::SETTINGS) || (f.flags & frame::FLAG_ACK))) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	stream* s;
+
+	switch (f.type) {
+		case frame::DATA:
+			return process_data(f, payload);
+		case frame::HEADERS:
+			return process_headers(f, payload);
+		case frame::PRIORITY:
+			if (f.stream_id == 0) {
+				return send_goaway(frame::PROTOCOL_ERROR);
+			}
+
+			if (f.length != 5) {
+				return send_rst_stream(f.stream_id, frame::FRAME_SIZE_ERROR);
+			}
+
+			// Priorities are not supported.
+			return true;
+		case frame::RST_STREAM:
+			if ((f.stream_id == 0) || (f.stream_id > _M_last_stream_id)) {
+				return send_goaway(frame::PROTOCOL_ERROR);
+			}
+
+			if (f.length != 4) {
+				return send_goaway(frame::FRAME_SIZE_ERROR);
+			}
+
+			if ((s = find(f.stream_id)) != NULL) {
+				close(s);
+			}
+
+			return true;
+		case frame::SETTINGS:
+			return process_settings(f, payload);
+		case frame::PUSH_PROMISE:
+			// Clients can't push.
+			return send_goaway(frame::PROTOCOL_ERROR);
+		case frame::PING:
+			if (f.stream_id != 0) {
+				return send_goaway(frame::PROTOCOL_ERROR);
+			}
+
+			if (f.length != 8) {
+				return send_goaway(frame::FRAME_SIZE_ERROR);
+			}
+
+			if (f.flags & frame::FLAG_ACK) {
+				return true;
+			}
+
+			return ((frame::serialize(8, frame::PING, frame::FLAG_ACK, 0, _M_conn->_M_out)) && (_M_conn->_M_out.append(reinterpret_cast<const char*>(payload), 8)));
+		case frame::GOAWAY:
+			if (f.stream_id != 0) {
+				return send_goaway(frame::PROTOCOL_ERROR);
+			}
+
+			if (f.length < 8) {
+				return send_goaway(frame::FRAME_SIZE_ERROR);
+			}
+
+			// Finish the active streams and close the connection.
+			_M_draining = 1;
+
+			return true;
+		case frame::WINDOW_UPDATE:
+			return process_window_update(f, payload);
+		case frame::CONTINUATION:
+			// Not preceded by HEADERS.
+			return send_goaway(frame::PROTOCOL_ERROR);
+		default:
+			// Unknown frame types are ignored.
+			return true;
+	}
+}
+
+bool net::internet::http::http2::session::process_data(const frame& f, const unsigned char* payload)
+{
+	if ((f.stream_id == 0) || (f.stream_id > _M_last_stream_id)) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	if ((f.flags & frame::FLAG_PADDED) && ((f.length == 0) || (payload[0] >= f.length))) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	// The whole frame counts for flow control (the data is discarded).
+	_M_consumed += f.length;
+
+	if (f.flags & frame::FLAG_END_STREAM) {
+		stream* s;
+		if ((s = find(f.stream_id)) != NULL) {
+			s->end_stream_received = 1;
+		}
+	}
+
+	return true;
+}
+
+bool net::internet::http::http2::session::process_headers(const frame& f, const unsigned char* payload)
+{
+	// The streams initiated by the client have odd identifiers.
+	if ((f.stream_id & 1) == 0) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	const unsigned char* data = payload;
+	size_t len = f.length;
+
+	// Skip padding.
+	if (f.flags & frame::FLAG_PADDED) {
+		if ((len == 0) || (data[0] >= len)) {
+			return send_goaway(frame::PROTOCOL_ERROR);
+		}
+
+		len -= (1 + data[0]);
+		data++;
+	}
+
+	unsigned char kind = kRequestHeaders;
+
+	// Skip priority.
+	if (f.flags & frame::FLAG_PRIORITY) {
+		if (len < 5) {
+			return send_goaway(frame::FRAME_SIZE_ERROR);
+		}
+
+		// A stream can't depend on itself.
+		if ((frame::get32(data) & 0x7fffffff) == f.stream_id) {
+			kind = kMalformedRequest;
+		}
+
+		data += 5;
+		len -= 5;
+	}
+
+	if (f.stream_id <= _M_last_stream_id) {
+		// Trailers of a request whose body is being received?
+		stream* s;
+		if (((s = find(f.stream_id)) == NULL) || (s->end_stream_received)) {
+			return send_goaway(frame::STREAM_CLOSED);
+		}
+
+		if ((kind == kRequestHeaders) && (f.flags & frame::FLAG_END_STREAM)) {
+			kind = kTrailers;
+		} else {
+			kind = kMalformedRequest;
+		}
+	} else {
+		_M_last_stream_id = f.stream_id;
+
+		if ((kind == kRequestHeaders) && ((_M_nstreams >= kMaxConcurrentStreams) || (_M_draining))) {
+			kind = kRefusedStream;
+		}
+	}
+
+	_M_header_block_stream = f.stream_id;
+	_M_header_block_flags = f.flags;
+	_M_header_block_kind = kind;
+
+	if (f.flags & frame::FLAG_END_HEADERS) {
+		return process_header_block(data, len);
+	}
+
+	// Wait for the CONTINUATION frames.
+	_M_header_block.clear();
+	if (!_M_header_block.append(reinterpret_cast<const char*>(data), len)) {
+		return false;
+	}
+
+	_M_continuation = 1;
+
+	return true;
+}
+
+bool net::internet::http::http2::session::process_continuation(const frame& f, const unsigned char* payload)
+{
+	if (_M_header_block.length() + f.length > kMaxHeaderBlockSize) {
+		return send_goaway(frame::ENHANCE_YOUR_CALM);
+	}
+
+	if (!_M_header_block.append(reinterpret_cast<const char*>(payload), f.length)) {
+		return false;
+	}
+
+	if ((f.flags & frame::FLAG_END_HEADERS) == 0) {
+		return true;
+	}
+
+	_M_continuation = 0;
+
+	bool ret = process_header_block(reinterpret_cast<const unsigned char*>(_M_header_block.data()), _M_header_block.length());
+
+	if (_M_header_block.capacity() > kMaxFrameSize) {
+		_M_header_block.free();
+	} else {
+		_M_header_block.clear();
+	}
+
+	return ret;
+}
+
+bool net::internet::http::http2::session::process_header_block(const unsigned char* data, size_t len)
+{
+	_M_method.clear();
+	_M_path.clear();
+	_M_authority.clear();
+	_M_fields.clear();
+	_M_range.clear();
+
+	_M_pseudo_headers = 0;
+	_M_nranges = 0;
+
+	_M_regular_fields = 0;
+	_M_no_memory = 0;
+
+	// The header block is always decoded (to keep the dynamic table in
+	// sync), but only the fields of new requests are used.
+	_M_malformed = (_M_header_block_kind != kRequestHeaders);
+
+	if (!_M_decoder.decode(data, len, *this)) {
+		return send_goaway(frame::COMPRESSION_ERROR);
+	}
+
+	uint32_t id = _M_header_block_stream;
+	stream* s;
+
+	switch (_M_header_block_kind) {
+		case kTrailers:
+			if ((s = find(id)) != NULL) {
+				s->end_stream_received = 1;
+			}
+
+			return true;
+		case kRefusedStream:
+			return send_rst_stream(id, frame::REFUSED_STREAM);
+		case kMalformedRequest:
+			if ((s = find(id)) != NULL) {
+				close(s);
+			}
+
+			return send_rst_stream(id, frame::PROTOCOL_ERROR);
+		default:
+			if (_M_no_memory) {
+				return send_rst_stream(id, frame::INTERNAL_ERROR);
+			}
+
+			if ((_M_malformed) || ((_M_pseudo_headers & (kMethod | kScheme | kPath)) != (kMethod | kScheme | kPath))) {
+				return send_rst_stream(id, frame::PROTOCOL_ERROR);
+			}
+
+			return process_request(id, (_M_header_block_flags & frame::FLAG_END_STREAM) != 0);
+	}
+}
+
+bool net::internet::http::http2::session::process_settings(const frame& f, const unsigned char* payload)
+{
+	if (f.stream_id != 0) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	if (f.flags & frame::FLAG_ACK) {
+		if (f.length != 0) {
+			return send_goaway(frame::FRAME_SIZE_ERROR);
+		}
+
+		return true;
+	}
+
+	if ((f.length % frame::kSettingLen) != 0) {
+		return send_goaway(frame::FRAME_SIZE_ERROR);
+	}
+
+	const unsigned char* end = payload + f.length;
+
+	for (const unsigned char* p = payload; p < end; p += frame::kSettingLen) {
+		unsigned short id = (p[0] << 8) | p[1];
+		uint32_t value = frame::get32(p + 2);
+
+		switch (id) {
+			case frame::SETTINGS_HEADER_TABLE_SIZE:
+				_M_encoder.max_table_size(value);
+				break;
+			case frame::SETTINGS_ENABLE_PUSH:
+				if (value > 1) {
+					return send_goaway(frame::PROTOCOL_ERROR);
+				}
+
+				break;
+			case frame::SETTINGS_INITIAL_WINDOW_SIZE:
+				{
+					if (value > frame::kMaxWindowSize) {
+						return send_goaway(frame::FLOW_CONTROL_ERROR);
+					}
+
+					// Adjust the windows of the active streams.
+					int64_t delta = (int64_t) value - _M_initial_window_size;
+
+					for (stream* s = _M_streams; s; s = s->next) {
+						if (s->window + delta > frame::kMaxWindowSize) {
+							return send_goaway(frame::FLOW_CONTROL_ERROR);
+						}
+
+						s->window += delta;
+					}
+
+					_M_initial_window_size = value;
+				}
+
+				break;
+			case frame::SETTINGS_MAX_FRAME_SIZE:
+				// The frames sent are never larger than the minimum.
+				if ((value < frame::kMinMaxFrameSize) || (value > frame::kMaxMaxFrameSize)) {
+					return send_goaway(frame::PROTOCOL_ERROR);
+				}
+
+				break;
+			default:
+				// Unknown settings are ignored.
+				;
+		}
+	}
+
+	_M_settings_received = 1;
+
+	// Acknowledge.
+	return frame::serialize(0, frame::SETTINGS, frame::FLAG_ACK, 0, _M_conn->_M_out);
+}
+
+bool net::internet::http::http2::session::process_window_update(const frame& f, const unsigned char* payload)
+{
+	if (f.length != 4) {
+		return send_goaway(frame::FRAME_SIZE_ERROR);
+	}
+
+	uint32_t increment = frame::get32(payload) & 0x7fffffff;
+
+	// Connection window?
+	if (f.stream_id == 0) {
+		if (increment == 0) {
+			return send_goaway(frame::PROTOCOL_ERROR);
+		}
+
+		if (_M_window + increment > frame::kMaxWindowSize) {
+			return send_goaway(frame::FLOW_CONTROL_ERROR);
+		}
+
+		_M_window += increment;
+
+		return true;
+	}
+
+	if (f.stream_id > _M_last_stream_id) {
+		return send_goaway(frame::PROTOCOL_ERROR);
+	}
+
+	// The stream might have been already closed.
+	stream* s;
+	if ((s = find(f.stream_id)) == NULL) {
+		return true;
+	}
+
+	if (increment == 0) {
+		close(s);
+		return send_rst_stream(f.stream_id, frame::PROTOCOL_ERROR);
+	}
+
+	if (s->window + increment > frame::kMaxWindowSize) {
+		close(s);
+		return send_rst_stream(f.stream_id, frame::FLOW_CONTROL_ERROR);
+	}
+
+	s->window += increment;
+
+	return true;
+}
+
+bool net::internet::http::http2::session::process_request(uint32_t id, bool end_stream)
+{
+	// Only the origin form (and "*") can be translated.
+	if ((_M_path.empty()) || ((*_M_path.data() != '/') && ((_M_path.length() != 1) || (*_M_path.data() != '*')))) {
+		return send_rst_stream(id, frame::PROTOCOL_ERROR);
+	}
+
+	// Translate the request to HTTP/1.1.
+	_M_request.clear();
+
+	if ((!_M_request.append(_M_method.data(), _M_method.length())) ||
+	    (!_M_request.append(' ')) ||
+	    (!_M_request.append(_M_path.data(), _M_path.length())) ||
+	    (!_M_request.append(" HTTP/1.1\r\n", 11))) {
+		return false;
+	}
+
+	if (_M_pseudo_headers & kAuthority) {
+		if ((!_M_request.append("Host: ", 6)) || (!_M_request.append(_M_authority.data(), _M_authority.length())) || (!_M_request.append("\r\n", 2))) {
+			return false;
+		}
+	}
+
+	if (!_M_request.append(_M_fields.data(), _M_fields.length())) {
+		return false;
+	}
+
+	// Only single ranges are supported (the multipart responses are not
+	// framed): otherwise, the whole file is sent.
+	if ((_M_nranges == 1) && (!memchr(_M_range.data(), ',', _M_range.length()))) {
+		if ((!_M_request.append("Range: ", 7)) || (!_M_request.append(_M_range.data(), _M_range.length())) || (!_M_request.append("\r\n", 2))) {
+			return false;
+		}
+	}
+
+	if (!_M_request.append("\r\n", 2)) {
+		return false;
+	}
+
+	stream* s;
+	if ((s = _M_free_streams) != NULL) {
+		_M_free_streams = s->next;
+	} else if ((s = new (std::nothrow) stream()) == NULL) {
+		return false;
+	}
+
+	s->id = id;
+	s->window = _M_initial_window_size;
+	s->end_stream_received = end_stream;
+
+	if (!_M_conn->process_http2_request(_M_request, _M_response, *s)) {
+		s->reset();
+
+		s->next = _M_free_streams;
+		_M_free_streams = s;
+
+		return false;
+	}
+
+	s->headers.swap(_M_response);
+
+	// Maximum number of requests per connection reached?
+	if ((!_M_conn->_M_keep_alive) && (!_M_draining)) {
+		unsigned char data[8];
+		frame::put32(_M_last_stream_id, data);
+		frame::put32(frame::NO_ERROR, data + 4);
+
+		if ((!frame::serialize(sizeof(data), frame::GOAWAY, 0, 0, _M_conn->_M_out)) || (!_M_conn->_M_out.append(reinterpret_cast<const char*>(data), sizeof(data)))) {
+			return false;
+		}
+
+		_M_draining = 1;
+	}
+
+	// Append the stream to the list of active streams.
+	s->prev = _M_last;
+	s->next = NULL;
+
+	if (_M_last) {
+		_M_last->next = s;
+	} else {
+		_M_streams = s;
+	}
+
+	_M_last = s;
+
+	_M_nstreams++;
+
+	return true;
+}
+
+bool net::internet::http::http2::session::fill()
+{
+	if (!_M_conn->borrow_buffer(_M_conn->_M_out, connection::kOutputBufferSize)) {
+		return false;
+	}
+
+	// Round-robin: one frame per stream, the stream is then moved to the end
+	// of the list.
+	size_t nblocked = 0;
+
+	while ((_M_streams) && (nblocked < _M_nstreams) && (_M_conn->_M_out.length() < kOutputFillSize)) {
+		stream* s = _M_streams;
+
+		bool sent;
+		if (!send(s, sent)) {
+			return false;
+		}
+
+		if (sent) {
+			nblocked = 0;
+		} else {
+			nblocked++;
+		}
+
+		// If the stream is still active and is not the only one...
+		if ((_M_streams == s) && (s->next)) {
+			_M_streams = s->next;
+			_M_streams->prev = NULL;
+
+			s->prev = _M_last;
+			s->next = NULL;
+
+			_M_last->next = s;
+			_M_last = s;
+		}
+	}
+
+	return true;
+}
+
+bool net::internet::http::http2::session::send(stream* s, bool& sent)
+{
+	bool end_stream;
+
+	if (!s->headers_sent) {
+		end_stream = (s->offset == s->end);
+
+		if (!send_headers(s, end_stream)) {
+			return false;
+		}
+
+		s->headers_sent = 1;
+
+		sent = true;
+	} else {
+		int64_t size = MIN(s->end - s->offset, (off_t) kMaxFrameSize);
+
+		// Flow control.
+		if (_M_window < size) {
+			size = _M_window;
+		}
+
+		if (s->window < size) {
+			size = s->window;
+		}
+
+		if (size <= 0) {
+			sent = false;
+			return true;
+		}
+
+		end_stream = (s->offset + size == s->end);
+
+		string::buffer& out = _M_conn->_M_out;
+
+		if ((!frame::serialize(size, frame::DATA, end_stream ? frame::FLAG_END_STREAM : 0, s->id, out)) || (!out.allocate(size))) {
+			return false;
+		}
+
+		if (s->bodyp) {
+			memcpy(out.end(), s->bodyp->data() + s->offset, size);
+		} else if (s->file.pread(out.end(), size, s->offset) != size) {
+			// The file can't be read (or has been truncated).
+			out.length(out.length() - frame::kHeaderLen);
+
+			uint32_t id = s->id;
+			close(s);
+
+			sent = true;
+
+			return send_rst_stream(id, frame::INTERNAL_ERROR);
+		}
+
+		out.increment_length(size);
+
+		s->offset += size;
+
+		s->window -= size;
+		_M_window -= size;
+
+		sent = true;
+	}
+
+	if (!end_stream) {
+		return true;
+	}
+
+	// The response has been sent.
+	_M_conn->_M_server->request_completed(_M_conn->_M_nreads);
+	_M_conn->_M_nreads = 0;
+
+	uint32_t id = s->id;
+	bool end_stream_received = s->end_stream_received;
+
+	close(s);
+
+	// If the request has not been completely received, the rest is not
+	// needed.
+	return ((end_stream_received) || (send_rst_stream(id, frame::NO_ERROR)));
+}
+
+bool net::internet::http::http2::session::send_headers(stream* s, bool end_stream)
+{
+	const char* data = s->headers.data();
+	const char* end = data + s->headers.length();
+
+	// Status-Line ("HTTP/1.1 200 OK").
+	const char* eol;
+	if ((s->headers.length() < 12) || ((eol = (const char*) memchr(data, '\n', end - data)) == NULL)) {
+		return false;
+	}
+
+	_M_block.clear();
+
+	if ((!_M_encoder.begin(_M_block)) || (!_M_encoder.encode(":status", 7, data + 9, 3, false, _M_block))) {
+		return false;
+	}
+
+	for (const char* p = eol + 1; (eol = (const char*) memchr(p, '\n', end - p)) != NULL; p = eol + 1) {
+		size_t len = eol - p;
+		if ((len > 0) && (p[len - 1] == '\r')) {
+			len--;
+		}
+
+		// End of headers?
+		if (len == 0) {
+			break;
+		}
+
+		const char* colon;
+		if ((colon = (const char*) memchr(p, ':', len)) == NULL) {
+			continue;
+		}
+
+		size_t namelen = colon - p;
+
+		char name[header_name::MAX_LEN];
+		if (namelen > sizeof(name)) {
+			continue;
+		}
+
+		for (size_t i = 0; i < namelen; i++) {
+			name[i] = tolower((unsigned char) p[i]);
+		}
+
+		// Connection-specific fields are not allowed.
+		if (connection_specific(name, namelen)) {
+			continue;
+		}
+
+		const char* value = colon + 1;
+		const char* valueend = p + len;
+
+		while ((value < valueend) && (IS_WHITE_SPACE(*value))) {
+			value++;
+		}
+
+		// The fields which don't change between responses are added to the
+		// dynamic table.
+		bool indexing = (((namelen == 6) && (memcmp(name, "server", 6) == 0)) ||
+		                 ((namelen == 12) && (memcmp(name, "content-type", 12) == 0)) ||
+		                 ((namelen == 13) && (memcmp(name, "accept-ranges", 13) == 0)));
+
+		if (!_M_encoder.encode(name, namelen, value, valueend - value, indexing, _M_block)) {
+			return false;
+		}
+	}
+
+	// HEADERS and CONTINUATION frames.
+	string::buffer& out = _M_conn->_M_out;
+
+	const char* block = _M_block.data();
+	size_t left = _M_block.length();
+
+	unsigned char type = frame::HEADERS;
+	unsigned char flags = end_stream ? frame::FLAG_END_STREAM : 0;
+
+	do {
+		size_t len = MIN(left, kMaxFrameSize);
+		left -= len;
+
+		if (left == 0) {
+			flags |= frame::FLAG_END_HEADERS;
+		}
+
+		if ((!frame::serialize(len, type, flags, s->id, out)) || (!out.append(block, len))) {
+			return false;
+		}
+
+		block += len;
+
+		type = frame::CONTINUATION;
+		flags = 0;
+	} while (left > 0);
+
+	return true;
+}
+
+net::internet::http::http2::stream* net::internet::http::http2::session::find(uint32_t id) const
+{
+	for (stream* s = _M_streams; s; s = s->next) {
+		if (s->id == id) {
+			return s;
+		}
+	}
+
+	return NULL;
+}
+
+void net::internet::http::http2::session::close(stream* s)
+{
+	if (s->prev) {
+		s->prev->next = s->next;
+	} else {
+		_M_streams = s->next;
+	}
+
+	if (s->next) {
+		s->next->prev = s->prev;
+	} else {
+		_M_last = s->prev;
+	}
+
+	_M_nstreams--;
+
+	s->reset();
+
+	s->next = _M_free_streams;
+	_M_free_streams = s;
+}
+
+bool net::internet::http::http2::session::connection_specific(const char* name, size_t len)
+{
+	switch (len) {
+		case 7:
+			return (memcmp(name, "upgrade", 7) == 0);
+		case 10:
+			return ((memcmp(name, "connection", 10) == 0) || (memcmp(name, "keep-alive", 10) == 0));
+		case 16:
+			return (memcmp(name, "proxy-connection", 16) == 0);
+		case 17:
+			return (memcmp(name, "transfer-encoding", 17) == 0);
+		default:
+			return false;
+	}
+}
+
+bool net::internet::http::http2::session::send_settings()
+{
+	unsigned char data[2 * frame::kSettingLen];
+
+	data[0] = 0;
+	data[1] = frame::SETTINGS_MAX_CONCURRENT_STREAMS;
+	frame::put32(kMaxConcurrentStreams, data + 2);
+
+	data[6] = 0;
+	data[7] = frame::SETTINGS_MAX_HEADER_LIST_SIZE;
+	frame::put32(headers::HEADERS_MAX_LEN, data + 8);
+
+	return ((frame::serialize(sizeof(data), frame::SETTINGS, 0, 0, _M_conn->_M_out)) && (_M_conn->_M_out.append(reinterpret_cast<const char*>(data), sizeof(data))));
+}
+
+bool net::internet::http::http2::session::send_goaway(uint32_t error_code)
+{
+	if (_M_goaway_sent) {
+		return true;
+	}
+
+	unsigned char data[8];
+	frame::put32(_M_last_stream_id, data);
+	frame::put32(error_code, data + 4);
+
+	if ((!frame::serialize(sizeof(data), frame::GOAWAY, 0, 0, _M_conn->_M_out)) || (!_M_conn->_M_out.append(reinterpret_cast<const char*>(data), sizeof(data)))) {
+		return false;
+	}
+
+	_M_goaway_sent = 1;
+
+	// The active streams are abandoned.
+	while (_M_streams) {
+		close(_M_streams);
+	}
+
+	return true;
+}
+
+bool net::internet::http::http2::session::send_frame32(unsigned char type, uint32_t id, uint32_t n)
+{
+	unsigned char data[4];
+	frame::put32(n, data);
+
+	return ((frame::serialize(sizeof(data), type, 0, id, _M_conn->_M_out)) && (_M_conn->_M_out.append(reinterpret_cast<const char*>(data), sizeof(data))));
+}
@@ -0,0 +1,243 @@
+#ifndef HTTP2_SESSION_H
+#define HTTP2_SESSION_H
+
+#include <stdint.h>
+#include <string.h>
+#include "net/internet/http/http2/frame.h"
+#include "net/internet/http/http2/stream.h"
+#include "net/internet/http/hpack/decoder.h"
+#include "net/internet/http/hpack/encoder.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			struct connection;
+
+			namespace http2 {
+				// HTTP/2 connection (RFC 9113). The requests received on the
+				// streams are translated to HTTP/1.1 and processed by the
+				// connection as any other request; the responses are sent
+				// interleaved, one frame per stream at a time.
+				class session : public hpack::field_handler {
+					public:
+						// Connection preface.
+						static const char kPreface[];
+						static const size_t kPrefaceLen = 24;
+
+						// Maximum size of the frames received and sent.
+						static const size_t kMaxFrameSize = frame::kMinMaxFrameSize;
+
+						static const unsigned kMaxConcurrentStreams = 100;
+
+						static const int64_t kDefaultWindowSize = 65535;
+
+						// Maximum size of a header block (compressed).
+						static const size_t kMaxHeaderBlockSize = 64 * 1024;
+
+						// Number of bytes of frames prepared at once.
+						static const size_t kOutputFillSize = 64 * 1024;
+
+						// No more frames are read while the frames to be sent
+						// exceed this size.
+						static const size_t kMaxPendingOutput = 128 * 1024;
+
+						// Constructor.
+						session();
+
+						// Destructor.
+						~session();
+
+						// Create.
+						bool create(connection* conn);
+
+						// Run (returns false if the connection has to be
+						// closed).
+						bool run();
+
+						// Does the data begin with the connection preface?
+						static bool preface(const char* data, size_t len);
+
+						// On header field.
+						void on_field(const char* name, size_t namelen, const char* value, size_t valuelen);
+
+					private:
+						// Kinds of header blocks.
+						static const unsigned char kRequestHeaders = 0;
+						static const unsigned char kTrailers = 1;
+						static const unsigned char kRefusedStream = 2;
+						static const unsigned char kMalformedRequest = 3;
+
+						// Pseudo-header fields.
+						static const unsigned kMethod = 1 << 0;
+						static const unsigned kScheme = 1 << 1;
+						static const unsigned kAuthority = 1 << 2;
+						static const unsigned kPath = 1 << 3;
+
+						connection* _M_conn;
+
+						hpack::decoder _M_decoder;
+						hpack::encoder _M_encoder;
+
+						// Active streams (in sending order).
+						stream* _M_streams;
+						stream* _M_last;
+						size_t _M_nstreams;
+
+						// Free streams.
+						stream* _M_free_streams;
+
+						// Highest stream identifier received.
+						uint32_t _M_last_stream_id;
+
+						// Flow-control window of the connection for sending.
+						int64_t _M_window;
+
+						// Initial flow-control window of the streams for sending.
+						int64_t _M_initial_window_size;
+
+						// Bytes of DATA frames received and not acknowledged yet.
+						size_t _M_consumed;
+
+						// Header block being received (HEADERS + CONTINUATION).
+						string::buffer _M_header_block;
+						uint32_t _M_header_block_stream;
+						unsigned char _M_header_block_flags;
+						unsigned char _M_header_block_kind;
+
+						// Request being decoded.
+						string::buffer _M_method;
+						string::buffer _M_path;
+						string::buffer _M_authority;
+						string::buffer _M_fields;
+						string::buffer _M_range;
+						unsigned _M_pseudo_headers;
+						unsigned _M_nranges;
+
+						// Request in HTTP/1.1 syntax and response headers.
+						string::buffer _M_request;
+						string::buffer _M_response;
+
+						// Header block of the response (HPACK).
+						string::buffer _M_block;
+
+						unsigned _M_preface_received:1;
+						unsigned _M_settings_received:1;
+						unsigned _M_continuation:1;
+						unsigned _M_regular_fields:1;
+						unsigned _M_malformed:1;
+						unsigned _M_no_memory:1;
+						unsigned _M_goaway_sent:1;
+
+						// No new streams are accepted and the connection is
+						// closed once the active streams have finished (GOAWAY
+						// received or maximum number of requests reached).
+						unsigned _M_draining:1;
+
+						// Process the data received.
+						bool process_input();
+
+						// Process frame.
+						bool process_frame(const frame& f, const unsigned char* payload);
+						bool process_data(const frame& f, const unsigned char* payload);
+						bool process_headers(const frame& f, const unsigned char* payload);
+						bool process_continuation(const frame& f, const unsigned char* payload);
+						bool process_settings(const frame& f, const unsigned char* payload);
+						bool process_window_update(const frame& f, const unsigned char* payload);
+
+						// Process the complete header block.
+						bool process_header_block(const unsigned char* data, size_t len);
+
+						// Process request.
+						bool process_request(uint32_t id, bool end_stream);
+
+						// Prepare frames to be sent.
+						bool fill();
+
+						// Send a frame of the stream.
+						bool send(stream* s, bool& sent);
+
+						// Send the response headers.
+						bool send_headers(stream* s, bool end_stream);
+
+						// Find active stream.
+						stream* find(uint32_t id) const;
+
+						// Close stream.
+						void close(stream* s);
+
+						// Is the header field connection-specific (not allowed in
+						// HTTP/2)?
+						static bool connection_specific(const char* name, size_t len);
+
+						// Send SETTINGS.
+						bool send_settings();
+
+						// Send RST_STREAM.
+						bool send_rst_stream(uint32_t id, uint32_t error_code);
+
+						// Send WINDOW_UPDATE.
+						bool send_window_update(uint32_t id, uint32_t increment);
+
+						// Send GOAWAY (the connection is closed once the pending
+						// frames have been sent).
+						bool send_goaway(uint32_t error_code);
+
+						// Send frame with a 32-bit payload.
+						bool send_frame32(unsigned char type, uint32_t id, uint32_t n);
+				};
+
+				inline session::session()
+				{
+					_M_conn = NULL;
+
+					_M_streams = NULL;
+					_M_last = NULL;
+					_M_nstreams = 0;
+
+					_M_free_streams = NULL;
+
+					_M_last_stream_id = 0;
+
+					_M_window = kDefaultWindowSize;
+					_M_initial_window_size = kDefaultWindowSize;
+
+					_M_consumed = 0;
+
+					_M_header_block_stream = 0;
+					_M_header_block_flags = 0;
+					_M_header_block_kind = kRequestHeaders;
+
+					_M_pseudo_headers = 0;
+					_M_nranges = 0;
+
+					_M_preface_received = 0;
+					_M_settings_received = 0;
+					_M_continuation = 0;
+					_M_regular_fields = 0;
+					_M_malformed = 0;
+					_M_goaway_sent = 0;
+					_M_draining = 0;
+				}
+
+				inline bool session::preface(const char* data, size_t len)
+				{
+					// "PRI " can't begin an HTTP/1.x request.
+					return ((len >= 4) && (memcmp(data, kPreface, 4) == 0));
+				}
+
+				inline bool session::send_rst_stream(uint32_t id, uint32_t error_code)
+				{
+					return send_frame32(frame::RST_STREAM, id, error_code);
+				}
+
+				inline bool session::send_window_update(uint32_t id, uint32_t increment)
+				{
+					return send_frame32(frame::WINDOW_UPDATE, id, increment);
+				}
+			}
+		}
+	}
+}
+
+#endif // HTTP2_SESSION_H
@@ -0,0 +1,125 @@
+#ifndef HTTP2_STREAM_H
+#define HTTP2_STREAM_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include "fs/file.h"
+#include "net/internet/http/open_file_cache.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			namespace http2 {
+				// Stream of an HTTP/2 connection (from the end of the request
+				// headers until the response has been sent).
+				struct stream {
+					public:
+						uint32_t id;
+
+						// Flow-control window for sending.
+						int64_t window;
+
+						// Response headers (HTTP/1.1 syntax, encoded with HPACK
+						// when they are sent).
+						string::buffer headers;
+
+						// Response body: held in memory (bodyp != NULL) or read
+						// from a file.
+						string::buffer body;
+						const string::buffer* bodyp;
+
+						fs::file file;
+
+						// Entry of the cache of open files which holds the
+						// descriptor of 'file' (NULL if 'file' owns it).
+						open_file_cache::entry* open_file;
+
+						// Part of the body not sent yet.
+						off_t offset;
+						off_t end;
+
+						// Have the response headers been sent?
+						unsigned headers_sent:1;
+
+						// Has the request been received completely?
+						unsigned end_stream_received:1;
+
+						stream* prev;
+						stream* next;
+
+						// Constructor.
+						stream();
+
+						// Destructor.
+						~stream();
+
+						// Reset.
+						void reset();
+				};
+
+				inline stream::stream() : file(-1)
+				{
+					id = 0;
+					window = 0;
+
+					bodyp = NULL;
+
+					open_file = NULL;
+
+					offset = 0;
+					end = 0;
+
+					headers_sent = 0;
+					end_stream_received = 0;
+
+					prev = NULL;
+					next = NULL;
+				}
+
+				inline stream::~stream()
+				{
+					if (open_file) {
+						open_file->release();
+					} else if (file.fd() != -1) {
+						file.close();
+					}
+				}
+
+				inline void stream::reset()
+				{
+					if (headers.capacity() > 2 * 1024) {
+						headers.free();
+					} else {
+						headers.clear();
+					}
+
+					if (body.capacity() > 2 * 1024) {
+						body.free();
+					} else {
+						body.clear();
+					}
+
+					bodyp = NULL;
+
+					if (open_file) {
+						open_file->release();
+						open_file = NULL;
+					} else if (file.fd() != -1) {
+						file.close();
+					}
+
+					file.fd(-1);
+
+					offset = 0;
+					end = 0;
+
+					headers_sent = 0;
+					end_stream_received = 0;
+				}
+			}
+		}
+	}
+}
+
+#endif // HTTP2_STREAM_H
@@ -0,0 +1,653 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <new>
+
+#if HAVE_INOTIFY
+	#include <sys/inotify.h>
+#endif // HAVE_INOTIFY
+
+#include "net/internet/http/open_file_cache.h"
+#include "net/internet/http/version.h"
+
+#if HAVE_INOTIFY
+	// Changes in the directory which might invalidate its entries.
+	#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif // HAVE_INOTIFY
+
+net::internet::http::open_file_cache::~open_file_cache()
+{
+	if (_M_entries) {
+		for (entry* e = _M_head; e; e = e->next) {
+			close(e->fd);
+			::free(e->path);
+
+			for (unsigned i = 0; i < content_encoding::COUNT; i++) {
+				if (e->variants[i].fd != -1) {
+					close(e->variants[i].fd);
+				}
+			}
+		}
+
+		delete [] _M_entries;
+	}
+
+	if (_M_buckets) {
+		::free(_M_buckets);
+	}
+
+	if (_M_watches) {
+		::free(_M_watches);
+	}
+
+	if (_M_watch_pool) {
+		::free(_M_watch_pool);
+	}
+
+	if (_M_fd != -1) {
+		close(_M_fd);
+	}
+}
+
+bool net::internet::http::open_file_cache::create(size_t size, unsigned validity, size_t memory_size, size_t max_file_size)
+{
+	if (size == 0) {
+		return true;
+	}
+
+	if (validity == 0) {
+#if HAVE_INOTIFY
+		if ((_M_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+			return false;
+		}
+#else
+		return false;
+#endif // HAVE_INOTIFY
+	}
+
+	// Number of buckets (power of 2).
+	size_t nbuckets = 64;
+	while (nbuckets < size) {
+		nbuckets <<= 1;
+	}
+
+	if ((_M_entries = new (std::nothrow) entry[size]) == NULL) {
+		return false;
+	}
+
+	if ((_M_buckets = (entry**) calloc(nbuckets, sizeof(entry*))) == NULL) {
+		return false;
+	}
+
+	if ((_M_watches = (watch**) calloc(nbuckets, sizeof(watch*))) == NULL) {
+		return false;
+	}
+
+	// One watch per entry at most (plus the one being added).
+	if ((_M_watch_pool = (watch*) malloc((size + 1) * sizeof(watch))) == NULL) {
+		return false;
+	}
+
+	for (size_t i = size; i > 0; i--) {
+		entry* e = &_M_entries[i - 1];
+
+		e->cache = this;
+		e->next = _M_free;
+		_M_free = e;
+	}
+
+	for (size_t i = size + 1; i > 0; i--) {
+		watch* w = &_M_watch_pool[i - 1];
+
+		w->next = _M_free_watches;
+		_M_free_watches = w;
+	}
+
+	_M_size = size;
+	_M_mask = nbuckets - 1;
+
+	_M_validity = ((validity > 0) ? validity : kInotifyValidity) * 1000;
+
+	_M_memory_size = memory_size;
+	_M_max_file_size = max_file_size;
+
+	return true;
+}
+
+net::internet::http::open_file_cache::entry* net::internet::http::open_file_cache::get(const vhost* host, const char* path, unsigned short pathlen, unsigned now)
+{
+	uint32_t h = hash(host, path, pathlen);
+
+	for (entry* e = _M_buckets[h & _M_mask]; e; e = e->hash_next) {
+		if ((e->hash == h) && (e->host == host) && (e->pathlen == pathlen) && (memcmp(e->path, path, pathlen) == 0)) {
+			// Expired?
+			if (now - e->added >= _M_validity) {
+				invalidate(e);
+				return NULL;
+			}
+
+			// Move to the head of the LRU list.
+			if (e != _M_head) {
+				e->prev->next = e->next;
+
+				if (e->next) {
+					e->next->prev = e->prev;
+				} else {
+					_M_tail = e->prev;
+				}
+
+				e->prev = NULL;
+				e->next = _M_head;
+				_M_head->prev = e;
+				_M_head = e;
+			}
+
+			e->refcount++;
+
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+net::internet::http::open_file_cache::entry* net::internet::http::open_file_cache::add(const vhost* host, const char* path, unsigned short pathlen, const char* filename, int fd, const struct stat& buf, const char* mime_type, unsigned short mime_type_len, unsigned now)
+{
+	watch* w = NULL;
+
+#if HAVE_INOTIFY
+	if (_M_fd != -1) {
+		if ((w = add_watch(filename)) == NULL) {
+			return NULL;
+		}
+
+		// If the file has been replaced before the directory was being
+		// watched, don't cache it.
+		struct stat st;
+		if ((stat(filename, &st) < 0) || (st.st_ino != buf.st_ino) || (st.st_dev != buf.st_dev)) {
+			if (!w->entries) {
+				remove_watch(w, true);
+			}
+
+			return NULL;
+		}
+	}
+#endif // HAVE_INOTIFY
+
+	char* p;
+	entry* e;
+	if (((p = (char*) malloc(pathlen)) == NULL) || ((e = allocate()) == NULL)) {
+		if (p) {
+			::free(p);
+		}
+
+		if ((w) && (!w->entries)) {
+			remove_watch(w, true);
+		}
+
+		return NULL;
+	}
+
+	memcpy(p, path, pathlen);
+
+	e->host = host;
+	e->path = p;
+	e->pathlen = pathlen;
+	e->hash = hash(host, path, pathlen);
+
+	e->fd = fd;
+	e->buf = buf;
+
+	e->mime_type = mime_type;
+	e->mime_type_len = mime_type_len;
+
+	for (unsigned i = 0; i < content_encoding::COUNT; i++) {
+		e->variants[i].fd = -1;
+		e->variants[i].buf.st_mode = 0;
+	}
+
+	e->compressing = 0;
+	e->memory = 0;
+
+	e->refcount = 1;
+	e->added = now;
+	e->cached = true;
+
+	// Insert in the hash table.
+	entry** bucket = &_M_buckets[e->hash & _M_mask];
+	e->hash_next = *bucket;
+	*bucket = e;
+
+	// Insert at the head of the LRU list.
+	e->prev = NULL;
+	e->next = _M_head;
+
+	if (_M_head) {
+		_M_head->prev = e;
+	} else {
+		_M_tail = e;
+	}
+
+	_M_head = e;
+
+	// Insert in the list of the directory.
+	e->w = w;
+	e->watch_prev = NULL;
+
+	if (w) {
+		e->watch_next = w->entries;
+
+		if (w->entries) {
+			w->entries->watch_prev = e;
+		}
+
+		w->entries = e;
+	} else {
+		e->watch_next = NULL;
+	}
+
+	return e;
+}
+
+const string::buffer* net::internet::http::open_file_cache::headers(entry* e, const char* mime_type, unsigned short mime_type_len, const file_headers_cache::entry* fh, bool vary)
+{
+	if (e->headers.empty()) {
+		if ((!e->headers.append("Server: " WEBSERVER_NAME "\r\n", 8 + sizeof(WEBSERVER_NAME) - 1 + 2)) ||
+		    (!e->headers.append(fh->etag, fh->etaglen)) ||
+		    (!e->headers.append("Accept-Ranges: bytes\r\n", 22)) ||
+		    (!e->headers.format("Content-Type: %.*s\r\nContent-Length: %lld\r\n", mime_type_len, mime_type, (long long) e->buf.st_size)) ||
+		    ((vary) && (!e->headers.append("Vary: Accept-Encoding\r\n", 23))) ||
+		    (!e->headers.append(fh->last_modified, fh->last_modified_len)) ||
+		    (!e->headers.append("\r\n", 2))) {
+			e->headers.free();
+			return NULL;
+		}
+	}
+
+	return &e->headers;
+}
+
+const string::buffer* net::internet::http::open_file_cache::body(entry* e)
+{
+	size_t size = e->buf.st_size;
+	if ((size == 0) || (size > _M_max_file_size) || (size > _M_memory_size)) {
+		return NULL;
+	}
+
+	if (!e->body.empty()) {
+		_M_memory_hits++;
+
+		touch_memory(e);
+
+		return &e->body;
+	}
+
+	_M_memory_misses++;
+
+	if (!reserve(size)) {
+		return NULL;
+	}
+
+	if (!e->body.allocate(size)) {
+		return NULL;
+	}
+
+	ssize_t ret;
+	while (((ret = pread(e->fd, e->body.data(), size, 0)) < 0) && (errno == EINTR));
+
+	// If the file couldn't be read completely (it might have been
+	// truncated)...
+	if (ret != (ssize_t) size) {
+		e->body.free();
+		return NULL;
+	}
+
+	e->body.length(size);
+
+	add_memory(e, size);
+
+	return &e->body;
+}
+
+const string::buffer* net::internet::http::open_file_cache::compressed(entry* e, unsigned char encoding)
+{
+	if (e->compressed[encoding].empty()) {
+		return NULL;
+	}
+
+	touch_memory(e);
+
+	return &e->compressed[encoding];
+}
+
+bool net::internet::http::open_file_cache::compressed(entry* e, unsigned char encoding, string::buffer& buf)
+{
+	// If the entry has been invalidated while the file was being
+	// compressed...
+	if ((!e->cached) || (!e->compressed[encoding].empty())) {
+		return false;
+	}
+
+	size_t size = buf.length();
+	if ((size > _M_memory_size) || (!reserve(size))) {
+		return false;
+	}
+
+	e->compressed[encoding].swap(buf);
+
+	add_memory(e, size);
+
+	return true;
+}
+
+bool net::internet::http::open_file_cache::on_readable()
+{
+#if HAVE_INOTIFY
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	do {
+		ssize_t ret;
+		if ((ret = read(_M_fd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return true;
+		} else if (ret == 0) {
+			return true;
+		}
+
+		for (const char* ptr = buf; ptr < buf + ret; ) {
+			const struct inotify_event* ev = (const struct inotify_event*) ptr;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				// Events have been lost: invalidate all the entries.
+				for (size_t i = 0; i <= _M_mask; i++) {
+					while (_M_watches[i]) {
+						remove_watch(_M_watches[i], true);
+					}
+				}
+			} else {
+				watch* w;
+				if ((w = find_watch(ev->wd)) != NULL) {
+					// If the watch has been removed by the kernel (the
+					// directory has been deleted or unmounted), there is
+					// no watch descriptor to remove.
+					remove_watch(w, (ev->mask & IN_IGNORED) == 0);
+				}
+			}
+
+			ptr += sizeof(struct inotify_event) + ev->len;
+		}
+	} while (true);
+#else
+	return true;
+#endif // HAVE_INOTIFY
+}
+
+net::internet::http::open_file_cache::watch* net::internet::http::open_file_cache::add_watch(const char* filename)
+{
+#if HAVE_INOTIFY
+	// Directory of the file.
+	const char* slash = strrchr(filename, '/');
+	size_t len = (slash == filename) ? 1 : slash - filename;
+
+	char dir[PATH_MAX + 1];
+	memcpy(dir, filename, len);
+	dir[len] = 0;
+
+	// inotify returns the same watch descriptor if the directory is already
+	// being watched.
+	int wd;
+	if ((wd = inotify_add_watch(_M_fd, dir, WATCH_MASK)) < 0) {
+		return NULL;
+	}
+
+	watch* w;
+	if ((w = find_watch(wd)) != NULL) {
+		return w;
+	}
+
+	if ((w = _M_free_watches) == NULL) {
+		inotify_rm_watch(_M_fd, wd);
+		return NULL;
+	}
+
+	_M_free_watches = w->next;
+
+	w->wd = wd;
+	w->entries = NULL;
+
+	watch** bucket = &_M_watches[(unsigned) wd & _M_mask];
+	w->next = *bucket;
+	*bucket = w;
+
+	return w;
+#else
+	return NULL;
+#endif // HAVE_INOTIFY
+}
+
+net::internet::http::open_file_cache::watch* net::internet::http::open_file_cache::find_watch(int wd) const
+{
+	for (watch* w = _M_watches[(unsigned) wd & _M_mask]; w; w = w->next) {
+		if (w->wd == wd) {
+			return w;
+		}
+	}
+
+	return NULL;
+}
+
+void net::internet::http::open_file_cache::remove_watch(watch* w, bool rm)
+{
+	// Remove from the hash table.
+	watch** prev = &_M_watches[(unsigned) w->wd & _M_mask];
+	while (*prev != w) {
+		prev = &(*prev)->next;
+	}
+
+	*prev = w->next;
+
+#if HAVE_INOTIFY
+	if (rm) {
+		inotify_rm_watch(_M_fd, w->wd);
+	}
+#endif // HAVE_INOTIFY
+
+	// Invalidate the entries of the directory.
+	entry* e = w->entries;
+	while (e) {
+		entry* next = e->watch_next;
+
+		e->w = NULL;
+		invalidate(e);
+
+		e = next;
+	}
+
+	w->next = _M_free_watches;
+	_M_free_watches = w;
+}
+
+void net::internet::http::open_file_cache::invalidate(entry* e)
+{
+	// Remove from the hash table.
+	entry** prev = &_M_buckets[e->hash & _M_mask];
+	while (*prev != e) {
+		prev = &(*prev)->hash_next;
+	}
+
+	*prev = e->hash_next;
+
+	// Remove from the LRU list.
+	if (e->prev) {
+		e->prev->next = e->next;
+	} else {
+		_M_head = e->next;
+	}
+
+	if (e->next) {
+		e->next->prev = e->prev;
+	} else {
+		_M_tail = e->prev;
+	}
+
+	// Remove from the list of the directory (the directory is not watched
+	// anymore if it was the last entry).
+	watch* w;
+	if ((w = e->w) != NULL) {
+		if (e->watch_prev) {
+			e->watch_prev->watch_next = e->watch_next;
+		} else {
+			w->entries = e->watch_next;
+		}
+
+		if (e->watch_next) {
+			e->watch_next->watch_prev = e->watch_prev;
+		}
+
+		e->w = NULL;
+
+		if (!w->entries) {
+			remove_watch(w, true);
+		}
+	}
+
+	e->cached = false;
+
+	if (e->refcount == 0) {
+		free(e);
+	}
+}
+
+void net::internet::http::open_file_cache::free(entry* e)
+{
+	close(e->fd);
+	::free(e->path);
+
+	for (unsigned i = 0; i < content_encoding::COUNT; i++) {
+		if (e->variants[i].fd != -1) {
+			close(e->variants[i].fd);
+		}
+	}
+
+	if (e->memory > 0) {
+		drop_memory(e);
+	}
+
+	e->headers.free();
+
+	e->next = _M_free;
+	_M_free = e;
+}
+
+net::internet::http::open_file_cache::entry* net::internet::http::open_file_cache::allocate()
+{
+	if (!_M_free) {
+		// Evict the least recently used entry which is not in use.
+		entry* e = _M_tail;
+		for (unsigned i = 0; (e) && (i < kMaxEvictionScan); i++, e = e->prev) {
+			if (e->refcount == 0) {
+				invalidate(e);
+				break;
+			}
+		}
+
+		if (!_M_free) {
+			return NULL;
+		}
+	}
+
+	entry* e = _M_free;
+	_M_free = e->next;
+
+	return e;
+}
+
+bool net::internet::http::open_file_cache::reserve(size_t size)
+{
+	while (_M_memory_used + size > _M_memory_size) {
+		entry* victim = _M_memory_tail;
+		for (unsigned i = 0; (victim) && (victim->refcount > 0) && (i < kMaxEvictionScan); i++) {
+			victim = victim->memory_prev;
+		}
+
+		if ((!victim) || (victim->refcount > 0)) {
+			return false;
+		}
+
+		drop_memory(victim);
+	}
+
+	return true;
+}
+
+void net::internet::http::open_file_cache::add_memory(entry* e, size_t size)
+{
+	if (e->memory > 0) {
+		touch_memory(e);
+	} else {
+		e->memory_prev = NULL;
+		e->memory_next = _M_memory_head;
+
+		if (_M_memory_head) {
+			_M_memory_head->memory_prev = e;
+		} else {
+			_M_memory_tail = e;
+		}
+
+		_M_memory_head = e;
+	}
+
+	e->memory += size;
+	_M_memory_used += size;
+}
+
+void net::internet::http::open_file_cache::touch_memory(entry* e)
+{
+	if (e != _M_memory_head) {
+		e->memory_prev->memory_next = e->memory_next;
+
+		if (e->memory_next) {
+			e->memory_next->memory_prev = e->memory_prev;
+		} else {
+			_M_memory_tail = e->memory_prev;
+		}
+
+		e->memory_prev = NULL;
+		e->memory_next = _M_memory_head;
+		_M_memory_head->memory_prev = e;
+		_M_memory_head = e;
+	}
+}
+
+void net::internet::http::open_file_cache::drop_memory(entry* e)
+{
+	if (e->memory_prev) {
+		e->memory_prev->memory_next = e->memory_next;
+	} else {
+		_M_memory_head = e->memory_next;
+	}
+
+	if (e->memory_next) {
+		e->memory_next->memory_prev = e->memory_prev;
+	} else {
+		_M_memory_tail = e->memory_prev;
+	}
+
+	_M_memory_used -= e->memory;
+	e->memory = 0;
+
+	e->body.free();
+
+	// The content codings removed can be compressed again.
+	for (unsigned i = 0; i < content_encoding::COUNT; i++) {
+		if (!e->compressed[i].empty()) {
+			e->compressed[i].free();
+			e->compressing &= ~(1 << i);
+		}
+	}
+}
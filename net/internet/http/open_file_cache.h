@@ -0,0 +1,356 @@
+#ifndef HTTP_OPEN_FILE_CACHE_H
+#define HTTP_OPEN_FILE_CACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include "io/event_handler.h"
+#include "net/internet/http/file_headers_cache.h"
+#include "net/internet/http/content_encoding.h"
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			class vhost;
+
+			// Cache of open files: for each resolved path (the path of the
+			// request under the document root of the virtual host), the
+			// descriptor of the file, its metadata, the index file used (for
+			// directories) and its precompressed variants. The bodies of small
+			// files are also kept in memory (up to a number of bytes) along
+			// with the response headers which only depend on the file, and so
+			// are the bodies compressed on the fly. Each worker has its own
+			// cache, so no locking is needed.
+			//
+			// The entries are invalidated when the directory of the file
+			// changes (inotify) or when they are older than the configured
+			// validity. Only the directory of the file is watched (changes in
+			// the parent directories, such as renaming one of them or
+			// replacing it by a symbolic link, are not notified), so with
+			// inotify the entries are also invalidated after
+			// kInotifyValidity seconds. The entries are reference-counted: an entry which is
+			// invalidated or evicted while a response is still being sent
+			// keeps its descriptor open until the response has been sent.
+			class open_file_cache : public io::event_handler {
+				public:
+					static const size_t kDefaultSize = 1024;
+					static const size_t kMaxSize = 64 * 1024;
+
+					static const unsigned kMaxValidity = 24 * 60 * 60; // [seconds]
+
+					// Validity of the entries when they are invalidated by
+					// inotify [seconds].
+					static const unsigned kInotifyValidity = 60;
+
+					// Memory for the bodies of small files [bytes].
+					static const size_t kDefaultMemorySize = 16 * 1024 * 1024;
+					static const size_t kMaxMemorySize = 1024 * 1024 * 1024;
+					static const size_t kDefaultMaxFileSize = 64 * 1024;
+					static const size_t kMaxMaxFileSize = 16 * 1024 * 1024;
+
+					struct watch;
+
+					// Precompressed variant of a file (fd = -1 and
+					// st_mode = 0 if there is none).
+					struct variant {
+						int fd;
+						struct stat buf;
+					};
+
+					struct entry {
+						open_file_cache* cache;
+
+						// Key.
+						const vhost* host;
+						char* path;
+						unsigned short pathlen;
+						uint32_t hash;
+
+						int fd;
+						struct stat buf;
+
+						// MIME type of the index file (NULL if the path
+						// is not a directory).
+						const char* mime_type;
+						unsigned short mime_type_len;
+
+						// Precompressed variants (by content coding).
+						variant variants[content_encoding::COUNT];
+
+						// Headers of a full response, from "Server:" to the
+						// empty line (empty if not built yet).
+						string::buffer headers;
+
+						// Body (empty if not in memory).
+						string::buffer body;
+
+						// Bodies compressed on the fly (by content coding,
+						// empty if not in memory).
+						string::buffer compressed[content_encoding::COUNT];
+
+						// Content codings compressed or being compressed
+						// (bitmask of 1 << encoding).
+						unsigned char compressing;
+
+						// Memory used by the bodies [bytes].
+						size_t memory;
+
+						// Number of responses using the entry.
+						unsigned refcount;
+
+						// When the entry was added [msec].
+						unsigned added;
+
+						// Is the entry in the cache?
+						bool cached;
+
+						// Directory being watched.
+						watch* w;
+
+						// LRU list (most recently used first) or free
+						// list.
+						entry* prev;
+						entry* next;
+
+						// Hash chain.
+						entry* hash_next;
+
+						// Entries of the same directory.
+						entry* watch_prev;
+						entry* watch_next;
+
+						// Entries with the body in memory (most recently
+						// used first).
+						entry* memory_prev;
+						entry* memory_next;
+
+						// Release entry.
+						void release();
+					};
+
+					struct watch {
+						int wd;
+
+						entry* entries;
+
+						watch* next;
+					};
+
+					// Constructor.
+					open_file_cache();
+
+					// Destructor.
+					~open_file_cache();
+
+					// Create (validity = 0: the entries are invalidated by
+					// inotify, or after kInotifyValidity seconds;
+					// memory_size = 0: no bodies in memory).
+					bool create(size_t size, unsigned validity, size_t memory_size, size_t max_file_size);
+
+					// Is the cache enabled?
+					bool enabled() const;
+
+					// Get descriptor to be watched (-1 if none).
+					int fd() const;
+
+					// Get entry (the caller must release it).
+					entry* get(const vhost* host, const char* path, unsigned short pathlen, unsigned now);
+
+					// Add entry (the caller must release it). 'filename' is
+					// the path of the file 'fd' (which might be a directory
+					// index). Returns NULL if the file couldn't be cached (the
+					// caller keeps the ownership of the descriptor).
+					entry* add(const vhost* host, const char* path, unsigned short pathlen, const char* filename, int fd, const struct stat& buf, const char* mime_type, unsigned short mime_type_len, unsigned now);
+
+					// Get the headers of a full response (built the first
+					// time; 'vary': add "Vary: Accept-Encoding").
+					const string::buffer* headers(entry* e, const char* mime_type, unsigned short mime_type_len, const file_headers_cache::entry* fh, bool vary);
+
+					// Get the body of a small file (loaded the first time).
+					// Returns NULL if the file is too large or can't be kept
+					// in memory.
+					const string::buffer* body(entry* e);
+
+					// Get the body compressed on the fly (NULL if not
+					// compressed yet).
+					const string::buffer* compressed(entry* e, unsigned char encoding);
+
+					// Add body compressed on the fly (swapped with 'buf').
+					// Returns false if the entry has been invalidated or
+					// there is no room.
+					bool compressed(entry* e, unsigned char encoding, string::buffer& buf);
+
+					// Get statistics of the bodies in memory.
+					unsigned long long memory_hits() const;
+					unsigned long long memory_misses() const;
+					size_t memory_used() const;
+
+					// On readable.
+					bool on_readable();
+
+					// On writable.
+					bool on_writable();
+
+				private:
+					// Maximum number of entries to scan when searching an
+					// entry to evict.
+					static const unsigned kMaxEvictionScan = 8;
+
+					entry* _M_entries;
+					size_t _M_size;
+
+					// Hash table of the entries.
+					entry** _M_buckets;
+					size_t _M_mask;
+
+					// LRU list.
+					entry* _M_head;
+					entry* _M_tail;
+
+					// Free entries.
+					entry* _M_free;
+
+					// Hash table of the watches (by watch descriptor).
+					watch** _M_watches;
+					watch* _M_free_watches;
+					watch* _M_watch_pool;
+
+					unsigned _M_validity; // [msec]
+
+					// Entries with the body in memory.
+					entry* _M_memory_head;
+					entry* _M_memory_tail;
+
+					size_t _M_memory_size;
+					size_t _M_memory_used;
+					size_t _M_max_file_size;
+
+					unsigned long long _M_memory_hits;
+					unsigned long long _M_memory_misses;
+
+					int _M_fd;
+
+					// Hash path.
+					static uint32_t hash(const vhost* host, const char* path, unsigned short pathlen);
+
+					// Find or add watch of the directory of the file.
+					watch* add_watch(const char* filename);
+
+					// Find watch.
+					watch* find_watch(int wd) const;
+
+					// Remove watch (the entries are invalidated).
+					void remove_watch(watch* w, bool rm);
+
+					// Invalidate entry (removed from the cache, freed once
+					// released).
+					void invalidate(entry* e);
+
+					// Free entry.
+					void free(entry* e);
+
+					// Get free entry (an entry might be evicted).
+					entry* allocate();
+
+					// Make room for 'size' bytes in memory (the bodies being
+					// sent are not removed).
+					bool reserve(size_t size);
+
+					// Account memory of the entry (moved to the head of the
+					// list).
+					void add_memory(entry* e, size_t size);
+
+					// Move entry to the head of the list of entries with the
+					// bodies in memory.
+					void touch_memory(entry* e);
+
+					// Remove the bodies from memory.
+					void drop_memory(entry* e);
+			};
+
+			inline open_file_cache::open_file_cache()
+			{
+				_M_entries = NULL;
+				_M_size = 0;
+
+				_M_buckets = NULL;
+				_M_mask = 0;
+
+				_M_head = NULL;
+				_M_tail = NULL;
+
+				_M_free = NULL;
+
+				_M_watches = NULL;
+				_M_free_watches = NULL;
+				_M_watch_pool = NULL;
+
+				_M_validity = 0;
+
+				_M_memory_head = NULL;
+				_M_memory_tail = NULL;
+
+				_M_memory_size = 0;
+				_M_memory_used = 0;
+				_M_max_file_size = 0;
+
+				_M_memory_hits = 0;
+				_M_memory_misses = 0;
+
+				_M_fd = -1;
+			}
+
+			inline bool open_file_cache::enabled() const
+			{
+				return (_M_size > 0);
+			}
+
+			inline int open_file_cache::fd() const
+			{
+				return _M_fd;
+			}
+
+			inline unsigned long long open_file_cache::memory_hits() const
+			{
+				return _M_memory_hits;
+			}
+
+			inline unsigned long long open_file_cache::memory_misses() const
+			{
+				return _M_memory_misses;
+			}
+
+			inline size_t open_file_cache::memory_used() const
+			{
+				return _M_memory_used;
+			}
+
+			inline bool open_file_cache::on_writable()
+			{
+				return true;
+			}
+
+			inline void open_file_cache::entry::release()
+			{
+				if ((--refcount == 0) && (!cached)) {
+					cache->free(this);
+				}
+			}
+
+			inline uint32_t open_file_cache::hash(const vhost* host, const char* path, unsigned short pathlen)
+			{
+				// FNV-1a.
+				uint32_t h = 2166136261u ^ (uint32_t) ((uintptr_t) host >> 4);
+
+				for (unsigned short i = 0; i < pathlen; i++) {
+					h = (h ^ (unsigned char) path[i]) * 16777619u;
+				}
+
+				return h;
+			}
+		}
+	}
+}
+
+#endif // HTTP_OPEN_FILE_CACHE_H
@@ -1,9 +1,11 @@
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include "net/internet/http/server.h"
 #include "net/internet/default_ports.h"
 #include "util/configuration.h"
 #include "string/memrchr.h"
+#include "string/scan.h"
 
 bool net::internet::http::server::create(const char* config_file, const char* mime_types_file)
 {
@@ -23,6 +25,30 @@ bool net::internet::http::server::create(const char* config_file, const char* mi
 		return false;
 	}
 
+	if (!_M_open_files.create(_M_open_file_cache_size, _M_open_file_cache_validity, _M_memory_cache_size, _M_memory_cache_max_file_size)) {
+		return false;
+	}
+
+	if (_M_open_files.fd() != -1) {
+		if (!selector::add(_M_open_files.fd(), fdset::FD_NOTIFIER, &_M_open_files, READ)) {
+			return false;
+		}
+	}
+
+	// The files compressed on the fly are kept with the bodies of the small
+	// files.
+	if ((_M_compression) && (_M_open_files.enabled()) && (_M_memory_cache_size > 0)) {
+		if (!_M_compressor.create(&_M_open_files, _M_compression_level)) {
+			return false;
+		}
+
+		if (!selector::add(_M_compressor.fd(), fdset::FD_NOTIFIER, &_M_compressor, READ)) {
+			return false;
+		}
+	}
+
+	string::scan::init();
+
 	return true;
 }
 
@@ -44,6 +70,234 @@ bool net::internet::http::server::load_config(const char* config_file)
 
 	const char* value;
 	unsigned short valuelen;
+
+	// Number of workers (event loops).
+	if (conf.get_value(value, &valuelen, "http", "workers", NULL)) {
+		if ((valuelen == 4) && (strncasecmp(value, "auto", 4) == 0)) {
+			long ncpus;
+			if ((ncpus = sysconf(_SC_NPROCESSORS_ONLN)) <= 0) {
+				_M_workers = 1;
+			} else {
+				_M_workers = MIN((unsigned long) ncpus, kMaxWorkers);
+			}
+		} else if (util::number::parse(value, valuelen, _M_workers, 1, kMaxWorkers) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"workers\".\n", value);
+			return false;
+		}
+	}
+
+	// How the workers listen: each one with its own listener sockets
+	// (SO_REUSEPORT) or sharing the listener sockets of the first worker.
+	if (conf.get_value(value, &valuelen, "http", "listeners", NULL)) {
+		if ((valuelen == 10) && (strncasecmp(value, "reuse_port", 10) == 0)) {
+			_M_reuse_port = (_M_workers > 1);
+		} else if ((valuelen == 6) && (strncasecmp(value, "shared", 6) == 0)) {
+			_M_reuse_port = false;
+
+			// Wake up a single worker per incoming connection.
+			_M_exclusive_accept = (_M_workers > 1);
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"listeners\".\n", value);
+			return false;
+		}
+	} else {
+		_M_reuse_port = (_M_workers > 1);
+	}
+
+	// Idle timer: "precise" (rearmed on every I/O operation) or "lazy"
+	// (armed once, the I/O operations only stamp the last activity).
+	if (conf.get_value(value, &valuelen, "http", "idle_timer", NULL)) {
+		if ((valuelen == 7) && (strncasecmp(value, "precise", 7) == 0)) {
+			tcp_connection::_M_lazy_idle_timer = false;
+		} else if ((valuelen == 4) && (strncasecmp(value, "lazy", 4) == 0)) {
+			tcp_connection::_M_lazy_idle_timer = true;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"idle_timer\".\n", value);
+			return false;
+		}
+	}
+
+	// Maximum number of connections to accept per wakeup.
+	if (conf.get_value(value, &valuelen, "http", "accept_batch", NULL)) {
+		if (util::number::parse(value, valuelen, _M_accept_batch, 1, kMaxAcceptBatch) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"accept_batch\".\n", value);
+			return false;
+		}
+	}
+
+	// Keep-alive timeout [seconds].
+	if (conf.get_value(value, &valuelen, "http", "keep_alive_timeout", NULL)) {
+		if (util::number::parse(value, valuelen, _M_keep_alive_timeout, 1, kMaxKeepAliveTimeout) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"keep_alive_timeout\".\n", value);
+			return false;
+		}
+	}
+
+	// Maximum number of requests per connection (0: unlimited).
+	if (conf.get_value(value, &valuelen, "http", "keep_alive_max_requests", NULL)) {
+		if (util::number::parse(value, valuelen, _M_keep_alive_max_requests, 0, kMaxKeepAliveMaxRequests) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"keep_alive_max_requests\".\n", value);
+			return false;
+		}
+	}
+
+	// Keep-alive policy: "fixed" (the configured limits) or "adaptive" (the
+	// limits are lowered when the descriptors are running out).
+	if (conf.get_value(value, &valuelen, "http", "keep_alive_policy", NULL)) {
+		if ((valuelen == 5) && (strncasecmp(value, "fixed", 5) == 0)) {
+			_M_adaptive_keep_alive = false;
+		} else if ((valuelen == 8) && (strncasecmp(value, "adaptive", 8) == 0)) {
+			_M_adaptive_keep_alive = true;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"keep_alive_policy\".\n", value);
+			return false;
+		}
+	}
+
+	// HTTP/2.
+	if (conf.get_value(value, &valuelen, "http", "http2", NULL)) {
+		if ((valuelen == 3) && (strncasecmp(value, "yes", 3) == 0)) {
+			_M_http2 = true;
+		} else if ((valuelen == 2) && (strncasecmp(value, "no", 2) == 0)) {
+			_M_http2 = false;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"http2\".\n", value);
+			return false;
+		}
+	}
+
+	// Kernel TLS.
+	if (conf.get_value(value, &valuelen, "http", "ktls", NULL)) {
+		if ((valuelen == 3) && (strncasecmp(value, "yes", 3) == 0)) {
+			_M_ktls = true;
+		} else if ((valuelen == 2) && (strncasecmp(value, "no", 2) == 0)) {
+			_M_ktls = false;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"ktls\".\n", value);
+			return false;
+		}
+	}
+
+	// Maximum number of bytes of the ranges requested (0: no limit).
+	if (conf.get_value(value, &valuelen, "http", "max_range_bytes", NULL)) {
+		if (util::number::parse(value, valuelen, _M_max_range_bytes, 0, LLONG_MAX) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"max_range_bytes\".\n", value);
+			return false;
+		}
+	}
+
+	// Cache of open files (number of entries per worker, 0: disabled).
+	bool open_file_cache_size = false;
+	if (conf.get_value(value, &valuelen, "http", "open_file_cache", NULL)) {
+		if (util::number::parse(value, valuelen, _M_open_file_cache_size, 0, open_file_cache::kMaxSize) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"open_file_cache\".\n", value);
+			return false;
+		}
+
+		open_file_cache_size = true;
+	}
+
+	// Validity of the entries of the cache of open files: "inotify" (until
+	// the directory of the file changes) or a number of seconds.
+	if (conf.get_value(value, &valuelen, "http", "open_file_cache_validity", NULL)) {
+		if ((valuelen == 7) && (strncasecmp(value, "inotify", 7) == 0)) {
+#if HAVE_INOTIFY
+			_M_open_file_cache_validity = 0;
+#else
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"open_file_cache_validity\" (inotify is not available).\n", value);
+			return false;
+#endif // HAVE_INOTIFY
+		} else if (util::number::parse(value, valuelen, _M_open_file_cache_validity, 1, open_file_cache::kMaxValidity) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"open_file_cache_validity\".\n", value);
+			return false;
+		} else if (!open_file_cache_size) {
+			_M_open_file_cache_size = open_file_cache::kDefaultSize;
+		}
+	}
+
+	// Memory for the bodies of small files (0: disabled) [bytes].
+	if (conf.get_value(value, &valuelen, "http", "memory_cache_size", NULL)) {
+		if (util::number::parse(value, valuelen, _M_memory_cache_size, 0, open_file_cache::kMaxMemorySize) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"memory_cache_size\".\n", value);
+			return false;
+		}
+	}
+
+	// Maximum size of the files kept in memory [bytes].
+	if (conf.get_value(value, &valuelen, "http", "memory_cache_max_file_size", NULL)) {
+		if (util::number::parse(value, valuelen, _M_memory_cache_max_file_size, 1, open_file_cache::kMaxMaxFileSize) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"memory_cache_max_file_size\".\n", value);
+			return false;
+		}
+	}
+
+	// Compression level (1 - 9).
+	if (conf.get_value(value, &valuelen, "http", "compression_level", NULL)) {
+		if (util::number::parse(value, valuelen, _M_compression_level, 1, compressor::kMaxLevel) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"compression_level\".\n", value);
+			return false;
+		}
+	}
+
+	// Minimum size of the responses to compress [bytes].
+	if (conf.get_value(value, &valuelen, "http", "compression_min_length", NULL)) {
+		if (util::number::parse(value, valuelen, _M_compression_min_length, 1, compressor::kMaxMaxLength) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"compression_min_length\".\n", value);
+			return false;
+		}
+	}
+
+	// Maximum size of the files to compress [bytes].
+	if (conf.get_value(value, &valuelen, "http", "compression_max_length", NULL)) {
+		if (util::number::parse(value, valuelen, _M_compression_max_length, 1, compressor::kMaxMaxLength) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"compression_max_length\".\n", value);
+			return false;
+		}
+	}
+
+	// MIME types to compress.
+	const char* type;
+	unsigned short typelen;
+	for (size_t i = 0; conf.get_key(type, typelen, i, "http", "compression_types", NULL); i++) {
+		if (!_M_compression_types.append_nul_terminated_string(type, typelen)) {
+			return false;
+		}
+	}
+
+	if (_M_compression_types.empty()) {
+		static const char* types[] = {
+			"text/html",
+			"text/css",
+			"text/plain",
+			"text/xml",
+			"text/javascript",
+			"application/javascript",
+			"application/json",
+			"application/xml",
+			"image/svg+xml"
+		};
+
+		for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+			if (!_M_compression_types.append_nul_terminated_string(types[i], strlen(types[i]))) {
+				return false;
+			}
+		}
+	}
+
+	// URL of the server status page (event loop statistics).
+	if (conf.get_value(value, &valuelen, "http", "status_url", NULL)) {
+		if ((valuelen == 0) || (*value != '/')) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"status_url\".\n", value);
+			return false;
+		}
+
+		if (!_M_status_url.append(value, valuelen)) {
+			return false;
+		}
+
+		_M_collect_stats = true;
+	}
+
 	if (!conf.get_value(value, &valuelen, "http", "directory_listing", NULL)) {
 		global_directory_listing = TRIBOOL_UNDEFINED;
 	} else {
@@ -156,11 +410,72 @@ bool net::internet::http::server::load_config(const char* config_file)
 			}
 		}
 
+		unsigned keep_alive_timeout;
+		if (!conf.get_value(value, &valuelen, "http", "hosts", host, "keep_alive_timeout", NULL)) {
+			keep_alive_timeout = _M_keep_alive_timeout;
+		} else if (util::number::parse(value, valuelen, keep_alive_timeout, 1, kMaxKeepAliveTimeout) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"hosts\" -> \"%s\" -> \"keep_alive_timeout\".\n", value, host);
+			return false;
+		}
+
+		unsigned keep_alive_max_requests;
+		if (!conf.get_value(value, &valuelen, "http", "hosts", host, "keep_alive_max_requests", NULL)) {
+			keep_alive_max_requests = _M_keep_alive_max_requests;
+		} else if (util::number::parse(value, valuelen, keep_alive_max_requests, 0, kMaxKeepAliveMaxRequests) != util::number::PARSE_SUCCEEDED) {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"hosts\" -> \"%s\" -> \"keep_alive_max_requests\".\n", value, host);
+			return false;
+		}
+
+		bool memory_cache;
+		if (!conf.get_value(value, &valuelen, "http", "hosts", host, "memory_cache", NULL)) {
+			memory_cache = true;
+		} else if ((valuelen == 3) && (strncasecmp(value, "yes", 3) == 0)) {
+			memory_cache = true;
+		} else if ((valuelen == 2) && (strncasecmp(value, "no", 2) == 0)) {
+			memory_cache = false;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"hosts\" -> \"%s\" -> \"memory_cache\".\n", value, host);
+			return false;
+		}
+
+		bool precompressed;
+		if (!conf.get_value(value, &valuelen, "http", "hosts", host, "precompressed", NULL)) {
+			precompressed = false;
+		} else if ((valuelen == 3) && (strncasecmp(value, "yes", 3) == 0)) {
+			precompressed = true;
+		} else if ((valuelen == 2) && (strncasecmp(value, "no", 2) == 0)) {
+			precompressed = false;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"hosts\" -> \"%s\" -> \"precompressed\".\n", value, host);
+			return false;
+		}
+
+		bool compression;
+		if (!conf.get_value(value, &valuelen, "http", "hosts", host, "compression", NULL)) {
+			compression = false;
+		} else if ((valuelen == 3) && (strncasecmp(value, "yes", 3) == 0)) {
+			compression = true;
+		} else if ((valuelen == 2) && (strncasecmp(value, "no", 2) == 0)) {
+			compression = false;
+		} else {
+			fprintf(stderr, "Invalid value \"%s\" for key \"http\" -> \"hosts\" -> \"%s\" -> \"compression\".\n", value, host);
+			return false;
+		}
+
 		vhost* v;
 		if ((v = new (std::nothrow) vhost()) == NULL) {
 			return false;
 		}
 
+		v->keep_alive(keep_alive_timeout, keep_alive_max_requests);
+		v->memory_cache(memory_cache);
+		v->precompressed(precompressed);
+		v->compression(compression);
+
+		if (compression) {
+			_M_compression = true;
+		}
+
 		if (!v->name(host, hostlen)) {
 			delete v;
 			return false;
@@ -293,7 +608,8 @@ bool net::internet::http::server::load_config(const char* config_file)
 bool net::internet::http::server::listen(const socket_address& addr, bool https)
 {
 #if HAVE_SSL
-	if ((https) && (!_M_ssl_initialized)) {
+	// The SSL library is initialized only once (by the first worker).
+	if ((https) && (!ssl_socket::ssl_library_initialized())) {
 		if (!ssl_socket::init_ssl_library()) {
 			return false;
 		}
@@ -303,6 +619,16 @@ bool net::internet::http::server::listen(const socket_address& addr, bool https)
 		if (!ssl_socket::load_certificate("server.crt", "privkey.pem")) {
 			return false;
 		}
+
+		// Offer HTTP/2 with ALPN.
+		if (_M_http2) {
+			static const unsigned char protocols[] = "\x02h2\x08http/1.1";
+			ssl_socket::alpn_protocols(protocols, sizeof(protocols) - 1);
+		}
+
+		if (_M_ktls) {
+			ssl_socket::enable_ktls();
+		}
 	}
 #endif // HAVE_SSL
 
@@ -323,3 +649,40 @@ const char* net::internet::http::server::extension(const char* filename, unsigne
 
 	return NULL;
 }
+
+bool net::internet::http::server::compressible(const char* type, unsigned short len, off_t size) const
+{
+	if ((size < (off_t) _M_compression_min_length) || (size > (off_t) _M_compression_max_length)) {
+		return false;
+	}
+
+	// Skip the parameters ("text/html; charset=UTF-8").
+	const char* semicolon;
+	if ((semicolon = (const char*) memchr(type, ';', len)) != NULL) {
+		len = semicolon - type;
+
+		while ((len > 0) && (IS_WHITE_SPACE(type[len - 1]))) {
+			len--;
+		}
+	}
+
+	const char* t = _M_compression_types.data();
+	const char* end = t + _M_compression_types.length();
+
+	while (t < end) {
+		size_t tlen = strlen(t);
+
+		if ((tlen == len) && (strncasecmp(t, type, len) == 0)) {
+			return true;
+		}
+
+		// "type/*"?
+		if ((tlen >= 2) && (t[tlen - 2] == '/') && (t[tlen - 1] == '*') && (len >= tlen) && (strncasecmp(t, type, tlen - 1) == 0)) {
+			return true;
+		}
+
+		t += tlen + 1;
+	}
+
+	return false;
+}
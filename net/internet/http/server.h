@@ -7,6 +7,9 @@
 #include "net/internet/http/connection.h"
 #include "net/internet/http/vhosts.h"
 #include "net/internet/http/error.h"
+#include "net/internet/http/file_headers_cache.h"
+#include "net/internet/http/open_file_cache.h"
+#include "net/internet/http/compressor.h"
 #include "net/internet/mime/types.h"
 
 namespace net {
@@ -14,6 +17,22 @@ namespace net {
 		namespace http {
 			class server : public tcp_server {
 				public:
+					static const unsigned kMaxWorkers = 1024;
+
+					// Number of connections per slab.
+					static const size_t kConnectionsPerSlab = 64;
+
+					// Keep-alive defaults.
+					static const unsigned kDefaultKeepAliveTimeout = 30; // [seconds]
+					static const unsigned kDefaultKeepAliveMaxRequests = 100;
+
+					static const unsigned kMaxKeepAliveTimeout = 3600; // [seconds]
+					static const unsigned kMaxKeepAliveMaxRequests = 65535;
+
+					// Adaptive keep-alive: the limits are lowered when more than
+					// 3/4 of the descriptors are in use.
+					static const unsigned kAdaptiveKeepAliveThreshold = 75; // [%]
+
 					// Constructor.
 					server();
 
@@ -27,6 +46,11 @@ namespace net {
 					// On new connection.
 					bool on_new_connection(socket& client, const socket_address& addr, struct listener* listener);
 
+#if HAVE_SSL
+					// Are the connections of the listener encrypted?
+					bool encrypted(const struct listener* listener) const;
+#endif // HAVE_SSL
+
 					// Get virtual hosts.
 					vhosts& virtual_hosts();
 
@@ -36,8 +60,54 @@ namespace net {
 					// Get boundary.
 					unsigned boundary();
 
+					// Get the response headers of a file (ETag and Last-Modified).
+					const file_headers_cache::entry* file_headers(const struct stat& buf, unsigned char encoding = content_encoding::IDENTITY);
+
+					// Get cache of open files.
+					open_file_cache& open_files();
+					const open_file_cache& open_files() const;
+
+					// Get compressor.
+					compressor& compression();
+					const compressor& compression() const;
+
+					// Should a response of the given MIME type and size be
+					// compressed on the fly?
+					bool compressible(const char* type, unsigned short len, off_t size) const;
+
+					// Get number of workers.
+					unsigned workers() const;
+
+					// Get URL of the server status page (empty if disabled).
+					const string::buffer& status_url() const;
+
+					// Get keep-alive policy of a virtual host (NULL: global).
+					void keep_alive(const vhost* v, unsigned& timeout, unsigned& max_requests) const;
+
+					// Is HTTP/2 enabled?
+					bool http2() const;
+
+					// Get maximum number of bytes of the ranges requested (0:
+					// no limit).
+					off_t max_range_bytes() const;
+
+					// Count connections per state.
+					void connection_states(size_t* states, size_t nstates) const;
+
 				protected:
-					connection* _M_http_connections;
+					// Slab of connections.
+					struct slab {
+						connection* connections;
+						size_t count;
+
+						// Number of free connections (computed when
+						// trimming).
+						size_t nfree;
+					};
+
+					// Slabs of connections.
+					slab* _M_slabs;
+					size_t _M_nslabs;
 
 					vhosts _M_vhosts;
 
@@ -47,14 +117,62 @@ namespace net {
 
 					mime::types _M_mime_types;
 
+					file_headers_cache _M_file_headers;
+
+					// Cache of open files: number of entries and validity
+					// [seconds] (0: invalidated by inotify).
+					open_file_cache _M_open_files;
+					unsigned _M_open_file_cache_size;
+					unsigned _M_open_file_cache_validity;
+
+					// Memory for the bodies of small files and maximum size
+					// of the files kept in memory [bytes].
+					unsigned _M_memory_cache_size;
+					unsigned _M_memory_cache_max_file_size;
+
+					// On-the-fly compression (started if some virtual host
+					// uses it): level, sizes of the responses [bytes] and
+					// MIME types (NUL-terminated, "type/*" matches any
+					// subtype).
+					compressor _M_compressor;
+					bool _M_compression;
+					int _M_compression_level;
+					unsigned _M_compression_min_length;
+					unsigned _M_compression_max_length;
+					string::buffer _M_compression_types;
+
 					unsigned _M_boundary;
 
+					unsigned _M_workers;
+
+					string::buffer _M_status_url;
+
+					// Keep-alive policy.
+					unsigned _M_keep_alive_timeout;
+					unsigned _M_keep_alive_max_requests;
+					bool _M_adaptive_keep_alive;
+
+					// HTTP/2 (ALPN "h2" and prior knowledge on cleartext
+					// connections).
+					bool _M_http2;
+
+					// Maximum number of bytes of the ranges requested (before
+					// coalescing them, 0: no limit).
+					uint64_t _M_max_range_bytes;
+
+					// Kernel TLS (the files are sent with sendfile() on
+					// HTTPS if the kernel supports it).
+					bool _M_ktls;
+
 					// Load configuration.
 					bool load_config(const char* config_file);
 
 					// Create connections.
 					bool create_connections();
 
+					// Release the slabs whose connections are all free.
+					void trim_connections();
+
 					// Listen.
 					bool listen(const socket_address& addr, bool https);
 
@@ -68,13 +186,49 @@ namespace net {
 				_M_ssl_initialized = false;
 #endif // HAVE_SSL
 
+				_M_slabs = NULL;
+				_M_nslabs = 0;
+
 				_M_boundary = 0;
+
+				_M_workers = 1;
+
+				_M_keep_alive_timeout = kDefaultKeepAliveTimeout;
+				_M_keep_alive_max_requests = kDefaultKeepAliveMaxRequests;
+				_M_adaptive_keep_alive = false;
+
+				_M_http2 = true;
+
+				_M_ktls = false;
+
+				_M_max_range_bytes = 0;
+
+#if HAVE_INOTIFY
+				_M_open_file_cache_size = open_file_cache::kDefaultSize;
+#else
+				// Disabled unless a validity is configured.
+				_M_open_file_cache_size = 0;
+#endif // HAVE_INOTIFY
+
+				_M_open_file_cache_validity = 0;
+
+				_M_memory_cache_size = open_file_cache::kDefaultMemorySize;
+				_M_memory_cache_max_file_size = open_file_cache::kDefaultMaxFileSize;
+
+				_M_compression = false;
+				_M_compression_level = compressor::kDefaultLevel;
+				_M_compression_min_length = compressor::kDefaultMinLength;
+				_M_compression_max_length = compressor::kDefaultMaxLength;
 			}
 
 			inline server::~server()
 			{
-				if (_M_http_connections) {
-					delete [] _M_http_connections;
+				if (_M_slabs) {
+					for (size_t i = 0; i < _M_nslabs; i++) {
+						delete [] _M_slabs[i].connections;
+					}
+
+					free(_M_slabs);
 				}
 
 #if HAVE_SSL
@@ -91,12 +245,19 @@ namespace net {
 				}
 
 #if HAVE_SSL
-				_M_http_connections[client.fd()]._M_https = (listener->_M_data != NULL);
+				static_cast<connection*>(_M_fdset.handler(client.fd()))->_M_https = (listener->_M_data != NULL);
 #endif // HAVE_SSL
 
 				return true;
 			}
 
+#if HAVE_SSL
+			inline bool server::encrypted(const struct listener* listener) const
+			{
+				return (listener->_M_data != NULL);
+			}
+#endif // HAVE_SSL
+
 			inline vhosts& server::virtual_hosts()
 			{
 				return _M_vhosts;
@@ -112,19 +273,204 @@ namespace net {
 				return ++_M_boundary;
 			}
 
+			inline const file_headers_cache::entry* server::file_headers(const struct stat& buf, unsigned char encoding)
+			{
+				return _M_file_headers.get(buf, encoding);
+			}
+
+			inline open_file_cache& server::open_files()
+			{
+				return _M_open_files;
+			}
+
+			inline const open_file_cache& server::open_files() const
+			{
+				return _M_open_files;
+			}
+
+			inline compressor& server::compression()
+			{
+				return _M_compressor;
+			}
+
+			inline const compressor& server::compression() const
+			{
+				return _M_compressor;
+			}
+
+			inline unsigned server::workers() const
+			{
+				return _M_workers;
+			}
+
+			inline const string::buffer& server::status_url() const
+			{
+				return _M_status_url;
+			}
+
+			inline void server::keep_alive(const vhost* v, unsigned& timeout, unsigned& max_requests) const
+			{
+				if (v) {
+					timeout = v->keep_alive_timeout();
+					max_requests = v->keep_alive_max_requests();
+				} else {
+					timeout = _M_keep_alive_timeout;
+					max_requests = _M_keep_alive_max_requests;
+				}
+
+				if (_M_adaptive_keep_alive) {
+					size_t size = _M_fdset.size();
+					size_t threshold = (size * kAdaptiveKeepAliveThreshold) / 100;
+
+					// The limit is shared by all the workers.
+					size_t used = fdset::total_count();
+
+					// If the number of descriptors in use approaches the limit,
+					// lower the limits proportionally to the descriptors left.
+					if ((used > threshold) && (size > threshold)) {
+						size_t left = (used < size) ? size - used : 0;
+						size_t range = size - threshold;
+
+						timeout = MAX(1, (timeout * left) / range);
+
+						if (max_requests > 0) {
+							max_requests = MAX(1, (max_requests * left) / range);
+						}
+					}
+				}
+			}
+
+			inline bool server::http2() const
+			{
+				return _M_http2;
+			}
+
+			inline off_t server::max_range_bytes() const
+			{
+				return (off_t) _M_max_range_bytes;
+			}
+
+			inline void server::connection_states(size_t* states, size_t nstates) const
+			{
+				for (size_t i = 0; i < nstates; i++) {
+					states[i] = 0;
+				}
+
+				size_t count = _M_fdset.count();
+				for (size_t i = 0; i < count; i++) {
+					int fd = _M_fdset.fd(i);
+					if (_M_fdset.type(fd) == fdset::FD_SOCKET) {
+						unsigned state = static_cast<const connection*>(_M_fdset.handler(fd))->_M_state;
+						if (state < nstates) {
+							states[state]++;
+						}
+					}
+				}
+			}
+
 			inline bool server::create_connections()
 			{
-				if ((_M_http_connections = new (std::nothrow) connection[_M_fdset.size()]) == NULL) {
+				// Don't allocate more connections than descriptors.
+				if (_M_nconnections >= _M_fdset.size()) {
 					return false;
 				}
 
-				size_t size = _M_fdset.size();
-				for (size_t i = 0; i < size; i++) {
-					_M_connections[i] = &_M_http_connections[i];
+				size_t count = MIN(kConnectionsPerSlab, _M_fdset.size() - _M_nconnections);
+
+				slab* slabs;
+				if ((slabs = (slab*) realloc(_M_slabs, (_M_nslabs + 1) * sizeof(slab))) == NULL) {
+					return false;
 				}
 
+				_M_slabs = slabs;
+
+				connection* connections;
+				if ((connections = new (std::nothrow) connection[count]) == NULL) {
+					return false;
+				}
+
+				_M_slabs[_M_nslabs].connections = connections;
+				_M_slabs[_M_nslabs].count = count;
+
+				for (size_t i = count; i > 0; i--) {
+					connections[i - 1]._M_server = this;
+					connections[i - 1]._M_slab = _M_nslabs;
+					release_connection(&connections[i - 1]);
+				}
+
+				_M_nslabs++;
+
+				_M_nconnections += count;
+
 				return true;
 			}
+
+			inline void server::trim_connections()
+			{
+				// Count the free connections of each slab.
+				for (size_t i = 0; i < _M_nslabs; i++) {
+					_M_slabs[i].nfree = 0;
+				}
+
+				for (tcp_connection* conn = _M_free_connections; conn; conn = conn->_M_next) {
+					_M_slabs[static_cast<connection*>(conn)->_M_slab].nfree++;
+				}
+
+				// Release the slabs whose connections are all free, keeping
+				// at least kMaxFreeConnections free connections.
+				size_t nfree = _M_nfree_connections;
+				size_t nslabs = 0;
+
+				for (size_t i = 0; i < _M_nslabs; i++) {
+					slab* s = &_M_slabs[i];
+					if ((s->nfree == s->count) && (nfree - s->count >= kMaxFreeConnections)) {
+						nfree -= s->count;
+
+						// Mark the slab.
+						s->nfree = 0;
+						s->count = 0;
+
+						nslabs++;
+					}
+				}
+
+				if (nslabs == 0) {
+					return;
+				}
+
+				// Unlink the free connections of the released slabs.
+				tcp_connection** prev = &_M_free_connections;
+				while (*prev) {
+					if (_M_slabs[static_cast<connection*>(*prev)->_M_slab].count == 0) {
+						*prev = (*prev)->_M_next;
+					} else {
+						prev = &(*prev)->_M_next;
+					}
+				}
+
+				// Delete the released slabs and compact the rest.
+				size_t n = 0;
+				for (size_t i = 0; i < _M_nslabs; i++) {
+					if (_M_slabs[i].count == 0) {
+						delete [] _M_slabs[i].connections;
+					} else {
+						if (n != i) {
+							_M_slabs[n] = _M_slabs[i];
+
+							for (size_t j = 0; j < _M_slabs[n].count; j++) {
+								_M_slabs[n].connections[j]._M_slab = n;
+							}
+						}
+
+						n++;
+					}
+				}
+
+				_M_nslabs = n;
+
+				_M_nconnections -= (_M_nfree_connections - nfree);
+				_M_nfree_connections = nfree;
+			}
 		}
 	}
 }
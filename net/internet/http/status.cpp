@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include "net/internet/http/status.h"
+#include "net/internet/http/server.h"
+#include "macros/macros.h"
+
+const char* net::internet::http::status::_M_state_names[] = {
+	"handshaking",
+	"reading_request_line",
+	"after_request_line",
+	"reading_headers",
+	"processing_request",
+	"preparing_error_page",
+	"sending_two_buffers",
+	"sending_headers",
+	"sending_body",
+	"sending_parts",
+	"request_completed",
+	"sending_queued_responses",
+	"http2"
+};
+
+bool net::internet::http::status::build_text(const server& srv, string::buffer& buf)
+{
+	const loop_stats& stats = srv.stats();
+
+	if (!buf.format("Event loop\n"
+	                "  Iterations: %llu\n"
+	                "  Process time: %llu us (max: %llu us)\n"
+	                "  on_readable(): %llu calls, %llu us (max: %llu us)\n"
+	                "  on_writable(): %llu calls, %llu us (max: %llu us)\n"
+	                "  Expired timers: %llu (active: %llu)\n"
+	                "\n"
+	                "Events per wait\n",
+	                stats.iterations,
+	                stats.process_time / 1000, stats.max_process_time / 1000,
+	                stats.readable_calls, stats.readable_time / 1000, stats.max_readable_time / 1000,
+	                stats.writable_calls, stats.writable_time / 1000, stats.max_writable_time / 1000,
+	                srv.expired(), (unsigned long long) srv.count())) {
+		return false;
+	}
+
+	for (unsigned i = 0; i < loop_stats::kEventBuckets; i++) {
+		unsigned min = loop_stats::bucket_min(i);
+
+		bool ret;
+		if (i == loop_stats::kEventBuckets - 1) {
+			ret = buf.format("  >= %u: %llu\n", min, stats.events[i]);
+		} else if (min <= 1) {
+			ret = buf.format("  %u: %llu\n", min, stats.events[i]);
+		} else {
+			ret = buf.format("  %u-%u: %llu\n", min, (min * 2) - 1, stats.events[i]);
+		}
+
+		if (!ret) {
+			return false;
+		}
+	}
+
+	if (!buf.format("\n"
+	                "Accept\n"
+	                "  Wakeups: %llu\n"
+	                "  Accepted connections: %llu\n"
+	                "  Max. accepted per wakeup: %u\n"
+	                "\n"
+	                "Requests\n"
+	                "  Completed: %llu\n"
+	                "  Reads: %llu\n"
+	                "  Max. reads per request: %u\n"
+	                "\n"
+	                "TLS\n"
+	                "  Kernel TLS connections: %llu\n"
+	                "\n"
+	                "Memory cache\n"
+	                "  Hits: %llu\n"
+	                "  Misses: %llu\n"
+	                "  Size: %llu bytes\n"
+	                "\n"
+	                "Free buffers\n",
+	                srv.accept_wakeups(),
+	                srv.accepted_connections(),
+	                srv.max_accepted_per_wakeup(),
+	                srv.completed_requests(),
+	                srv.request_reads(),
+	                srv.max_reads_per_request(),
+	                srv.ktls_connections(),
+	                srv.open_files().memory_hits(),
+	                srv.open_files().memory_misses(),
+	                (unsigned long long) srv.open_files().memory_used())) {
+		return false;
+	}
+
+	const string::buffer_pool& pool = srv.buffer_pool();
+	for (unsigned i = 0; i < string::buffer_pool::kNumberClasses; i++) {
+		if (!buf.format("  %llu bytes: %llu\n", (unsigned long long) string::buffer_pool::kClassSizes[i], (unsigned long long) pool.count(i))) {
+			return false;
+		}
+	}
+
+	if (!buf.format("\n"
+	                "Connections\n"
+	                "  Allocated: %llu\n",
+	                (unsigned long long) srv.allocated_connections())) {
+		return false;
+	}
+
+	size_t states[ARRAY_SIZE(_M_state_names)];
+	srv.connection_states(states, ARRAY_SIZE(_M_state_names));
+
+	for (unsigned i = 0; i < ARRAY_SIZE(_M_state_names); i++) {
+		if (!buf.format("  %s: %llu\n", _M_state_names[i], (unsigned long long) states[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool net::internet::http::status::build_json(const server& srv, string::buffer& buf)
+{
+	const loop_stats& stats = srv.stats();
+
+	if (!buf.format("{\"loop\":{"
+	                "\"iterations\":%llu,"
+	                "\"process_time_us\":%llu,"
+	                "\"max_process_time_us\":%llu,"
+	                "\"readable_calls\":%llu,"
+	                "\"readable_time_us\":%llu,"
+	                "\"max_readable_time_us\":%llu,"
+	                "\"writable_calls\":%llu,"
+	                "\"writable_time_us\":%llu,"
+	                "\"max_writable_time_us\":%llu,"
+	                "\"expired_timers\":%llu,"
+	                "\"active_timers\":%llu,"
+	                "\"events_per_wait\":[",
+	                stats.iterations,
+	                stats.process_time / 1000, stats.max_process_time / 1000,
+	                stats.readable_calls, stats.readable_time / 1000, stats.max_readable_time / 1000,
+	                stats.writable_calls, stats.writable_time / 1000, stats.max_writable_time / 1000,
+	                srv.expired(), (unsigned long long) srv.count())) {
+		return false;
+	}
+
+	for (unsigned i = 0; i < loop_stats::kEventBuckets; i++) {
+		if (!buf.format("%s{\"min\":%u,\"count\":%llu}", (i > 0) ? "," : "", loop_stats::bucket_min(i), stats.events[i])) {
+			return false;
+		}
+	}
+
+	if (!buf.format("]},"
+	                "\"accept\":{"
+	                "\"wakeups\":%llu,"
+	                "\"accepted\":%llu,"
+	                "\"max_accepted_per_wakeup\":%u"
+	                "},"
+	                "\"requests\":{"
+	                "\"completed\":%llu,"
+	                "\"reads\":%llu,"
+	                "\"max_reads_per_request\":%u"
+	                "},"
+	                "\"tls\":{"
+	                "\"ktls_connections\":%llu"
+	                "},"
+	                "\"memory_cache\":{"
+	                "\"hits\":%llu,"
+	                "\"misses\":%llu,"
+	                "\"size\":%llu"
+	                "},"
+	                "\"free_buffers\":[",
+	                srv.accept_wakeups(),
+	                srv.accepted_connections(),
+	                srv.max_accepted_per_wakeup(),
+	                srv.completed_requests(),
+	                srv.request_reads(),
+	                srv.max_reads_per_request(),
+	                srv.ktls_connections(),
+	                srv.open_files().memory_hits(),
+	                srv.open_files().memory_misses(),
+	                (unsigned long long) srv.open_files().memory_used())) {
+		return false;
+	}
+
+	const string::buffer_pool& pool = srv.buffer_pool();
+	for (unsigned i = 0; i < string::buffer_pool::kNumberClasses; i++) {
+		if (!buf.format("%s{\"size\":%llu,\"count\":%llu}", (i > 0) ? "," : "", (unsigned long long) string::buffer_pool::kClassSizes[i], (unsigned long long) pool.count(i))) {
+			return false;
+		}
+	}
+
+	if (!buf.format("],"
+	                "\"connections\":{"
+	                "\"allocated\":%llu,"
+	                "\"states\":{",
+	                (unsigned long long) srv.allocated_connections())) {
+		return false;
+	}
+
+	size_t states[ARRAY_SIZE(_M_state_names)];
+	srv.connection_states(states, ARRAY_SIZE(_M_state_names));
+
+	for (unsigned i = 0; i < ARRAY_SIZE(_M_state_names); i++) {
+		if (!buf.format("%s\"%s\":%llu", (i > 0) ? "," : "", _M_state_names[i], (unsigned long long) states[i])) {
+			return false;
+		}
+	}
+
+	return buf.append("}}}\n", 4);
+}
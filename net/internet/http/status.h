@@ -0,0 +1,43 @@
+#ifndef HTTP_STATUS_H
+#define HTTP_STATUS_H
+
+#include "string/buffer.h"
+
+namespace net {
+	namespace internet {
+		namespace http {
+			class server;
+
+			// Server status page (event loop statistics of the worker which
+			// serves the request).
+			class status {
+				public:
+					enum format {
+						FORMAT_TEXT,
+						FORMAT_JSON
+					};
+
+					// Build page.
+					static bool build(const server& srv, format fmt, string::buffer& buf);
+
+				private:
+					static const char* _M_state_names[];
+
+					// Build page in text format.
+					static bool build_text(const server& srv, string::buffer& buf);
+
+					// Build page in JSON format.
+					static bool build_json(const server& srv, string::buffer& buf);
+			};
+
+			inline bool status::build(const server& srv, format fmt, string::buffer& buf)
+			{
+				buf.clear();
+
+				return (fmt == FORMAT_JSON) ? build_json(srv, buf) : build_text(srv, buf);
+			}
+		}
+	}
+}
+
+#endif // HTTP_STATUS_H
@@ -2,6 +2,7 @@
 #define VHOST_H
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <new>
 #include "net/internet/http/dirlisting.h"
 #include "string/buffer.h"
@@ -53,6 +54,41 @@ namespace net {
 					// Set directory listing.
 					bool set_directory_listing();
 
+					// Get keep-alive timeout [seconds].
+					unsigned keep_alive_timeout() const;
+
+					// Get maximum number of requests per connection (0: unlimited).
+					unsigned keep_alive_max_requests() const;
+
+					// Set keep-alive policy.
+					bool keep_alive(unsigned timeout, unsigned max_requests);
+
+					// Get precomputed "Connection: Keep-Alive\r\nKeep-Alive: timeout=N"
+					// (without the trailing CRLF).
+					const char* keep_alive_header(unsigned short& len) const;
+
+					// Get the virtual host this one is an alias of (itself if
+					// it's not an alias).
+					const vhost* parent() const;
+
+					// Are small files served from memory?
+					bool memory_cache() const;
+
+					// Set whether small files are served from memory.
+					bool memory_cache(bool enabled);
+
+					// Are precompressed files (".br", ".zst", ".gz") served?
+					bool precompressed() const;
+
+					// Set whether precompressed files are served.
+					bool precompressed(bool enabled);
+
+					// Are the responses compressed on the fly?
+					bool compression() const;
+
+					// Set whether the responses are compressed on the fly.
+					bool compression(bool enabled);
+
 				private:
 					static const size_t INDEX_ALLOC = 4;
 
@@ -84,6 +120,16 @@ namespace net {
 
 					dirlisting* _M_dirlisting;
 
+					unsigned _M_keep_alive_timeout;
+					unsigned _M_keep_alive_max_requests;
+
+					char _M_keep_alive_header[64];
+					unsigned short _M_keep_alive_header_len;
+
+					bool _M_memory_cache;
+					bool _M_precompressed;
+					bool _M_compression;
+
 					vhost* _M_parent;
 			};
 
@@ -99,6 +145,15 @@ namespace net {
 
 				_M_dirlisting = NULL;
 
+				_M_keep_alive_timeout = 0;
+				_M_keep_alive_max_requests = 0;
+
+				_M_keep_alive_header_len = 0;
+
+				_M_memory_cache = true;
+				_M_precompressed = false;
+				_M_compression = false;
+
 				_M_parent = parent ? parent : this;
 			}
 
@@ -210,6 +265,89 @@ namespace net {
 
 				return _M_dirlisting->root_directory(_M_buf.data() + _M_root, _M_rootlen);
 			}
+
+			inline unsigned vhost::keep_alive_timeout() const
+			{
+				return _M_parent->_M_keep_alive_timeout;
+			}
+
+			inline unsigned vhost::keep_alive_max_requests() const
+			{
+				return _M_parent->_M_keep_alive_max_requests;
+			}
+
+			inline bool vhost::keep_alive(unsigned timeout, unsigned max_requests)
+			{
+				if (_M_parent != this) {
+					return false;
+				}
+
+				_M_keep_alive_timeout = timeout;
+				_M_keep_alive_max_requests = max_requests;
+
+				_M_keep_alive_header_len = snprintf(_M_keep_alive_header, sizeof(_M_keep_alive_header), "Connection: Keep-Alive\r\nKeep-Alive: timeout=%u", timeout);
+
+				return true;
+			}
+
+			inline const char* vhost::keep_alive_header(unsigned short& len) const
+			{
+				len = _M_parent->_M_keep_alive_header_len;
+				return _M_parent->_M_keep_alive_header;
+			}
+
+			inline const vhost* vhost::parent() const
+			{
+				return _M_parent;
+			}
+
+			inline bool vhost::memory_cache() const
+			{
+				return _M_parent->_M_memory_cache;
+			}
+
+			inline bool vhost::memory_cache(bool enabled)
+			{
+				if (_M_parent != this) {
+					return false;
+				}
+
+				_M_memory_cache = enabled;
+
+				return true;
+			}
+
+			inline bool vhost::precompressed() const
+			{
+				return _M_parent->_M_precompressed;
+			}
+
+			inline bool vhost::precompressed(bool enabled)
+			{
+				if (_M_parent != this) {
+					return false;
+				}
+
+				_M_precompressed = enabled;
+
+				return true;
+			}
+
+			inline bool vhost::compression() const
+			{
+				return _M_parent->_M_compression;
+			}
+
+			inline bool vhost::compression(bool enabled)
+			{
+				if (_M_parent != this) {
+					return false;
+				}
+
+				_M_compression = enabled;
+
+				return true;
+			}
 		}
 	}
 }
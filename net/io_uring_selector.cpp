@@ -0,0 +1,1119 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "net/io_uring_selector.h"
+#include "net/listener.h"
+
+const unsigned net::iselector::READ = POLLIN;
+const unsigned net::iselector::WRITE = POLLOUT;
+const unsigned net::iselector::EXCLUSIVE = 0;
+
+net::selector::selector()
+{
+	_M_fd = -1;
+
+	memset(&_M_sq, 0, sizeof(struct sq));
+	memset(&_M_cq, 0, sizeof(struct cq));
+
+	_M_sq_entries = 0;
+
+	_M_pending = 0;
+
+	_M_descriptors = NULL;
+	_M_ndescriptors = 0;
+
+	_M_completion = false;
+
+	_M_buf_ring = NULL;
+	_M_buf_ring_tail = 0;
+	_M_recv_buffers = NULL;
+
+	_M_waiting_head = -1;
+	_M_waiting_tail = -1;
+
+	_M_free_sends = NULL;
+	_M_nfree_sends = 0;
+
+	_M_orphans_head = NULL;
+	_M_orphans_tail = NULL;
+}
+
+net::selector::~selector()
+{
+	if (_M_sq.sqes) {
+		munmap(_M_sq.sqes, _M_sq.sqes_size);
+	}
+
+	if ((_M_cq.ring) && (_M_cq.ring != _M_sq.ring)) {
+		munmap(_M_cq.ring, _M_cq.ring_size);
+	}
+
+	if (_M_sq.ring) {
+		munmap(_M_sq.ring, _M_sq.ring_size);
+	}
+
+	// The requests in progress are cancelled when the ring is closed.
+	if (_M_fd != -1) {
+		close(_M_fd);
+	}
+
+	if (_M_buf_ring) {
+		munmap(_M_buf_ring, RECV_BUFFERS * sizeof(struct io_uring_buf));
+	}
+
+	if (_M_recv_buffers) {
+		munmap(_M_recv_buffers, RECV_BUFFERS * RECV_BUFFER_SIZE);
+	}
+
+	if (_M_descriptors) {
+		for (size_t i = 0; i < _M_ndescriptors; i++) {
+			if (_M_descriptors[i].send) {
+				destroy_send(_M_descriptors[i].send);
+			}
+		}
+
+		free(_M_descriptors);
+	}
+
+	while (_M_free_sends) {
+		send_request* next = _M_free_sends->next;
+		destroy_send(_M_free_sends);
+		_M_free_sends = next;
+	}
+
+	while (_M_orphans_head) {
+		send_request* next = _M_orphans_head->next;
+
+		if (_M_orphans_head->close_fd) {
+			close(_M_orphans_head->fd);
+		}
+
+		destroy_send(_M_orphans_head);
+		_M_orphans_head = next;
+	}
+}
+
+bool net::selector::create()
+{
+	if (!_M_fdset.create()) {
+		return false;
+	}
+
+	if (!grow()) {
+		return false;
+	}
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(struct io_uring_params));
+
+	if ((_M_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params)) < 0) {
+		return false;
+	}
+
+	// Multishot polls need the extended wait argument (timeout) and a
+	// completion queue which doesn't drop events.
+	if (((params.features & IORING_FEAT_EXT_ARG) == 0) || ((params.features & IORING_FEAT_NODROP) == 0)) {
+		return false;
+	}
+
+	_M_sq_entries = params.sq_entries;
+
+	_M_sq.ring_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+	_M_cq.ring_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (_M_cq.ring_size > _M_sq.ring_size) {
+			_M_sq.ring_size = _M_cq.ring_size;
+		}
+
+		_M_cq.ring_size = _M_sq.ring_size;
+	}
+
+	if ((_M_sq.ring = mmap(NULL, _M_sq.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _M_fd, IORING_OFF_SQ_RING)) == MAP_FAILED) {
+		_M_sq.ring = NULL;
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		_M_cq.ring = _M_sq.ring;
+	} else {
+		if ((_M_cq.ring = mmap(NULL, _M_cq.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _M_fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+			_M_cq.ring = NULL;
+			return false;
+		}
+	}
+
+	_M_sq.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	void* sqes;
+	if ((sqes = mmap(NULL, _M_sq.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _M_fd, IORING_OFF_SQES)) == MAP_FAILED) {
+		return false;
+	}
+
+	_M_sq.sqes = (struct io_uring_sqe*) sqes;
+
+	char* sq = (char*) _M_sq.ring;
+	_M_sq.head = (unsigned*) (sq + params.sq_off.head);
+	_M_sq.tail = (unsigned*) (sq + params.sq_off.tail);
+	_M_sq.ring_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+	_M_sq.array = (unsigned*) (sq + params.sq_off.array);
+
+	_M_sq.local_tail = *_M_sq.tail;
+
+	char* cq = (char*) _M_cq.ring;
+	_M_cq.head = (unsigned*) (cq + params.cq_off.head);
+	_M_cq.tail = (unsigned*) (cq + params.cq_off.tail);
+	_M_cq.ring_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+	_M_cq.cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+	// Without provided buffer rings (Linux < 5.19), the readiness of all
+	// the descriptors is polled.
+	_M_completion = create_buffers();
+
+	return true;
+}
+
+bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
+{
+	if (!_M_fdset.add(fd, type, handler)) {
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
+	}
+
+	if ((_M_fdset.capacity() > _M_ndescriptors) && (!grow())) {
+		_M_fdset.remove(fd);
+		return false;
+	}
+
+	descriptor* d = &_M_descriptors[fd];
+
+	d->generation++;
+
+	d->flags = 0;
+	d->buffer = -1;
+	d->error = 0;
+	d->send = NULL;
+
+	bool ret;
+	if ((_M_completion) && (events & COMPLETION) && (type != fdset::FD_NOTIFIER)) {
+		d->flags = COMPLETION_IO;
+
+		ret = (type == fdset::FD_LISTENER) ? accept(fd) : receive(fd);
+	} else {
+		ret = arm(fd, type);
+	}
+
+	if (!ret) {
+		_M_fdset.remove(fd);
+		return false;
+	}
+
+	return true;
+}
+
+bool net::selector::grow()
+{
+	descriptor* descriptors;
+	if ((descriptors = (descriptor*) realloc(_M_descriptors, _M_fdset.capacity() * sizeof(descriptor))) == NULL) {
+		return false;
+	}
+
+	// The generations of the new descriptors start at 0.
+	memset(descriptors + _M_ndescriptors, 0, (_M_fdset.capacity() - _M_ndescriptors) * sizeof(descriptor));
+
+	_M_descriptors = descriptors;
+	_M_ndescriptors = _M_fdset.capacity();
+
+	return true;
+}
+
+bool net::selector::remove(unsigned fd)
+{
+	fdset::fdtype type = _M_fdset.type(fd);
+
+	if (!_M_fdset.remove(fd)) {
+		// The file descriptor has not been inserted.
+		return true;
+	}
+
+	descriptor* d = &_M_descriptors[fd];
+
+	// Requests to be cancelled.
+	uint64_t requests[2];
+	unsigned count = 0;
+
+	if ((d->flags & COMPLETION_IO) == 0) {
+		requests[count++] = user_data(OP_POLL, fd);
+	} else if (type == fdset::FD_LISTENER) {
+		requests[count++] = user_data(OP_ACCEPT, fd);
+	} else if (d->flags & RECEIVING) {
+		requests[count++] = user_data(OP_RECV, fd);
+	}
+
+	// A file send in progress resolves the descriptor when the splice runs:
+	// the descriptor is closed when the send completes.
+	bool close_fd = ((d->send == NULL) || (!d->send->spliced));
+
+	// The kernel keeps a reference to the socket while there are requests
+	// in progress: cancel them and close the descriptor afterwards, in the
+	// same submission (a send in progress is not cancelled, so the data
+	// taken is still sent).
+	if (reserve(count + 1)) {
+		for (unsigned i = 0; i < count; i++) {
+			struct io_uring_sqe* sqe = get_sqe();
+
+			sqe->opcode = ((requests[i] >> OPERATION_SHIFT) == OP_POLL) ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = requests[i];
+			sqe->flags = close_fd ? IOSQE_IO_HARDLINK : 0;
+			sqe->user_data = (uint64_t) OP_IGNORE << OPERATION_SHIFT;
+		}
+
+		if (close_fd) {
+			struct io_uring_sqe* sqe = get_sqe();
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->fd = fd;
+			sqe->user_data = (uint64_t) OP_IGNORE << OPERATION_SHIFT;
+		}
+	} else if (close_fd) {
+		// The socket is released when the requests complete.
+		close(fd);
+	}
+
+	// Return the received data not read.
+	if (d->buffer != -1) {
+		recycle(d->buffer);
+		d->buffer = -1;
+	}
+
+	if (d->flags & WAITING_BUFFER) {
+		unlink_waiting(fd);
+	}
+
+	// The send in progress (if any) is cancelled if it doesn't complete in
+	// time.
+	send_request* req;
+	if ((req = d->send) != NULL) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+		req->orphan = true;
+		req->close_fd = !close_fd;
+		req->lingering = true;
+		req->deadline = ts.tv_sec + SEND_TIMEOUT;
+
+		req->prev = _M_orphans_tail;
+		req->next = NULL;
+
+		if (_M_orphans_tail) {
+			_M_orphans_tail->next = req;
+		} else {
+			_M_orphans_head = req;
+		}
+
+		_M_orphans_tail = req;
+
+		d->send = NULL;
+	}
+
+	d->flags = 0;
+	d->error = 0;
+
+	// Completions of the old requests will be discarded.
+	d->generation++;
+
+	return true;
+}
+
+bool net::selector::process_events()
+{
+	int ret;
+	if ((ret = enter(1, -1)) < 0) {
+		post_events_wait(0);
+		return false;
+	}
+
+	post_events_wait(ready());
+
+	process();
+
+	if (_M_orphans_head) {
+		expire_orphans();
+	}
+
+	return true;
+}
+
+bool net::selector::process_events(unsigned timeout)
+{
+	int ret;
+	if ((ret = enter(1, timeout)) < 0) {
+		if (errno != ETIME) {
+			post_events_wait(0);
+			return false;
+		}
+
+		// Process completions which might have been posted before the timeout.
+	}
+
+	post_events_wait(ready());
+
+	process();
+
+	if (_M_orphans_head) {
+		expire_orphans();
+	}
+
+	return true;
+}
+
+ssize_t net::selector::recv(unsigned fd, void* buf, size_t count)
+{
+	descriptor* d = &_M_descriptors[fd];
+
+	if (d->buffer == -1) {
+		if (d->flags & RECEIVED_EOF) {
+			return 0;
+		}
+
+		errno = (d->error != 0) ? d->error : EAGAIN;
+		return -1;
+	}
+
+	size_t len = d->length - d->offset;
+	if (count > len) {
+		count = len;
+	}
+
+	memcpy(buf, _M_recv_buffers + ((size_t) d->buffer * RECV_BUFFER_SIZE) + d->offset, count);
+
+	// If the buffer has been read completely, return it to the kernel and
+	// receive more data.
+	if ((d->offset += count) == d->length) {
+		recycle(d->buffer);
+		d->buffer = -1;
+
+		if (!receive(fd)) {
+			d->error = ENOBUFS;
+		}
+	}
+
+	return count;
+}
+
+ssize_t net::selector::send(unsigned fd, const struct iovec* iov, unsigned iovcnt)
+{
+	descriptor* d = &_M_descriptors[fd];
+
+	if (d->send) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if (d->error != 0) {
+		errno = d->error;
+		return -1;
+	}
+
+	send_request* req;
+	if ((req = get_send()) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	// Take as much as fits in the buffer.
+	size_t len = 0;
+	for (unsigned i = 0; (i < iovcnt) && (len < SEND_BUFFER_SIZE); i++) {
+		size_t n = iov[i].iov_len;
+		if (n > SEND_BUFFER_SIZE - len) {
+			n = SEND_BUFFER_SIZE - len;
+		}
+
+		memcpy(req->data + len, iov[i].iov_base, n);
+		len += n;
+	}
+
+	req->fd = fd;
+	req->generation = d->generation;
+	req->length = len;
+	req->offset = 0;
+	req->spliced = false;
+	req->orphan = false;
+	req->close_fd = false;
+	req->lingering = false;
+
+	if ((len == 0) || (!submit(req, false))) {
+		free_send(req);
+
+		if (len == 0) {
+			return 0;
+		}
+
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	d->send = req;
+
+	return len;
+}
+
+ssize_t net::selector::sendfile(unsigned fd, int filefd, off_t offset, size_t count)
+{
+	descriptor* d = &_M_descriptors[fd];
+
+	if (d->send) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if (d->error != 0) {
+		errno = d->error;
+		return -1;
+	}
+
+	send_request* req;
+	if ((req = get_send()) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if ((req->pipe[0] == -1) && (!create_pipe(req))) {
+		int error = errno;
+		free_send(req);
+		errno = error;
+
+		return -1;
+	}
+
+	// Take as much as fits in the pipe (the pages of the file are
+	// referenced by the pipe).
+	ssize_t ret;
+	while (((ret = splice(filefd, &offset, req->pipe[1], NULL, (count < req->pipe_size) ? count : req->pipe_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) < 0) && (errno == EINTR));
+
+	if (ret <= 0) {
+		int error = errno;
+		free_send(req);
+		errno = error;
+
+		return ret;
+	}
+
+	req->fd = fd;
+	req->generation = d->generation;
+	req->length = ret;
+	req->offset = 0;
+	req->spliced = true;
+	req->orphan = false;
+	req->close_fd = false;
+	req->lingering = false;
+
+	if (!submit(req, false)) {
+		free_send(req);
+
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	d->send = req;
+
+	return ret;
+}
+
+struct io_uring_sqe* net::selector::get_sqe()
+{
+	// If the submission queue is full...
+	if (_M_sq.local_tail - __atomic_load_n(_M_sq.head, __ATOMIC_ACQUIRE) == _M_sq_entries) {
+		// Submit the pending requests without waiting.
+		if (enter(0, 0) < 0) {
+			return NULL;
+		}
+
+		if (_M_sq.local_tail - __atomic_load_n(_M_sq.head, __ATOMIC_ACQUIRE) == _M_sq_entries) {
+			return NULL;
+		}
+	}
+
+	unsigned index = _M_sq.local_tail & *_M_sq.ring_mask;
+
+	struct io_uring_sqe* sqe = &_M_sq.sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	_M_sq.array[index] = index;
+	_M_sq.local_tail++;
+
+	_M_pending++;
+
+	return sqe;
+}
+
+bool net::selector::reserve(unsigned count)
+{
+	if (_M_sq_entries - (_M_sq.local_tail - __atomic_load_n(_M_sq.head, __ATOMIC_ACQUIRE)) >= count) {
+		return true;
+	}
+
+	// Submit the pending requests without waiting.
+	if (enter(0, 0) < 0) {
+		return false;
+	}
+
+	return (_M_sq_entries - (_M_sq.local_tail - __atomic_load_n(_M_sq.head, __ATOMIC_ACQUIRE)) >= count);
+}
+
+bool net::selector::create_buffers()
+{
+	size_t ring_size = RECV_BUFFERS * sizeof(struct io_uring_buf);
+
+	void* ring;
+	if ((ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		return false;
+	}
+
+	void* buffers;
+	if ((buffers = mmap(NULL, RECV_BUFFERS * RECV_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		munmap(ring, ring_size);
+		return false;
+	}
+
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+	reg.ring_addr = (uint64_t) (uintptr_t) ring;
+	reg.ring_entries = RECV_BUFFERS;
+	reg.bgid = RECV_BUFFER_GROUP;
+
+	if (syscall(__NR_io_uring_register, _M_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		munmap(buffers, RECV_BUFFERS * RECV_BUFFER_SIZE);
+		munmap(ring, ring_size);
+
+		return false;
+	}
+
+	_M_buf_ring = (struct io_uring_buf*) ring;
+	_M_recv_buffers = (char*) buffers;
+
+	for (unsigned i = 0; i < RECV_BUFFERS; i++) {
+		recycle(i);
+	}
+
+	return true;
+}
+
+bool net::selector::arm(unsigned fd, fdset::fdtype type)
+{
+	struct io_uring_sqe* sqe;
+	if ((sqe = get_sqe()) == NULL) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->user_data = user_data(OP_POLL, fd);
+
+	if (type == fdset::FD_SOCKET) {
+		// Multishot: the request stays armed and posts a completion every
+		// time the socket becomes ready (edge-triggered, like EPOLLET).
+		sqe->poll32_events = POLLIN | POLLOUT | POLLRDHUP;
+		sqe->len = IORING_POLL_ADD_MULTI;
+	} else {
+		// Oneshot: re-armed after each completion, which is equivalent to a
+		// level-triggered poll.
+		sqe->poll32_events = POLLIN;
+	}
+
+	return true;
+}
+
+bool net::selector::accept(unsigned fd)
+{
+	struct io_uring_sqe* sqe;
+	if ((sqe = get_sqe()) == NULL) {
+		return false;
+	}
+
+	// Multishot: a completion per connection accepted (the address of the
+	// peer is not returned).
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK;
+	sqe->user_data = user_data(OP_ACCEPT, fd);
+
+	return true;
+}
+
+bool net::selector::receive(unsigned fd)
+{
+	descriptor* d = &_M_descriptors[fd];
+
+	struct io_uring_sqe* sqe;
+	if ((sqe = get_sqe()) == NULL) {
+		return false;
+	}
+
+	// The kernel picks a provided buffer when the data arrives (the
+	// connections waiting for data don't hold any buffer).
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->len = RECV_BUFFER_SIZE;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = RECV_BUFFER_GROUP;
+	sqe->user_data = user_data(OP_RECV, fd);
+
+	d->flags |= RECEIVING;
+
+	return true;
+}
+
+void net::selector::recycle(unsigned short bid)
+{
+	struct io_uring_buf* buf = &_M_buf_ring[_M_buf_ring_tail & (RECV_BUFFERS - 1)];
+
+	buf->addr = (uint64_t) (uintptr_t) (_M_recv_buffers + ((size_t) bid * RECV_BUFFER_SIZE));
+	buf->len = RECV_BUFFER_SIZE;
+	buf->bid = bid;
+
+	__atomic_store_n(&_M_buf_ring[0].resv, ++_M_buf_ring_tail, __ATOMIC_RELEASE);
+
+	// Is there a descriptor waiting for a buffer?
+	int fd;
+	if ((fd = _M_waiting_head) != -1) {
+		unlink_waiting(fd);
+
+		if (!receive(fd)) {
+			_M_descriptors[fd].error = ENOBUFS;
+		}
+	}
+}
+
+net::selector::send_request* net::selector::get_send()
+{
+	send_request* req;
+	if ((req = _M_free_sends) != NULL) {
+		_M_free_sends = req->next;
+		_M_nfree_sends--;
+
+		return req;
+	}
+
+	if ((req = (send_request*) malloc(sizeof(send_request))) == NULL) {
+		return NULL;
+	}
+
+	req->pipe[0] = -1;
+	req->pipe[1] = -1;
+	req->pipe_size = 0;
+
+	return req;
+}
+
+bool net::selector::create_pipe(send_request* req)
+{
+	if (pipe2(req->pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+		req->pipe[0] = -1;
+		req->pipe[1] = -1;
+
+		return false;
+	}
+
+	int size;
+	if ((size = fcntl(req->pipe[1], F_SETPIPE_SZ, PIPE_SIZE)) < 0) {
+		if ((size = fcntl(req->pipe[1], F_GETPIPE_SZ)) < 0) {
+			close(req->pipe[0]);
+			close(req->pipe[1]);
+
+			req->pipe[0] = -1;
+			req->pipe[1] = -1;
+
+			return false;
+		}
+	}
+
+	req->pipe_size = size;
+
+	return true;
+}
+
+bool net::selector::submit(send_request* req, bool wait)
+{
+	if (!reserve(wait ? 2 : 1)) {
+		return false;
+	}
+
+	struct io_uring_sqe* sqe;
+
+	if (wait) {
+		// Oneshot, the splice runs when it completes.
+		sqe = get_sqe();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = req->fd;
+		sqe->poll32_events = POLLOUT;
+		sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = ((uint64_t) OP_SEND_POLL << OPERATION_SHIFT) | (uint64_t) (uintptr_t) req;
+	}
+
+	sqe = get_sqe();
+
+	if (req->spliced) {
+		// The splice doesn't wait for the socket to become writable: a
+		// short splice is submitted again after a poll.
+		sqe->opcode = IORING_OP_SPLICE;
+		sqe->fd = req->fd;
+		sqe->off = (uint64_t) -1;
+		sqe->splice_fd_in = req->pipe[0];
+		sqe->splice_off_in = (uint64_t) -1;
+		sqe->len = req->length - req->offset;
+	} else {
+		// MSG_WAITALL: the kernel retries the short sends.
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = req->fd;
+		sqe->addr = (uint64_t) (uintptr_t) (req->data + req->offset);
+		sqe->len = req->length - req->offset;
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+	}
+
+	sqe->user_data = ((uint64_t) OP_SEND << OPERATION_SHIFT) | (uint64_t) (uintptr_t) req;
+
+	return true;
+}
+
+void net::selector::sent(send_request* req, int res)
+{
+	if (res > 0) {
+		req->offset += res;
+	}
+
+	// If not everything has been sent (the socket buffer was full for a
+	// splice), send the rest, unless the orphan send has been cancelled.
+	if (((res > 0) && (req->offset < req->length)) || ((res == -EAGAIN) && (req->spliced))) {
+		if ((!req->orphan) || (req->lingering)) {
+			if (submit(req, req->spliced)) {
+				return;
+			}
+
+			res = -ENOBUFS;
+		}
+	}
+
+	if (req->orphan) {
+		if (req->lingering) {
+			unlink_orphan(req);
+		}
+
+		if (req->close_fd) {
+			close(req->fd);
+		}
+
+		free_send(req);
+		return;
+	}
+
+	unsigned fd = req->fd;
+	descriptor* d = &_M_descriptors[fd];
+
+	if (res <= 0) {
+		d->error = (res < 0) ? -res : EPIPE;
+	} else if (req->offset < req->length) {
+		d->error = ENOBUFS;
+	}
+
+	d->send = NULL;
+	free_send(req);
+
+	io::event_handler* handler;
+	if ((handler = _M_fdset.handler(fd)) != NULL) {
+		if (!handler->on_writable()) {
+			// Remove from set.
+			remove(fd);
+		}
+	}
+}
+
+void net::selector::free_send(send_request* req)
+{
+	// The data left in the pipe is dropped with it.
+	if ((req->spliced) && (req->offset < req->length)) {
+		close(req->pipe[0]);
+		close(req->pipe[1]);
+
+		req->pipe[0] = -1;
+		req->pipe[1] = -1;
+	}
+
+	if (_M_nfree_sends < MAX_FREE_SEND_BUFFERS) {
+		req->next = _M_free_sends;
+		_M_free_sends = req;
+		_M_nfree_sends++;
+	} else {
+		destroy_send(req);
+	}
+}
+
+void net::selector::destroy_send(send_request* req)
+{
+	if (req->pipe[0] != -1) {
+		close(req->pipe[0]);
+		close(req->pipe[1]);
+	}
+
+	free(req);
+}
+
+void net::selector::expire_orphans()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+	while ((_M_orphans_head) && (_M_orphans_head->deadline <= ts.tv_sec)) {
+		send_request* req = _M_orphans_head;
+
+		if (!reserve(2)) {
+			return;
+		}
+
+		// The buffer is freed when the send completes (cancelling the poll
+		// a splice might be waiting for cancels the splice too).
+		struct io_uring_sqe* sqe = get_sqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = ((uint64_t) OP_SEND_POLL << OPERATION_SHIFT) | (uint64_t) (uintptr_t) req;
+		sqe->user_data = (uint64_t) OP_IGNORE << OPERATION_SHIFT;
+
+		sqe = get_sqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = ((uint64_t) OP_SEND << OPERATION_SHIFT) | (uint64_t) (uintptr_t) req;
+		sqe->user_data = (uint64_t) OP_IGNORE << OPERATION_SHIFT;
+
+		unlink_orphan(req);
+	}
+}
+
+void net::selector::unlink_orphan(send_request* req)
+{
+	if (req->prev) {
+		req->prev->next = req->next;
+	} else {
+		_M_orphans_head = req->next;
+	}
+
+	if (req->next) {
+		req->next->prev = req->prev;
+	} else {
+		_M_orphans_tail = req->prev;
+	}
+
+	req->lingering = false;
+}
+
+void net::selector::unlink_waiting(unsigned fd)
+{
+	int prev = -1;
+	for (int i = _M_waiting_head; i != (int) fd; i = _M_descriptors[i].next_waiting) {
+		prev = i;
+	}
+
+	int next = _M_descriptors[fd].next_waiting;
+
+	if (prev != -1) {
+		_M_descriptors[prev].next_waiting = next;
+	} else {
+		_M_waiting_head = next;
+	}
+
+	if (next == -1) {
+		_M_waiting_tail = prev;
+	}
+
+	_M_descriptors[fd].flags &= ~WAITING_BUFFER;
+}
+
+int net::selector::enter(unsigned min_complete, int timeout)
+{
+	// Publish the new SQEs.
+	__atomic_store_n(_M_sq.tail, _M_sq.local_tail, __ATOMIC_RELEASE);
+
+	unsigned flags = 0;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+
+	if (min_complete > 0) {
+		flags = IORING_ENTER_GETEVENTS;
+
+		if (timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000LL;
+
+			memset(&arg, 0, sizeof(struct io_uring_getevents_arg));
+			arg.ts = (uint64_t) (uintptr_t) &ts;
+
+			flags |= IORING_ENTER_EXT_ARG;
+		}
+	}
+
+	int ret;
+	do {
+		if (flags & IORING_ENTER_EXT_ARG) {
+			ret = syscall(__NR_io_uring_enter, _M_fd, _M_pending, min_complete, flags, &arg, sizeof(struct io_uring_getevents_arg));
+		} else {
+			ret = syscall(__NR_io_uring_enter, _M_fd, _M_pending, min_complete, flags, NULL, _NSIG / 8);
+		}
+
+		if (ret >= 0) {
+			_M_pending -= ret;
+			return ret;
+		}
+	} while (errno == EINTR);
+
+	return -1;
+}
+
+void net::selector::process()
+{
+	unsigned head = *_M_cq.head;
+	unsigned tail = __atomic_load_n(_M_cq.tail, __ATOMIC_ACQUIRE);
+	unsigned mask = *_M_cq.ring_mask;
+
+	while (head != tail) {
+		const struct io_uring_cqe* cqe = &_M_cq.cqes[head & mask];
+
+		uint64_t user_data = cqe->user_data;
+		int res = cqe->res;
+		unsigned flags = cqe->flags;
+
+		head++;
+
+		// Release the CQE as soon as possible (the handlers might submit).
+		__atomic_store_n(_M_cq.head, head, __ATOMIC_RELEASE);
+
+		operation op = (operation) (user_data >> OPERATION_SHIFT);
+
+		if ((op == OP_IGNORE) || (op == OP_SEND_POLL)) {
+			continue;
+		} else if (op == OP_SEND) {
+			sent((send_request*) (uintptr_t) (user_data & ((1ULL << OPERATION_SHIFT) - 1)), res);
+			continue;
+		}
+
+		unsigned fd = (unsigned) (user_data & 0xffffffff);
+		descriptor* d = &_M_descriptors[fd];
+
+		// Stale completion (the descriptor has been removed)?
+		if ((uint32_t) ((user_data >> 32) & GENERATION_MASK) != (d->generation & GENERATION_MASK)) {
+			// Return the buffer of a stale receive.
+			if (flags & IORING_CQE_F_BUFFER) {
+				recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+			}
+
+			continue;
+		}
+
+		io::event_handler* handler;
+		if ((handler = _M_fdset.handler(fd)) == NULL) {
+			continue;
+		}
+
+		switch (op) {
+			case OP_POLL:
+				// If the poll request has been terminated, arm it again.
+				if ((flags & IORING_CQE_F_MORE) == 0) {
+					if (!arm(fd, _M_fdset.type(fd))) {
+						// Remove from set.
+						remove(fd);
+						continue;
+					}
+				}
+
+				if (res < 0) {
+					continue;
+				}
+
+				if (res & (POLLIN | POLLRDHUP | POLLHUP | POLLERR)) {
+					if (!handler->on_readable()) {
+						// Remove from set.
+						remove(fd);
+						continue;
+					}
+				}
+
+				if (res & (POLLOUT | POLLERR)) {
+					if (!handler->on_writable()) {
+						// Remove from set.
+						remove(fd);
+					}
+				}
+
+				break;
+			case OP_ACCEPT:
+				// If the accept request has been terminated, arm it again.
+				if ((flags & IORING_CQE_F_MORE) == 0) {
+					if (!accept(fd)) {
+						// Remove from set.
+						remove(fd);
+
+						if (res >= 0) {
+							close(res);
+						}
+
+						continue;
+					}
+				}
+
+				if (res >= 0) {
+					static_cast<listener*>(handler)->on_accepted(res);
+				}
+
+				break;
+			case OP_RECV:
+				d->flags &= ~RECEIVING;
+
+				if (res > 0) {
+					d->buffer = flags >> IORING_CQE_BUFFER_SHIFT;
+					d->offset = 0;
+					d->length = res;
+				} else {
+					if (flags & IORING_CQE_F_BUFFER) {
+						recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+					}
+
+					if (res == 0) {
+						d->flags |= RECEIVED_EOF;
+					} else if (res == -ENOBUFS) {
+						// No buffers left: receive when one is returned.
+						d->flags |= WAITING_BUFFER;
+						d->next_waiting = -1;
+
+						if (_M_waiting_tail != -1) {
+							_M_descriptors[_M_waiting_tail].next_waiting = fd;
+						} else {
+							_M_waiting_head = fd;
+						}
+
+						_M_waiting_tail = fd;
+
+						continue;
+					} else {
+						d->error = -res;
+					}
+				}
+
+				if (!handler->on_readable()) {
+					// Remove from set.
+					remove(fd);
+				}
+
+				break;
+			default:
+				;
+		}
+	}
+}
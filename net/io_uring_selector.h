@@ -0,0 +1,330 @@
+#ifndef IO_URING_SELECTOR_H
+#define IO_URING_SELECTOR_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include "net/iselector.h"
+
+namespace net {
+	class selector : public iselector {
+		public:
+			// The I/O of the descriptor is performed by the selector
+			// (completion-based): a socket is received into buffers provided
+			// to the kernel and sent from buffers of the selector, a listener
+			// socket accepts the connections with a multishot accept.
+			static const unsigned COMPLETION = 1U << 31;
+
+			// Modify descriptor.
+			bool modify(unsigned fd, unsigned events);
+
+			// Is completion-based I/O available (Linux >= 5.19)?
+			bool completion() const;
+
+			// Read the data received for a descriptor added with COMPLETION.
+			// Like recv(): returns -1 with errno = EAGAIN if there is no data
+			// yet (on_readable() is called when it arrives).
+			ssize_t recv(unsigned fd, void* buf, size_t count);
+
+			// Get the number of bytes received and not read yet.
+			size_t available(unsigned fd) const;
+
+			// Send data of a descriptor added with COMPLETION. Like writev():
+			// returns the number of bytes taken (they are copied and sent in
+			// background) or -1 with errno = EAGAIN while a previous send is
+			// in progress (on_writable() is called when it completes).
+			ssize_t send(unsigned fd, const struct iovec* iov, unsigned iovcnt);
+
+			// Send 'count' bytes of the file 'filefd' from 'offset' to a
+			// descriptor added with COMPLETION, like send(): the file is
+			// spliced into a pipe of the selector (its pages are referenced,
+			// not copied) and the pipe is spliced to the socket in
+			// background.
+			ssize_t sendfile(unsigned fd, int filefd, off_t offset, size_t count);
+
+		protected:
+			// Constructor.
+			selector();
+
+			// Destructor.
+			virtual ~selector();
+
+			// Create.
+			virtual bool create();
+
+			// Add descriptor.
+			bool add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events);
+
+			// Remove descriptor.
+			bool remove(unsigned fd);
+
+			// Process events.
+			bool process_events();
+			bool process_events(unsigned timeout);
+
+		private:
+			static const unsigned RING_ENTRIES = 4096;
+
+			// Buffers provided to the kernel for the receives (number of
+			// buffers must be a power of 2).
+			static const unsigned RECV_BUFFERS = 256;
+			static const size_t RECV_BUFFER_SIZE = 16 * 1024;
+			static const unsigned short RECV_BUFFER_GROUP = 0;
+
+			// Maximum number of bytes taken per send.
+			static const size_t SEND_BUFFER_SIZE = 64 * 1024;
+
+			// Size of the pipes of the file sends (the default size is used
+			// if it can't be set).
+			static const size_t PIPE_SIZE = 256 * 1024;
+
+			// Maximum number of free send buffers kept.
+			static const unsigned MAX_FREE_SEND_BUFFERS = 64;
+
+			// Time the send of a removed descriptor might take before it is
+			// cancelled [seconds].
+			static const unsigned SEND_TIMEOUT = 30;
+
+			// Operation of a request (upper 8 bits of the user data; the
+			// rest is the generation and the descriptor or, for the sends,
+			// the address of the send).
+			enum operation {
+				OP_POLL,
+				OP_ACCEPT,
+				OP_RECV,
+				OP_SEND,
+
+				// Wait for the socket to become writable before splicing the
+				// rest of a file send (the completion is ignored, the
+				// splice is linked to it).
+				OP_SEND_POLL,
+
+				// Cancellations and closes (the completions are ignored).
+				OP_IGNORE
+			};
+
+			static const unsigned OPERATION_SHIFT = 56;
+			static const uint32_t GENERATION_MASK = 0xffffff;
+
+			// Flags of a descriptor.
+			static const unsigned COMPLETION_IO = 1 << 0;
+			static const unsigned RECEIVING = 1 << 1;
+			static const unsigned RECEIVED_EOF = 1 << 2;
+			static const unsigned WAITING_BUFFER = 1 << 3;
+
+			// Send in progress (its buffer is owned by the selector, so the
+			// descriptor might be removed before the send completes).
+			struct send_request {
+				unsigned fd;
+				uint32_t generation;
+
+				size_t length;
+				size_t offset;
+
+				// Is the data in the pipe (file send) or in 'data'?
+				bool spliced;
+
+				// Pipe of the file sends (-1 if not created yet, kept with
+				// the buffer) and its size.
+				int pipe[2];
+				size_t pipe_size;
+
+				// Has the descriptor been removed?
+				bool orphan;
+
+				// Close the descriptor when the send completes? (the kernel
+				// resolves the descriptor of a splice when it runs, so it
+				// can't be closed before).
+				bool close_fd;
+
+				// Orphan sends which haven't been cancelled yet.
+				bool lingering;
+				time_t deadline;
+				send_request* prev;
+				send_request* next;
+
+				char data[SEND_BUFFER_SIZE];
+			};
+
+			struct descriptor {
+				// Generation (to discard stale completions).
+				uint32_t generation;
+
+				unsigned flags;
+
+				// Received data not read yet: provided buffer (-1 if
+				// none), offset and length.
+				int buffer;
+				unsigned offset;
+				unsigned length;
+
+				// Error of the last receive or send (errno, 0 if none).
+				int error;
+
+				// Send in progress (NULL if none).
+				send_request* send;
+
+				// Next descriptor waiting for a provided buffer (-1 if
+				// none).
+				int next_waiting;
+			};
+
+			int _M_fd;
+
+			// Submission queue.
+			struct sq {
+				unsigned* head;
+				unsigned* tail;
+				unsigned* ring_mask;
+				unsigned* array;
+
+				struct io_uring_sqe* sqes;
+
+				// Local tail (SQEs prepared but not yet published).
+				unsigned local_tail;
+
+				void* ring;
+				size_t ring_size;
+				size_t sqes_size;
+			};
+
+			// Completion queue.
+			struct cq {
+				unsigned* head;
+				unsigned* tail;
+				unsigned* ring_mask;
+
+				struct io_uring_cqe* cqes;
+
+				void* ring;
+				size_t ring_size;
+			};
+
+			struct sq _M_sq;
+			struct cq _M_cq;
+
+			unsigned _M_sq_entries;
+
+			// Number of SQEs to be submitted.
+			unsigned _M_pending;
+
+			descriptor* _M_descriptors;
+			size_t _M_ndescriptors;
+
+			// Completion-based I/O available?
+			bool _M_completion;
+
+			// Ring of provided buffers and the buffers. The ring is accessed
+			// as an array of io_uring_buf (in C++ the member 'bufs' of
+			// struct io_uring_buf_ring doesn't start at offset 0), the tail
+			// overlays the field 'resv' of the first entry.
+			struct io_uring_buf* _M_buf_ring;
+			unsigned short _M_buf_ring_tail;
+			char* _M_recv_buffers;
+
+			// Descriptors waiting for a provided buffer (FIFO).
+			int _M_waiting_head;
+			int _M_waiting_tail;
+
+			// Free send buffers.
+			send_request* _M_free_sends;
+			unsigned _M_nfree_sends;
+
+			// Orphan sends (oldest first).
+			send_request* _M_orphans_head;
+			send_request* _M_orphans_tail;
+
+			// Get user data.
+			uint64_t user_data(operation op, unsigned fd) const;
+
+			// Get SQE.
+			struct io_uring_sqe* get_sqe();
+
+			// Make sure there are 'count' free SQEs.
+			bool reserve(unsigned count);
+
+			// Grow the descriptors to the capacity of the set.
+			bool grow();
+
+			// Create the provided buffers.
+			bool create_buffers();
+
+			// Arm poll.
+			bool arm(unsigned fd, fdset::fdtype type);
+
+			// Arm multishot accept.
+			bool accept(unsigned fd);
+
+			// Arm receive.
+			bool receive(unsigned fd);
+
+			// Return provided buffer to the kernel.
+			void recycle(unsigned short bid);
+
+			// Get a send buffer.
+			send_request* get_send();
+
+			// Create the pipe of a send.
+			bool create_pipe(send_request* req);
+
+			// Submit (the rest of) a send (after waiting for the socket to
+			// become writable if 'wait').
+			bool submit(send_request* req, bool wait);
+
+			// Send completed.
+			void sent(send_request* req, int res);
+
+			// Free send.
+			void free_send(send_request* req);
+
+			// Destroy send (closes its pipe).
+			static void destroy_send(send_request* req);
+
+			// Cancel the orphan sends which have timed out.
+			void expire_orphans();
+
+			// Remove from the list of orphan sends.
+			void unlink_orphan(send_request* req);
+
+			// Remove from the list of descriptors waiting for a buffer.
+			void unlink_waiting(unsigned fd);
+
+			// Submit and wait.
+			int enter(unsigned min_complete, int timeout);
+
+			// Get number of completions ready.
+			unsigned ready() const;
+
+			// Process completions.
+			void process();
+	};
+
+	inline bool selector::modify(unsigned fd, unsigned events)
+	{
+		return true;
+	}
+
+	inline bool selector::completion() const
+	{
+		return _M_completion;
+	}
+
+	inline size_t selector::available(unsigned fd) const
+	{
+		const descriptor* d = &_M_descriptors[fd];
+		return (d->buffer != -1) ? d->length - d->offset : 0;
+	}
+
+	inline uint64_t selector::user_data(operation op, unsigned fd) const
+	{
+		return ((uint64_t) op << OPERATION_SHIFT) | ((uint64_t) (_M_descriptors[fd].generation & GENERATION_MASK) << 32) | fd;
+	}
+
+	inline unsigned selector::ready() const
+	{
+		return __atomic_load_n(_M_cq.tail, __ATOMIC_ACQUIRE) - *_M_cq.head;
+	}
+}
+
+#endif // IO_URING_SELECTOR_H
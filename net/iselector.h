@@ -9,6 +9,10 @@ namespace net {
 			static const unsigned READ;
 			static const unsigned WRITE;
 
+			// Wake up a single event loop when several of them wait on the
+			// same listener (0 if not supported by the selector).
+			static const unsigned EXCLUSIVE;
+
 		protected:
 			fdset _M_fdset;
 
@@ -28,8 +32,8 @@ namespace net {
 			virtual bool process_events() = 0;
 			virtual bool process_events(unsigned timeout) = 0;
 
-			// Post-events-wait.
-			virtual void post_events_wait() = 0;
+			// Post-events-wait (number of events returned by the wait).
+			virtual void post_events_wait(unsigned nevents) = 0;
 	};
 }
 
@@ -4,6 +4,7 @@
 
 const unsigned net::iselector::READ = 1;
 const unsigned net::iselector::WRITE = 2;
+const unsigned net::iselector::EXCLUSIVE = 0;
 
 net::selector::selector()
 {
@@ -33,7 +34,7 @@ bool net::selector::create()
 		return false;
 	}
 
-	if ((_M_events = (struct kevent*) malloc(_M_fdset.size() * sizeof(struct kevent))) == NULL) {
+	if ((_M_events = (struct kevent*) malloc(MAX_EVENTS * sizeof(struct kevent))) == NULL) {
 		return false;
 	}
 
@@ -43,8 +44,9 @@ bool net::selector::create()
 bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
 {
 	if (!_M_fdset.add(fd, type, handler)) {
-		// The file descriptor has been already inserted.
-		return true;
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
 	}
 
 	struct kevent ev[2];
@@ -87,12 +89,12 @@ bool net::selector::remove(unsigned fd)
 bool net::selector::process_events()
 {
 	int ret;
-	if ((ret = kevent(_M_fd, NULL, 0, _M_events, _M_fdset.size(), NULL)) <= 0) {
-		post_events_wait();
+	if ((ret = kevent(_M_fd, NULL, 0, _M_events, MAX_EVENTS, NULL)) <= 0) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
@@ -106,12 +108,12 @@ bool net::selector::process_events(unsigned timeout)
 	ts.tv_nsec = (timeout % 1000) * 1000000;
 
 	int ret;
-	if ((ret = kevent(_M_fd, NULL, 0, _M_events, _M_fdset.size(), &ts)) <= 0) {
-		post_events_wait();
+	if ((ret = kevent(_M_fd, NULL, 0, _M_events, MAX_EVENTS, &ts)) <= 0) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
@@ -32,6 +32,9 @@ namespace net {
 			bool process_events(unsigned timeout);
 
 		private:
+			// Maximum number of events returned by a wait.
+			static const unsigned MAX_EVENTS = 512;
+
 			int _M_fd;
 
 			struct kevent* _M_events;
@@ -1,19 +1,57 @@
 #include <stdlib.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include "net/listener.h"
 #include "net/tcp_server.h"
 
-net::tcp_server* net::listener::_M_server = NULL;
-
 bool net::listener::on_readable()
 {
-	socket s;
-	socket_address addr;
-	if (accept(s, addr, 0)) {
+	// Drain the accept queue (up to the configured number of connections
+	// per wakeup, so the other descriptors are not starved).
+	unsigned max = _M_server->accept_batch();
+	unsigned count = 0;
+
+	for (unsigned i = 0; i < max; i++) {
+		socket s;
+		socket_address addr;
+		if (!accept(s, addr, 0)) {
+			// If the connection has been aborted by the peer, try with the
+			// next one.
+			if (errno == ECONNABORTED) {
+				continue;
+			}
+
+			// EAGAIN: no more pending connections.
+			break;
+		}
+
+		count++;
+
 		if (!_M_server->on_new_connection(s, addr, this)) {
 			s.close();
 		}
 	}
 
+	_M_server->accepted(count);
+
 	return true;
 }
+
+#if HAVE_IO_URING
+	bool net::listener::on_accepted(int fd)
+	{
+		socket s(fd);
+
+		// The selector doesn't return the address of the peer.
+		socket_address addr;
+		socklen_t addrlen = sizeof(socket_address);
+		if ((getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &addrlen) < 0) || (!_M_server->on_new_connection(s, addr, this))) {
+			s.close();
+			return true;
+		}
+
+		_M_server->accepted(1);
+
+		return true;
+	}
+#endif // HAVE_IO_URING
@@ -18,7 +18,7 @@ namespace net {
 		socket_address _M_addr;
 		void* _M_data;
 
-		static tcp_server* _M_server;
+		tcp_server* _M_server;
 
 		// Destructor.
 		virtual ~listener();
@@ -32,6 +32,14 @@ namespace net {
 		// On writable.
 		bool on_writable();
 
+#if HAVE_IO_URING
+		// On connection accepted by the selector (multishot accept).
+		bool on_accepted(int fd);
+#endif // HAVE_IO_URING
+
+		// Get socket descriptor.
+		int fd() const;
+
 		// Set socket descriptor.
 		void fd(int descriptor);
 
@@ -59,6 +67,11 @@ namespace net {
 		return true;
 	}
 
+	inline int listener::fd() const
+	{
+		return socket::fd();
+	}
+
 	inline void listener::fd(int descriptor)
 	{
 		socket::fd(descriptor);
@@ -0,0 +1,136 @@
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+namespace net {
+	// Event loop statistics.
+	struct loop_stats {
+		// Number of buckets of the histogram of events per wait:
+		// 0, 1, 2-3, 4-7, ..., >= 1024.
+		static const unsigned kEventBuckets = 12;
+
+		// Number of loop iterations.
+		unsigned long long iterations;
+
+		// Histogram of events per wait.
+		unsigned long long events[kEventBuckets];
+
+		// Time spent processing the events [nanoseconds].
+		unsigned long long process_time;
+		unsigned long long max_process_time;
+
+		// Calls to on_readable() and time spent in them [nanoseconds].
+		unsigned long long readable_calls;
+		unsigned long long readable_time;
+		unsigned long long max_readable_time;
+
+		// Calls to on_writable() and time spent in them [nanoseconds].
+		unsigned long long writable_calls;
+		unsigned long long writable_time;
+		unsigned long long max_writable_time;
+
+		// Constructor.
+		loop_stats();
+
+		// Add wait.
+		void add_wait(unsigned nevents);
+
+		// Add processing time.
+		void add_process_time(uint64_t t);
+
+		// Add on_readable() call.
+		void add_readable(uint64_t t);
+
+		// Add on_writable() call.
+		void add_writable(uint64_t t);
+
+		// Get lower bound of a bucket of the events histogram.
+		static unsigned bucket_min(unsigned bucket);
+
+		// Get monotonic time [nanoseconds].
+		static uint64_t now();
+	};
+
+	inline loop_stats::loop_stats()
+	{
+		iterations = 0;
+
+		for (unsigned i = 0; i < kEventBuckets; i++) {
+			events[i] = 0;
+		}
+
+		process_time = 0;
+		max_process_time = 0;
+
+		readable_calls = 0;
+		readable_time = 0;
+		max_readable_time = 0;
+
+		writable_calls = 0;
+		writable_time = 0;
+		max_writable_time = 0;
+	}
+
+	inline void loop_stats::add_wait(unsigned nevents)
+	{
+		iterations++;
+
+		unsigned bucket;
+		if (nevents == 0) {
+			bucket = 0;
+		} else {
+			bucket = 32 - __builtin_clz(nevents);
+			if (bucket >= kEventBuckets) {
+				bucket = kEventBuckets - 1;
+			}
+		}
+
+		events[bucket]++;
+	}
+
+	inline void loop_stats::add_process_time(uint64_t t)
+	{
+		process_time += t;
+
+		if (t > max_process_time) {
+			max_process_time = t;
+		}
+	}
+
+	inline void loop_stats::add_readable(uint64_t t)
+	{
+		readable_calls++;
+		readable_time += t;
+
+		if (t > max_readable_time) {
+			max_readable_time = t;
+		}
+	}
+
+	inline void loop_stats::add_writable(uint64_t t)
+	{
+		writable_calls++;
+		writable_time += t;
+
+		if (t > max_writable_time) {
+			max_writable_time = t;
+		}
+	}
+
+	inline unsigned loop_stats::bucket_min(unsigned bucket)
+	{
+		return (bucket == 0) ? 0 : (1 << (bucket - 1));
+	}
+
+	inline uint64_t loop_stats::now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+	}
+}
+
+#endif // LOOP_STATS_H
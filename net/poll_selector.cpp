@@ -4,10 +4,12 @@
 
 const unsigned net::iselector::READ = POLLIN;
 const unsigned net::iselector::WRITE = POLLOUT;
+const unsigned net::iselector::EXCLUSIVE = 0;
 
 net::selector::selector()
 {
 	_M_events = NULL;
+	_M_capacity = 0;
 }
 
 net::selector::~selector()
@@ -23,18 +25,20 @@ bool net::selector::create()
 		return false;
 	}
 
-	if ((_M_events = (struct pollfd*) malloc(_M_fdset.size() * sizeof(struct pollfd))) == NULL) {
-		return false;
-	}
-
-	return true;
+	return grow();
 }
 
 bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
 {
 	if (!_M_fdset.add(fd, type, handler)) {
-		// The file descriptor has been already inserted.
-		return true;
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
+	}
+
+	if ((_M_fdset.capacity() > _M_capacity) && (!grow())) {
+		_M_fdset.remove(fd);
+		return false;
 	}
 
 	size_t index = _M_fdset.count() - 1;
@@ -46,6 +50,19 @@ bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* hand
 	return true;
 }
 
+bool net::selector::grow()
+{
+	struct pollfd* events;
+	if ((events = (struct pollfd*) realloc(_M_events, _M_fdset.capacity() * sizeof(struct pollfd))) == NULL) {
+		return false;
+	}
+
+	_M_events = events;
+	_M_capacity = _M_fdset.capacity();
+
+	return true;
+}
+
 bool net::selector::remove(unsigned fd)
 {
 	int index;
@@ -83,11 +100,11 @@ bool net::selector::process_events()
 {
 	int ret;
 	if ((ret = poll(_M_events, _M_fdset.count(), -1)) <= 0) {
-		post_events_wait();
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
@@ -98,11 +115,11 @@ bool net::selector::process_events(unsigned timeout)
 {
 	int ret;
 	if ((ret = poll(_M_events, _M_fdset.count(), timeout)) <= 0) {
-		post_events_wait();
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(ret);
 
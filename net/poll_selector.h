@@ -32,6 +32,10 @@ namespace net {
 
 		private:
 			struct pollfd* _M_events;
+			size_t _M_capacity;
+
+			// Grow the events to the capacity of the set.
+			bool grow();
 
 			// Process events.
 			void process(unsigned nevents);
@@ -5,6 +5,7 @@
 
 const unsigned net::iselector::READ = POLLIN;
 const unsigned net::iselector::WRITE = POLLOUT;
+const unsigned net::iselector::EXCLUSIVE = 0;
 
 net::selector::selector()
 {
@@ -12,6 +13,7 @@ net::selector::selector()
 
 	_M_port_events = NULL;
 	_M_events = NULL;
+	_M_capacity = 0;
 }
 
 net::selector::~selector()
@@ -39,22 +41,24 @@ bool net::selector::create()
 		return false;
 	}
 
-	if ((_M_port_events = (struct port_event_t*) malloc(_M_fdset.size() * sizeof(struct port_event_t))) == NULL) {
+	if ((_M_port_events = (struct port_event_t*) malloc(MAX_EVENTS * sizeof(struct port_event_t))) == NULL) {
 		return false;
 	}
 
-	if ((_M_events = (int*) malloc(_M_fdset.size() * sizeof(int))) == NULL) {
-		return false;
-	}
-
-	return true;
+	return grow();
 }
 
 bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
 {
 	if (!_M_fdset.add(fd, type, handler)) {
-		// The file descriptor has been already inserted.
-		return true;
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
+	}
+
+	if ((_M_fdset.capacity() > _M_capacity) && (!grow())) {
+		_M_fdset.remove(fd);
+		return false;
 	}
 
 	if (port_associate(_M_fd, PORT_SOURCE_FD, (uintptr_t) fd, events, NULL) < 0) {
@@ -67,6 +71,19 @@ bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* hand
 	return true;
 }
 
+bool net::selector::grow()
+{
+	int* events;
+	if ((events = (int*) realloc(_M_events, _M_fdset.capacity() * sizeof(int))) == NULL) {
+		return false;
+	}
+
+	_M_events = events;
+	_M_capacity = _M_fdset.capacity();
+
+	return true;
+}
+
 bool net::selector::remove(unsigned fd)
 {
 	if (!_M_fdset.remove(fd)) {
@@ -99,12 +116,12 @@ bool net::selector::modify(unsigned fd, unsigned events)
 bool net::selector::process_events()
 {
 	uint_t nget = 1;
-	if (port_getn(_M_fd, _M_port_events, _M_fdset.size(), &nget, NULL) < 0) {
-		post_events_wait();
+	if (port_getn(_M_fd, _M_port_events, MAX_EVENTS, &nget, NULL) < 0) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(nget);
 
 	process(nget);
 
@@ -118,12 +135,12 @@ bool net::selector::process_events(unsigned timeout)
 	ts.tv_nsec = (timeout % 1000) * 1000000;
 
 	uint_t nget = 1;
-	if ((port_getn(_M_fd, _M_port_events, _M_fdset.size(), &nget, &ts) < 0) || (nget == 0)) {
-		post_events_wait();
+	if ((port_getn(_M_fd, _M_port_events, MAX_EVENTS, &nget, &ts) < 0) || (nget == 0)) {
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(nget);
 
 	process(nget);
 
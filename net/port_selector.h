@@ -31,10 +31,17 @@ namespace net {
 			bool process_events(unsigned timeout);
 
 		private:
+			// Maximum number of events returned by a wait.
+			static const unsigned MAX_EVENTS = 512;
+
 			int _M_fd;
 
 			struct port_event_t* _M_port_events;
 			int* _M_events;
+			size_t _M_capacity;
+
+			// Grow the events to the capacity of the set.
+			bool grow();
 
 			// Process events.
 			void process(unsigned nevents);
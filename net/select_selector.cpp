@@ -5,6 +5,7 @@
 
 const unsigned net::iselector::READ = 1;
 const unsigned net::iselector::WRITE = 2;
+const unsigned net::iselector::EXCLUSIVE = 0;
 
 net::selector::selector()
 {
@@ -17,8 +18,9 @@ net::selector::selector()
 bool net::selector::add(unsigned fd, fdset::fdtype type, io::event_handler* handler, unsigned events)
 {
 	if (!_M_fdset.add(fd, type, handler)) {
-		// The file descriptor has been already inserted.
-		return true;
+		// The file descriptor has been already inserted (or the set
+		// couldn't grow).
+		return (_M_fdset.index(fd) != -1);
 	}
 
 	if (events & READ) {
@@ -85,11 +87,11 @@ bool net::selector::process_events()
 
 	int ret;
 	if ((ret = select(highest_fd() + 1, &rfds, &wfds, NULL, NULL)) <= 0) {
-		post_events_wait();
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(&rfds, &wfds, ret);
 
@@ -107,11 +109,11 @@ bool net::selector::process_events(unsigned timeout)
 
 	int ret;
 	if ((ret = select(highest_fd() + 1, &rfds, &wfds, NULL, &tv)) <= 0) {
-		post_events_wait();
+		post_events_wait(0);
 		return false;
 	}
 
-	post_events_wait();
+	post_events_wait(ret);
 
 	process(&rfds, &wfds, ret);
 
@@ -69,7 +69,7 @@ bool net::socket::connect(type type, const socket_address& addr, int timeout)
 	return true;
 }
 
-bool net::socket::listen(const socket_address& addr)
+bool net::socket::listen(const socket_address& addr, bool reuse_port)
 {
 	// Create socket.
 	if (!create(addr.ss_family, STREAM)) {
@@ -83,6 +83,19 @@ bool net::socket::listen(const socket_address& addr)
 		return false;
 	}
 
+	// Reuse port (several sockets bound to the same address).
+	if (reuse_port) {
+#if defined(SO_REUSEPORT)
+		if (setsockopt(_M_fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int)) < 0) {
+			close();
+			return false;
+		}
+#else
+		close();
+		return false;
+#endif
+	}
+
 	// Bind.
 	if (bind(_M_fd, reinterpret_cast<const struct sockaddr*>(&addr), addr.size()) < 0) {
 		if (addr.ss_family == AF_UNIX) {
@@ -233,6 +246,15 @@ ssize_t net::socket::writev(const struct iovec* iov, unsigned iovcnt, int timeou
 	}
 }
 
+bool net::socket::get_bytes_available(int& count) const
+{
+	if (ioctl(_M_fd, FIONREAD, &count) < 0) {
+		return false;
+	}
+
+	return true;
+}
+
 bool net::socket::get_recvbuf_size(int& size) const
 {
 	socklen_t optlen = sizeof(int);
@@ -28,7 +28,7 @@ namespace net {
 			bool connect(type type, const socket_address& addr, int timeout = -1);
 
 			// Listen.
-			bool listen(const socket_address& addr);
+			bool listen(const socket_address& addr, bool reuse_port = false);
 
 			// Accept.
 			bool accept(socket& s, int timeout = -1);
@@ -46,6 +46,9 @@ namespace net {
 			// Write from multiple buffers.
 			ssize_t writev(const struct iovec* iov, unsigned iovcnt, int timeout = -1);
 
+			// Get number of bytes available for reading.
+			bool get_bytes_available(int& count) const;
+
 			// Get receive buffer size.
 			bool get_recvbuf_size(int& size) const;
 
@@ -8,6 +8,8 @@
 #include "net/ssl_socket.h"
 
 SSL_CTX* net::ssl_socket::_M_ctx = NULL;
+const unsigned char* net::ssl_socket::_M_alpn_protocols = NULL;
+unsigned net::ssl_socket::_M_alpn_protocols_len = 0;
 
 bool net::ssl_socket::init_ssl_library()
 {
@@ -62,6 +64,34 @@ bool net::ssl_socket::load_certificate(const char* certificate, const char* key)
 	return true;
 }
 
+void net::ssl_socket::alpn_protocols(const unsigned char* protocols, unsigned len)
+{
+	_M_alpn_protocols = protocols;
+	_M_alpn_protocols_len = len;
+
+	SSL_CTX_set_alpn_select_cb(_M_ctx, alpn_select, NULL);
+}
+
+void net::ssl_socket::enable_ktls()
+{
+#if HAVE_KTLS
+	// OpenSSL falls back to user space encryption if the kernel (module
+	// "tls") or the negotiated cipher doesn't support it.
+	SSL_CTX_set_options(_M_ctx, SSL_OP_ENABLE_KTLS);
+#endif // HAVE_KTLS
+}
+
+int net::ssl_socket::alpn_select(SSL* ssl, const unsigned char** out, unsigned char* outlen, const unsigned char* in, unsigned inlen, void* arg)
+{
+	// The server preference is used.
+	if (SSL_select_next_proto(const_cast<unsigned char**>(out), outlen, _M_alpn_protocols, _M_alpn_protocols_len, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+		// No protocol in common: continue without ALPN.
+		return SSL_TLSEXT_ERR_NOACK;
+	}
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
 bool net::ssl_socket::handshake(ssl_mode mode, bool& want_read, bool& want_write)
 {
 	if (!_M_ssl) {
@@ -378,6 +408,94 @@ ssize_t net::ssl_socket::writev(const struct iovec* iov, unsigned iovcnt, int ti
 	}
 }
 
+#if HAVE_KTLS
+	ssize_t net::ssl_socket::sendfile(int fd, off_t& offset, size_t count, bool& want_read, bool& want_write)
+	{
+		size_t total = 0;
+
+		do {
+			// Clear the error queue.
+			ERR_clear_error();
+
+			ossl_ssize_t ret;
+			if ((ret = SSL_sendfile(_M_ssl, fd, offset, count - total, 0)) > 0) {
+				offset += ret;
+
+				if ((total += ret) == count) {
+					want_read = false;
+					want_write = false;
+
+					return count;
+				}
+
+				continue;
+			} else if (ret == 0) {
+				// The file has been truncated.
+				want_read = false;
+				want_write = false;
+
+				return -1;
+			}
+
+			int err;
+			switch ((err = SSL_get_error(_M_ssl, ret))) {
+				case SSL_ERROR_WANT_READ:
+				case SSL_ERROR_WANT_WRITE:
+					if (errno == EINTR) {
+						continue;
+					}
+
+					want_read = (err == SSL_ERROR_WANT_READ);
+					want_write = !want_read;
+
+					if (total == 0) {
+						return -1;
+					} else {
+						return total;
+					}
+				case SSL_ERROR_SYSCALL:
+					if (errno == EINTR) {
+						continue;
+					}
+
+					// Fall through.
+				default:
+					want_read = false;
+					want_write = false;
+
+					return -1;
+			}
+		} while (true);
+	}
+
+	ssize_t net::ssl_socket::sendfile(int fd, off_t& offset, size_t count, int timeout)
+	{
+		size_t total = 0;
+
+		do {
+			bool want_read, want_write;
+			ssize_t ret;
+			if ((ret = sendfile(fd, offset, count - total, want_read, want_write)) > 0) {
+				if ((total += ret) == count) {
+					return count;
+				}
+			}
+
+			if (want_read) {
+				if (!wait_readable(timeout)) {
+					return -1;
+				}
+			} else if (want_write) {
+				if (!wait_writable(timeout)) {
+					return -1;
+				}
+			} else if (ret < 0) {
+				return -1;
+			}
+		} while (true);
+	}
+#endif // HAVE_KTLS
+
 bool net::ssl_socket::ssl_handshake(bool& want_read, bool& want_write)
 {
 	do {
@@ -2,10 +2,16 @@
 #define SSL_SOCKET_H
 
 #include <stdlib.h>
+#include <string.h>
 #include <openssl/ssl.h>
 #include "net/socket.h"
 #include "string/buffer.h"
 
+// Kernel TLS (OpenSSL >= 3.0 built with kTLS support).
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+	#define HAVE_KTLS 1
+#endif
+
 namespace net {
 	class ssl_socket : public socket {
 		public:
@@ -15,9 +21,21 @@ namespace net {
 			// Free SSL library.
 			static void free_ssl_library();
 
+			// SSL library initialized?
+			static bool ssl_library_initialized();
+
 			// Load certificate.
 			static bool load_certificate(const char* certificate, const char* key);
 
+			// Set the protocols offered with ALPN (wire format, in order of
+			// preference).
+			static void alpn_protocols(const unsigned char* protocols, unsigned len);
+
+			// Let the kernel encrypt (and decrypt) the records once the
+			// handshake has been performed (kTLS) if the SSL library, the
+			// kernel and the negotiated cipher support it.
+			static void enable_ktls();
+
 			// Constructor.
 			ssl_socket();
 			ssl_socket(int fd);
@@ -37,6 +55,9 @@ namespace net {
 			// Handshake performed?
 			bool handshaked() const;
 
+			// Has the protocol been selected with ALPN?
+			bool alpn_selected(const char* protocol, unsigned len) const;
+
 			// Shutdown TLS/SSL connection.
 			bool shutdown(bool bidirectional, bool& want_read, bool& want_write);
 			bool shutdown(bool bidirectional, int timeout = -1);
@@ -53,6 +74,15 @@ namespace net {
 			ssize_t writev(const struct iovec* iov, unsigned iovcnt, bool& want_read, bool& want_write);
 			ssize_t writev(const struct iovec* iov, unsigned iovcnt, int timeout = -1);
 
+			// Are the records sent encrypted by the kernel (kTLS)?
+			bool ktls_send() const;
+
+#if HAVE_KTLS
+			// Send file (only if ktls_send()).
+			ssize_t sendfile(int fd, off_t& offset, size_t count, bool& want_read, bool& want_write);
+			ssize_t sendfile(int fd, off_t& offset, size_t count, int timeout = -1);
+#endif // HAVE_KTLS
+
 		protected:
 			static SSL_CTX* _M_ctx;
 
@@ -67,9 +97,21 @@ namespace net {
 		private:
 			static const size_t GATHER_OUTPUT_MAX_SIZE = 2 * 1024;
 
+			// Protocols offered with ALPN.
+			static const unsigned char* _M_alpn_protocols;
+			static unsigned _M_alpn_protocols_len;
+
+			// ALPN callback.
+			static int alpn_select(SSL* ssl, const unsigned char** out, unsigned char* outlen, const unsigned char* in, unsigned inlen, void* arg);
+
 			string::buffer _M_gather_output;
 	};
 
+	inline bool ssl_socket::ssl_library_initialized()
+	{
+		return (_M_ctx != NULL);
+	}
+
 	inline ssl_socket::ssl_socket()
 	{
 		_M_ssl = NULL;
@@ -111,6 +153,24 @@ namespace net {
 	{
 		return (_M_ssl != NULL);
 	}
+
+	inline bool ssl_socket::alpn_selected(const char* protocol, unsigned len) const
+	{
+		const unsigned char* data;
+		unsigned datalen;
+		SSL_get0_alpn_selected(_M_ssl, &data, &datalen);
+
+		return ((datalen == len) && (memcmp(data, protocol, len) == 0));
+	}
+
+	inline bool ssl_socket::ktls_send() const
+	{
+#if HAVE_KTLS
+		return BIO_get_ktls_send(SSL_get_wbio(_M_ssl));
+#else
+		return false;
+#endif // HAVE_KTLS
+	}
 }
 
 #endif // SSL_SOCKET_H
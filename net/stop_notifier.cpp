@@ -0,0 +1,55 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "net/stop_notifier.h"
+
+net::stop_notifier::~stop_notifier()
+{
+	if (_M_pipe[0] != -1) {
+		close(_M_pipe[0]);
+		close(_M_pipe[1]);
+	}
+}
+
+bool net::stop_notifier::create()
+{
+	if (pipe(_M_pipe) < 0) {
+		_M_pipe[0] = -1;
+		_M_pipe[1] = -1;
+
+		return false;
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		if ((fcntl(_M_pipe[i], F_SETFL, O_NONBLOCK) < 0) || (fcntl(_M_pipe[i], F_SETFD, FD_CLOEXEC) < 0)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void net::stop_notifier::notify()
+{
+	if (_M_pipe[1] != -1) {
+		// Save 'errno' (might be called from a signal handler).
+		int error = errno;
+
+		char c = 0;
+		while ((write(_M_pipe[1], &c, 1) < 0) && (errno == EINTR));
+
+		errno = error;
+	}
+}
+
+bool net::stop_notifier::on_readable()
+{
+	char buf[64];
+	ssize_t ret;
+
+	do {
+		ret = read(_M_pipe[0], buf, sizeof(buf));
+	} while ((ret > 0) || ((ret < 0) && (errno == EINTR)));
+
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef STOP_NOTIFIER_H
+#define STOP_NOTIFIER_H
+
+#include "io/event_handler.h"
+
+namespace net {
+	// Pipe which wakes up the event loop of a server when it's stopped
+	// (notify() might be called from another thread or from a signal
+	// handler).
+	class stop_notifier : public io::event_handler {
+		public:
+			// Constructor.
+			stop_notifier();
+
+			// Destructor.
+			~stop_notifier();
+
+			// Create.
+			bool create();
+
+			// Get descriptor to be watched (-1 if none).
+			int fd() const;
+
+			// Wake up the event loop (async-signal-safe).
+			void notify();
+
+			// On readable.
+			bool on_readable();
+
+			// On writable.
+			bool on_writable();
+
+		private:
+			int _M_pipe[2];
+	};
+
+	inline stop_notifier::stop_notifier()
+	{
+		_M_pipe[0] = -1;
+		_M_pipe[1] = -1;
+	}
+
+	inline int stop_notifier::fd() const
+	{
+		return _M_pipe[0];
+	}
+
+	inline bool stop_notifier::on_writable()
+	{
+		return true;
+	}
+}
+
+#endif // STOP_NOTIFIER_H
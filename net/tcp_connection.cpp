@@ -5,21 +5,129 @@
 #include "net/tcp_connection.h"
 #include "net/tcp_connection.inl"
 #include "net/tcp_server.h"
+#include "macros/macros.h"
 
 unsigned net::tcp_connection::_M_max_idle_time = MAX_IDLE_TIME;
-net::tcp_server* net::tcp_connection::_M_server = NULL;
+bool net::tcp_connection::_M_lazy_idle_timer = false;
 
 net::tcp_connection::tcp_connection()
 {
+	_M_server = NULL;
+
+	_M_next = NULL;
+
 	_M_inp = 0;
 	_M_outp = 0;
 
-	_M_timer_set = 0;
+	_M_timer.handler = this;
+
+	_M_last_activity = 0;
+	_M_idle_time = MAX_IDLE_TIME;
 
 	_M_state = 0;
 
 	_M_readable = 0;
 	_M_writable = 0;
+
+#if HAVE_IO_URING
+	_M_completion = 0;
+#endif // HAVE_IO_URING
+
+	_M_nreads = 0;
+	_M_read_hint = 0;
+}
+
+void net::tcp_connection::free()
+{
+#if HAVE_SSL
+	if (_M_ssl_socket.handshaked()) {
+		_M_ssl_socket.free();
+	}
+#endif // HAVE_SSL
+
+	tcp_connection::reset();
+
+	_M_in.clear();
+	_M_inp = 0;
+
+	cancel_timer();
+
+	_M_readable = 0;
+	_M_writable = 0;
+
+	_M_read_hint = 0;
+
+	release_buffers();
+
+	_M_server->release_connection(this);
+}
+
+bool net::tcp_connection::on_readable()
+{
+	_M_readable = 1;
+
+	bool ret;
+	if (!_M_server->collect_stats()) {
+		ret = run();
+	} else {
+		uint64_t start = loop_stats::now();
+		ret = run();
+		_M_server->stats().add_readable(loop_stats::now() - start);
+	}
+
+	if (!ret) {
+		free();
+		return false;
+	}
+
+	return true;
+}
+
+bool net::tcp_connection::on_writable()
+{
+	_M_writable = 1;
+
+	bool ret;
+	if (!_M_server->collect_stats()) {
+		ret = run();
+	} else {
+		uint64_t start = loop_stats::now();
+		ret = run();
+		_M_server->stats().add_writable(loop_stats::now() - start);
+	}
+
+	if (!ret) {
+		free();
+		return false;
+	}
+
+	return true;
+}
+
+void net::tcp_connection::release_buffers()
+{
+	string::buffer_pool& pool = _M_server->buffer_pool();
+
+	// Keep the input buffer if it contains data not processed yet.
+	if (_M_in.empty()) {
+		pool.put(_M_in);
+	}
+
+	pool.put(_M_out);
+
+#if HAVE_SSL && !HAVE_MMAP
+	pool.put(_M_filesender.output());
+#endif // HAVE_SSL && !HAVE_MMAP
+}
+
+bool net::tcp_connection::borrow_buffer(string::buffer& buf, size_t size)
+{
+	return _M_server->buffer_pool().get(buf, size);
+}
+
+void net::tcp_connection::release_buffer(string::buffer& buf)
+{
+	_M_server->buffer_pool().put(buf);
 }
 
 void net::tcp_connection::reset()
@@ -27,6 +135,8 @@ void net::tcp_connection::reset()
 	_M_out.clear();
 	_M_outp = 0;
 
+	_M_nreads = 0;
+
 	_M_state = 0;
 
 #if HAVE_SSL
@@ -34,21 +144,95 @@ void net::tcp_connection::reset()
 #endif
 }
 
+ssize_t net::tcp_connection::socket_read(void* buf, size_t count)
+{
+#if HAVE_IO_URING
+	if (_M_completion) {
+		return _M_server->recv(_M_socket.fd(), buf, count);
+	}
+#endif // HAVE_IO_URING
+
+	return _M_socket.read(buf, count, 0);
+}
+
+ssize_t net::tcp_connection::socket_write(const void* buf, size_t count)
+{
+#if HAVE_IO_URING
+	if (_M_completion) {
+		struct iovec vec;
+		vec.iov_base = (void*) buf;
+		vec.iov_len = count;
+
+		return _M_server->send(_M_socket.fd(), &vec, 1);
+	}
+#endif // HAVE_IO_URING
+
+	return _M_socket.write(buf, count, 0);
+}
+
+ssize_t net::tcp_connection::socket_writev(const struct iovec* iov, unsigned iovcnt)
+{
+#if HAVE_IO_URING
+	if (_M_completion) {
+		return _M_server->send(_M_socket.fd(), iov, iovcnt);
+	}
+#endif // HAVE_IO_URING
+
+	return _M_socket.writev(iov, iovcnt, 0);
+}
+
+off_t net::tcp_connection::socket_sendfile(fs::file& f, off_t filesize, off_t count)
+{
+#if HAVE_IO_URING
+	if (_M_completion) {
+		ssize_t ret;
+		if ((ret = _M_server->sendfile(_M_socket.fd(), f.fd(), _M_outp, count)) > 0) {
+			_M_outp += ret;
+		}
+
+		return ret;
+	}
+#endif // HAVE_IO_URING
+
+	return filesender::sendfile(_M_socket, f, filesize, _M_outp, count, 0);
+}
+
+bool net::tcp_connection::socket_bytes_available(int& count) const
+{
+#if HAVE_IO_URING
+	if (_M_completion) {
+		count = _M_server->available(_M_socket.fd());
+		return true;
+	}
+#endif // HAVE_IO_URING
+
+	return _M_socket.get_bytes_available(count);
+}
+
 bool net::tcp_connection::unsecure_read(string::buffer& buf, size_t& count)
 {
-	// Allocate memory.
-	if (!buf.allocate(READ_BUFFER_SIZE)) {
+	// Borrow buffer (big enough for what the peer sent last time).
+	if (!borrow_buffer(buf, MAX(READ_BUFFER_SIZE, _M_read_hint))) {
 		return false;
 	}
 
-	// Receive.
+	// Receive (as much as fits in the buffer).
+	size_t size = MIN(buf.remaining(), MAX_READ_SIZE);
+
+	_M_nreads++;
+
 	ssize_t ret;
-	if ((ret = _M_socket.read(buf.end(), READ_BUFFER_SIZE, 0)) < 0) {
+	if ((ret = socket_read(buf.end(), size)) < 0) {
 		if (errno == EAGAIN) {
 			if (!add_timer()) {
 				return false;
 			}
 
+			// Don't keep an empty buffer while waiting.
+			if (buf.empty()) {
+				release_buffer(buf);
+			}
+
 			count = 0;
 			_M_readable = 0;
 		} else {
@@ -61,26 +245,40 @@ bool net::tcp_connection::unsecure_read(string::buffer& buf, size_t& count)
 		buf.increment_length(ret);
 		count = ret;
 
-		if ((size_t) ret < count) {
+		// If the socket has been drained...
+		if ((size_t) ret < size) {
 			if (!add_timer()) {
 				return false;
 			}
 
+			if (buf.length() > _M_read_hint) {
+				_M_read_hint = MIN(buf.length(), MAX_READ_SIZE);
+			}
+
 			_M_readable = 0;
 		} else {
 			delete_timer();
+
+			// Make room for the rest of the data, so it can be received
+			// with a single read.
+			int available;
+			if ((socket_bytes_available(available)) && (available > 0)) {
+				if (!borrow_buffer(buf, MIN((size_t) available, MAX_READ_SIZE))) {
+					return false;
+				}
+			}
 		}
 	}
 
 	return true;
 }
 
-bool net::tcp_connection::unsecure_write(const string::buffer& buf)
+bool net::tcp_connection::unsecure_write(const string::buffer& buf, size_t end)
 {
 	// Send.
-	size_t count = buf.length() - _M_outp;
+	size_t count = end - _M_outp;
 	ssize_t ret;
-	if ((ret = _M_socket.write(buf.data() + _M_outp, count, 0)) < 0) {
+	if ((ret = socket_write(buf.data() + _M_outp, count)) < 0) {
 		if (errno == EAGAIN) {
 			if (!add_timer()) {
 				return false;
@@ -122,6 +320,12 @@ bool net::tcp_connection::unsecure_writev(const string::buffer** bufs, unsigned
 		count--;
 	}
 
+	// Everything has been sent?
+	if (count == 0) {
+		delete_timer();
+		return true;
+	}
+
 	struct iovec vec[IOV_MAX];
 	size_t total = 0;
 
@@ -138,7 +342,7 @@ bool net::tcp_connection::unsecure_writev(const string::buffer** bufs, unsigned
 
 	// Send.
 	ssize_t ret;
-	if ((ret = _M_socket.writev(vec, count, 0)) < 0) {
+	if ((ret = socket_writev(vec, count)) < 0) {
 		if (errno == EAGAIN) {
 			if (!add_timer()) {
 				return false;
@@ -178,7 +382,7 @@ bool net::tcp_connection::unsecure_sendfile(fs::file& f, off_t filesize, const u
 
 	// Send file.
 	off_t ret;
-	if ((ret = filesender::sendfile(_M_socket, f, filesize, _M_outp, count, 0)) < 0) {
+	if ((ret = socket_sendfile(f, filesize, count)) < 0) {
 		if (errno == EAGAIN) {
 			if (!add_timer()) {
 				return false;
@@ -237,6 +441,10 @@ bool net::tcp_connection::unsecure_sendfile(fs::file& f, off_t filesize, const u
 
 		completed = true;
 
+		if (_M_ssl_socket.ktls_send()) {
+			_M_server->ktls_offloaded();
+		}
+
 		delete_timer();
 
 		return true;
@@ -244,21 +452,30 @@ bool net::tcp_connection::unsecure_sendfile(fs::file& f, off_t filesize, const u
 
 	bool net::tcp_connection::secure_read(string::buffer& buf, size_t& count)
 	{
-		// Allocate memory.
-		if (!buf.allocate(READ_BUFFER_SIZE)) {
+		// Borrow buffer (big enough for what the peer sent last time).
+		if (!borrow_buffer(buf, MAX(READ_BUFFER_SIZE, _M_read_hint))) {
 			return false;
 		}
 
-		// Receive.
+		// Receive (as much as fits in the buffer).
+		size_t size = MIN(buf.remaining(), MAX_READ_SIZE);
+
+		_M_nreads++;
+
 		bool want_read;
 		bool want_write;
 		ssize_t ret;
-		if ((ret = _M_ssl_socket.read(buf.end(), READ_BUFFER_SIZE, want_read, want_write)) < 0) {
+		if ((ret = _M_ssl_socket.read(buf.end(), size, want_read, want_write)) < 0) {
 			if (want_read) {
 				if (!add_timer()) {
 					return false;
 				}
 
+				// Don't keep an empty buffer while waiting.
+				if (buf.empty()) {
+					release_buffer(buf);
+				}
+
 				_M_readable = 0;
 
 				count = 0;
@@ -303,12 +520,12 @@ bool net::tcp_connection::unsecure_sendfile(fs::file& f, off_t filesize, const u
 		}
 	}
 
-	bool net::tcp_connection::secure_write(const string::buffer& buf)
+	bool net::tcp_connection::secure_write(const string::buffer& buf, size_t end)
 	{
 		// Send.
 		bool want_read;
 		bool want_write;
-		size_t count = buf.length() - _M_outp;
+		size_t count = end - _M_outp;
 		ssize_t ret;
 		if ((ret = _M_ssl_socket.write(buf.data() + _M_outp, count, want_read, want_write)) < 0) {
 			if (want_read) {
@@ -453,21 +670,52 @@ bool net::tcp_connection::unsecure_sendfile(fs::file& f, off_t filesize, const u
 
 bool net::tcp_connection::add_timer()
 {
-	delete_timer();
+	if (_M_lazy_idle_timer) {
+		_M_last_activity = _M_server->current_msec();
+
+		// If the idle time has been shortened, the timer might expire too
+		// late.
+		unsigned msec = _M_last_activity + (_M_idle_time * 1000);
+		if ((_M_timer.active()) && ((int) (_M_timer.msec - msec) > 0)) {
+			_M_server->timer::timers::add(_M_timer, msec);
+		}
 
-	if (!_M_server->timer::timers::add(_M_server->current_msec() + (_M_max_idle_time * 1000), this, 0, _M_timer)) {
-		return false;
+		return true;
 	}
 
-	_M_timer_set = 1;
+	_M_server->timer::timers::add(_M_timer, _M_server->current_msec() + (_M_idle_time * 1000));
 
 	return true;
 }
 
 void net::tcp_connection::delete_timer()
 {
-	if (_M_timer_set) {
-		_M_server->del(_M_timer);
-		_M_timer_set = 0;
+	if (_M_lazy_idle_timer) {
+		_M_last_activity = _M_server->current_msec();
+		return;
 	}
+
+	_M_server->del(_M_timer);
+}
+
+void net::tcp_connection::cancel_timer()
+{
+	_M_server->del(_M_timer);
+}
+
+bool net::tcp_connection::idle_expired()
+{
+	if (!_M_lazy_idle_timer) {
+		return true;
+	}
+
+	unsigned msec = _M_last_activity + (_M_idle_time * 1000);
+
+	// If there has been activity since the timer was armed...
+	if ((int) (msec - _M_server->current_msec()) > 0) {
+		_M_server->timer::timers::add(_M_timer, msec);
+		return false;
+	}
+
+	return true;
 }
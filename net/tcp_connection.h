@@ -14,7 +14,6 @@
 #include "net/listener.h"
 #include "string/buffer.h"
 #include "fs/file.h"
-#include "util/red_black_tree.h"
 #include "util/ranges.h"
 
 namespace net {
@@ -22,7 +21,11 @@ namespace net {
 
 	struct tcp_connection : public io::event_handler, public timer::event_handler {
 		public:
+			// Minimum number of bytes to read.
 			static const size_t READ_BUFFER_SIZE = 2 * 1024;
+
+			// Maximum number of bytes to read at once.
+			static const size_t MAX_READ_SIZE = 64 * 1024;
 			static const unsigned MAX_IDLE_TIME = 30; // [seconds]
 
 			string::buffer _M_in;
@@ -34,17 +37,42 @@ namespace net {
 			listener* _M_listener;
 
 			// Timer.
-			util::red_black_tree<timer::timer>::iterator _M_timer;
-			unsigned _M_timer_set:1;
+			timer::timer _M_timer;
+
+			// Time of the last I/O (lazy idle timer) [milliseconds].
+			unsigned _M_last_activity;
+
+			// Idle time after which the connection is closed [seconds].
+			unsigned _M_idle_time;
 
 			unsigned _M_state:5;
 
 			unsigned _M_readable:1;
 			unsigned _M_writable:1;
 
+#if HAVE_IO_URING
+			// Is the I/O performed by the selector (completion-based)?
+			unsigned _M_completion:1;
+#endif // HAVE_IO_URING
+
+			// Number of reads of the current request.
+			unsigned short _M_nreads;
+
+			// Number of bytes received from the peer at once (used to size
+			// the input buffer).
+			unsigned _M_read_hint;
+
 			static unsigned _M_max_idle_time;
 
-			static tcp_server* _M_server;
+			// Lazy idle timer: the timer is armed once and the I/O operations
+			// only stamp the time of the last activity, which is checked when
+			// the timer expires.
+			static bool _M_lazy_idle_timer;
+
+			tcp_server* _M_server;
+
+			// Next free connection.
+			tcp_connection* _M_next;
 
 			// Constructor.
 			tcp_connection();
@@ -52,9 +80,19 @@ namespace net {
 			// Destructor.
 			virtual ~tcp_connection();
 
-			// Free.
+			// Free (the connection is returned to the server).
 			virtual void free();
 
+			// Release the I/O buffers (they are returned to the buffer pool
+			// of the server).
+			virtual void release_buffers();
+
+			// Borrow buffer from the buffer pool.
+			bool borrow_buffer(string::buffer& buf, size_t size);
+
+			// Release buffer to the buffer pool.
+			void release_buffer(string::buffer& buf);
+
 			// Reset.
 			virtual void reset();
 
@@ -83,6 +121,9 @@ namespace net {
 			bool write(const string::buffer& buf);
 			bool write();
 
+			// Write the buffer up to the offset 'end'.
+			bool write(const string::buffer& buf, size_t end);
+
 			// Write from multiple buffers.
 			bool writev(const string::buffer** bufs, unsigned count);
 
@@ -107,11 +148,19 @@ namespace net {
 			filesender _M_filesender;
 #endif // HAVE_SSL
 
+			// Receive from / send to the socket (through the selector if the
+			// I/O is completion-based).
+			ssize_t socket_read(void* buf, size_t count);
+			ssize_t socket_write(const void* buf, size_t count);
+			ssize_t socket_writev(const struct iovec* iov, unsigned iovcnt);
+			off_t socket_sendfile(fs::file& f, off_t filesize, off_t count);
+			bool socket_bytes_available(int& count) const;
+
 			// Read.
 			bool unsecure_read(string::buffer& buf, size_t& count);
 
 			// Write.
-			bool unsecure_write(const string::buffer& buf);
+			bool unsecure_write(const string::buffer& buf, size_t end);
 
 			// Write from multiple buffers.
 			bool unsecure_writev(const string::buffer** bufs, unsigned count);
@@ -124,7 +173,7 @@ namespace net {
 			bool secure_read(string::buffer& buf, size_t& count);
 
 			// Write.
-			bool secure_write(const string::buffer& buf);
+			bool secure_write(const string::buffer& buf, size_t end);
 
 			// Write from multiple buffers.
 			bool secure_writev(const string::buffer** bufs, unsigned count);
@@ -138,6 +187,13 @@ namespace net {
 
 			// Delete timer.
 			void delete_timer();
+
+			// Cancel timer (also in lazy mode).
+			void cancel_timer();
+
+			// Has the connection been idle for too long? (if not, the timer
+			// is rearmed).
+			bool idle_expired();
 	};
 
 	inline tcp_connection::~tcp_connection()
@@ -149,49 +205,6 @@ namespace net {
 #endif // HAVE_SSL
 	}
 
-	inline void tcp_connection::free()
-	{
-#if HAVE_SSL
-		if (_M_ssl_socket.handshaked()) {
-			_M_ssl_socket.free();
-		}
-#endif // HAVE_SSL
-
-		tcp_connection::reset();
-
-		_M_in.clear();
-		_M_inp = 0;
-
-		delete_timer();
-
-		_M_readable = 0;
-		_M_writable = 0;
-	}
-
-	inline bool net::tcp_connection::on_readable()
-	{
-		_M_readable = 1;
-
-		if (!run()) {
-			free();
-			return false;
-		}
-
-		return true;
-	}
-
-	inline bool net::tcp_connection::on_writable()
-	{
-		_M_writable = 1;
-
-		if (!run()) {
-			free();
-			return false;
-		}
-
-		return true;
-	}
-
 	inline bool tcp_connection::read(string::buffer& buf, size_t& count)
 	{
 #if !HAVE_SSL
@@ -221,12 +234,12 @@ namespace net {
 	inline bool tcp_connection::write(const string::buffer& buf)
 	{
 #if !HAVE_SSL
-		return unsecure_write(buf);
+		return unsecure_write(buf, buf.length());
 #else
 		if (!_M_ssl_socket.handshaked()) {
-			return unsecure_write(buf);
+			return unsecure_write(buf, buf.length());
 		} else {
-			return secure_write(buf);
+			return secure_write(buf, buf.length());
 		}
 #endif // HAVE_SSL
 	}
@@ -234,12 +247,25 @@ namespace net {
 	inline bool tcp_connection::write()
 	{
 #if !HAVE_SSL
-		return unsecure_write(_M_out);
+		return unsecure_write(_M_out, _M_out.length());
+#else
+		if (!_M_ssl_socket.handshaked()) {
+			return unsecure_write(_M_out, _M_out.length());
+		} else {
+			return secure_write(_M_out, _M_out.length());
+		}
+#endif // HAVE_SSL
+	}
+
+	inline bool tcp_connection::write(const string::buffer& buf, size_t end)
+	{
+#if !HAVE_SSL
+		return unsecure_write(buf, end);
 #else
 		if (!_M_ssl_socket.handshaked()) {
-			return unsecure_write(_M_out);
+			return unsecure_write(buf, end);
 		} else {
-			return secure_write(_M_out);
+			return secure_write(buf, end);
 		}
 #endif // HAVE_SSL
 	}
@@ -1,31 +1,60 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
 #include <sys/types.h>
-#include <sys/time.h>
 #include <sys/socket.h>
 #include <memory>
 #include "net/tcp_server.h"
 #include "net/listener.h"
 #include "net/tcp_connection.h"
+#include "constants/months_and_days.h"
 
 net::tcp_server::tcp_server(bool client_writes_first, bool have_timer)
 {
-	listener::_M_server = this;
-	tcp_connection::_M_server = this;
-
 	_M_listeners = NULL;
 	_M_nlisteners = 0;
 
-	_M_connections = NULL;
+	_M_free_connections = NULL;
+	_M_nfree_connections = 0;
+	_M_nconnections = 0;
+
+	_M_trim_time = 0;
 
 	_M_client_writes_first = client_writes_first;
 
+	_M_reuse_port = false;
+
+	_M_current_time = (time_t) -1;
+
+	_M_shared_listeners = NULL;
+
+	_M_exclusive_accept = false;
+
+	_M_accept_batch = kDefaultAcceptBatch;
+
+	_M_accept_wakeups = 0;
+	_M_accepted_connections = 0;
+	_M_max_accepted_per_wakeup = 0;
+
+	_M_completed_requests = 0;
+	_M_request_reads = 0;
+	_M_max_reads_per_request = 0;
+
+	_M_ktls_connections = 0;
+
+	_M_collect_stats = false;
+	_M_wait_end = 0;
+
 	update_time();
 
+	timer::timers::init(_M_current_msec);
+
 	_M_have_timer = have_timer;
 
 	_M_handle_alarm = false;
 
-	_M_must_stop = true;
+	_M_must_stop = 0;
 }
 
 net::tcp_server::~tcp_server()
@@ -37,10 +66,6 @@ net::tcp_server::~tcp_server()
 
 		free(_M_listeners);
 	}
-
-	if (_M_connections) {
-		free(_M_connections);
-	}
 }
 
 bool net::tcp_server::create()
@@ -49,14 +74,15 @@ bool net::tcp_server::create()
 		return false;
 	}
 
-	if ((_M_connections = (tcp_connection**) malloc(_M_fdset.size() * sizeof(tcp_connection*))) == NULL) {
+	if (!_M_buffer_pool.create()) {
 		return false;
 	}
 
-	if (!create_connections()) {
+	if ((!_M_stop_notifier.create()) || (!selector::add(_M_stop_notifier.fd(), fdset::FD_NOTIFIER, &_M_stop_notifier, READ))) {
 		return false;
 	}
 
+	// The connections are allocated on demand.
 	return true;
 }
 
@@ -66,9 +92,9 @@ bool net::tcp_server::start()
 		return false;
 	}
 
-	_M_must_stop = false;
-
-	do {
+	// The stop flag is not reset here: the server might have been stopped
+	// before starting.
+	while (!_M_must_stop) {
 		if (_M_handle_alarm) {
 			handle_alarm();
 			_M_handle_alarm = false;
@@ -76,8 +102,18 @@ bool net::tcp_server::start()
 
 		process_events(1000);
 
+		if (_M_collect_stats) {
+			_M_loop_stats.add_process_time(loop_stats::now() - _M_wait_end);
+		}
+
 		handle_expired(_M_current_msec);
-	} while (!_M_must_stop);
+
+		// Release the free connections which are no longer needed.
+		if ((_M_nfree_connections > kMaxFreeConnections) && (_M_current_time != _M_trim_time)) {
+			_M_trim_time = _M_current_time;
+			trim_connections();
+		}
+	}
 
 	return true;
 }
@@ -92,25 +128,49 @@ bool net::tcp_server::on_new_connection(socket& client, const socket_address& ad
 		return false;
 	}
 
-	tcp_connection* conn = _M_connections[client.fd()];
+	// If there are no free connections, allocate more.
+	if ((!_M_free_connections) && (!create_connections())) {
+		return false;
+	}
+
+	tcp_connection* conn = _M_free_connections;
 
 	// Add timer.
-	if (!timer::timers::add(_M_current_msec + (tcp_connection::_M_max_idle_time * 1000), conn, 0, conn->_M_timer)) {
-		return false;
+	conn->_M_last_activity = _M_current_msec;
+	conn->_M_idle_time = tcp_connection::_M_max_idle_time;
+	timer::timers::add(conn->_M_timer, _M_current_msec + (conn->_M_idle_time * 1000));
+
+	unsigned events = _M_client_writes_first ? READ : WRITE;
+
+#if HAVE_IO_URING
+	// The plain connections are received and sent by the selector.
+	conn->_M_completion = ((completion()) && (!encrypted(listener)));
+	if (conn->_M_completion) {
+		events |= COMPLETION;
 	}
+#endif // HAVE_IO_URING
 
-	if (!selector::add(client.fd(), fdset::FD_SOCKET, conn, _M_client_writes_first ? READ : WRITE)) {
+	if (!selector::add(client.fd(), fdset::FD_SOCKET, conn, events)) {
 		// Delete timer.
 		del(conn->_M_timer);
 
 		return false;
 	}
 
+#if HAVE_IO_URING
+	// There is no readiness notification: the connection is writable until
+	// a send is in progress.
+	if (conn->_M_completion) {
+		conn->_M_writable = 1;
+	}
+#endif // HAVE_IO_URING
+
 	conn->fd(client.fd());
 
 	conn->_M_listener = listener;
 
-	conn->_M_timer_set = 1;
+	_M_free_connections = conn->_M_next;
+	_M_nfree_connections--;
 
 	return true;
 }
@@ -131,7 +191,27 @@ bool net::tcp_server::listen(const socket_address& addr, void* data)
 	}
 
 	socket s;
-	if (!s.listen(addr)) {
+
+	if (_M_shared_listeners) {
+		// Use a duplicate of the listener socket of the other server, so
+		// both event loops can wait on it.
+		for (unsigned i = 0; i < _M_shared_listeners->_M_nlisteners; i++) {
+			const listener* l = _M_shared_listeners->_M_listeners[i];
+			if (addr == l->_M_addr) {
+				int fd;
+				if ((fd = dup(l->fd())) < 0) {
+					return false;
+				}
+
+				s.fd(fd);
+				break;
+			}
+		}
+
+		if (s.fd() == -1) {
+			return false;
+		}
+	} else if (!s.listen(addr, _M_reuse_port)) {
 		return false;
 	}
 
@@ -157,13 +237,26 @@ bool net::tcp_server::add_listener(const socket& s, const socket_address& addr,
 		return false;
 	}
 
-	if (!selector::add(s.fd(), fdset::FD_LISTENER, l, selector::READ)) {
+	// If the listener socket is shared with other workers, wake up a single
+	// event loop per incoming connection.
+	unsigned events = selector::READ;
+	if (_M_exclusive_accept) {
+		events |= selector::EXCLUSIVE;
+	}
+
+#if HAVE_IO_URING
+	// Multishot accept.
+	events |= selector::COMPLETION;
+#endif // HAVE_IO_URING
+
+	if (!selector::add(s.fd(), fdset::FD_LISTENER, l, events)) {
 		delete l;
 		return false;
 	}
 
 	l->fd(s.fd());
 
+	l->_M_server = this;
 	l->_M_addr = addr;
 	l->_M_data = data;
 
@@ -174,12 +267,25 @@ bool net::tcp_server::add_listener(const socket& s, const socket_address& addr,
 
 void net::tcp_server::update_time()
 {
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
+	// The coarse clock is much cheaper and precise enough for the timers.
+	struct timespec ts;
+#ifdef CLOCK_REALTIME_COARSE
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+	clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+
+	_M_current_msec = (unsigned long long) ts.tv_sec * 1000 + (ts.tv_nsec / 1000000);
+
+	// If the second hasn't changed, the broken-down times are still valid.
+	if (ts.tv_sec == _M_current_time) {
+		return;
+	}
 
-	_M_current_time = tv.tv_sec;
-	_M_current_msec = (unsigned long long) _M_current_time * 1000 + (tv.tv_usec / 1000);
+	_M_current_time = ts.tv_sec;
 
 	gmtime_r(&_M_current_time, &_M_gmtime);
 	localtime_r(&_M_current_time, &_M_localtime);
+
+	_M_gmt_date_len = snprintf(_M_gmt_date, sizeof(_M_gmt_date), "%s, %02u %s %u %02u:%02u:%02u GMT", constants::days[_M_gmtime.tm_wday], _M_gmtime.tm_mday, constants::months[_M_gmtime.tm_mon], 1900 + _M_gmtime.tm_year, _M_gmtime.tm_hour, _M_gmtime.tm_min, _M_gmtime.tm_sec);
 }
@@ -2,8 +2,11 @@
 #define TCP_SERVER_H
 
 #include <time.h>
+#include <signal.h>
 
-#if HAVE_EPOLL
+#if HAVE_IO_URING
+	#include "net/io_uring_selector.h"
+#elif HAVE_EPOLL
 	#include "net/epoll_selector.h"
 #elif HAVE_KQUEUE
 	#include "net/kqueue_selector.h"
@@ -16,7 +19,11 @@
 #endif
 
 #include "net/socket.h"
+#include "net/stop_notifier.h"
+#include "net/tcp_connection.h"
+#include "net/loop_stats.h"
 #include "timer/timers.h"
+#include "string/buffer_pool.h"
 
 namespace net {
 	struct listener;
@@ -24,13 +31,21 @@ namespace net {
 
 	class tcp_server : public selector, public timer::timers {
 		public:
+			static const unsigned kMaxAcceptBatch = 1024;
+			static const unsigned kDefaultAcceptBatch = 64;
+
+			// Maximum number of free connections kept (the connections
+			// above it are released, if possible, once per second).
+			static const size_t kMaxFreeConnections = 256;
+
 			// Create.
 			virtual bool create();
 
 			// Start.
 			virtual bool start();
 
-			// Stop.
+			// Stop (might be called from another thread or from a signal
+			// handler, even before start()).
 			void stop();
 
 			// On alarm.
@@ -42,12 +57,73 @@ namespace net {
 			// Delete connection.
 			void delete_connection(tcp_connection* conn);
 
+			// Release connection (return it to the free list).
+			void release_connection(tcp_connection* conn);
+
+			// Do the workers open their own listener sockets (SO_REUSEPORT)?
+			bool reuse_port() const;
+
+			// Share the listener sockets of another server (instead of
+			// creating new ones).
+			void share_listeners(const tcp_server& server);
+
+			// Get maximum number of connections to accept per wakeup.
+			unsigned accept_batch() const;
+
+			// Update accept statistics.
+			void accepted(unsigned count);
+
+			// Get number of wakeups of the listeners.
+			unsigned long long accept_wakeups() const;
+
+			// Get number of accepted connections.
+			unsigned long long accepted_connections() const;
+
+			// Get maximum number of connections accepted in a single wakeup.
+			unsigned max_accepted_per_wakeup() const;
+
+			// Update request statistics.
+			void request_completed(unsigned nreads);
+
+			// Get number of completed requests.
+			unsigned long long completed_requests() const;
+
+			// Get number of reads of the completed requests.
+			unsigned long long request_reads() const;
+
+			// Get maximum number of reads of a single request.
+			unsigned max_reads_per_request() const;
+
+			// Update TLS statistics (the records of the connection are
+			// encrypted by the kernel).
+			void ktls_offloaded();
+
+			// Get number of connections offloaded to kernel TLS.
+			unsigned long long ktls_connections() const;
+
+			// Get buffer pool.
+			string::buffer_pool& buffer_pool();
+			const string::buffer_pool& buffer_pool() const;
+
+			// Collect event loop statistics?
+			bool collect_stats() const;
+
+			// Get event loop statistics.
+			loop_stats& stats();
+			const loop_stats& stats() const;
+
+			// Get number of allocated connections.
+			size_t allocated_connections() const;
+
 			// Get UTC time.
 			const struct tm& utc_time() const;
 
 			// Get local time.
 			const struct tm& local_time() const;
 
+			// Get UTC time formatted as an HTTP date (RFC 1123).
+			const char* gmt_date(unsigned short& len) const;
+
 			// Get current milliseconds.
 			unsigned current_msec() const;
 
@@ -56,21 +132,72 @@ namespace net {
 			listener** _M_listeners;
 			unsigned _M_nlisteners;
 
-			// TCP connections.
-			tcp_connection** _M_connections;
+			// Free TCP connections.
+			tcp_connection* _M_free_connections;
+
+			// Number of free TCP connections.
+			size_t _M_nfree_connections;
+
+			// Number of allocated TCP connections.
+			size_t _M_nconnections;
+
+			// Last time the free connections were trimmed.
+			time_t _M_trim_time;
+
+			// Buffers lent to the connections while they process a request.
+			string::buffer_pool _M_buffer_pool;
+
+			// Event loop statistics.
+			loop_stats _M_loop_stats;
+			bool _M_collect_stats;
+
+			// End of the last wait (monotonic time) [nanoseconds].
+			uint64_t _M_wait_end;
 
 			bool _M_client_writes_first;
 
+			// Several workers listen on the same addresses (SO_REUSEPORT)?
+			bool _M_reuse_port;
+
+			// Server whose listener sockets are shared (NULL if none).
+			const tcp_server* _M_shared_listeners;
+
+			// Register the listener sockets with selector::EXCLUSIVE?
+			bool _M_exclusive_accept;
+
+			// Maximum number of connections to accept per wakeup.
+			unsigned _M_accept_batch;
+
+			// Accept statistics.
+			unsigned long long _M_accept_wakeups;
+			unsigned long long _M_accepted_connections;
+			unsigned _M_max_accepted_per_wakeup;
+
+			// Request statistics.
+			unsigned long long _M_completed_requests;
+			unsigned long long _M_request_reads;
+			unsigned _M_max_reads_per_request;
+
+			// TLS statistics.
+			unsigned long long _M_ktls_connections;
+
 			time_t _M_current_time;
 			unsigned _M_current_msec;
 			struct tm _M_gmtime;
 			struct tm _M_localtime;
 
+			// UTC time formatted as an HTTP date (rebuilt when the second
+			// changes).
+			char _M_gmt_date[32];
+			unsigned short _M_gmt_date_len;
+
 			bool _M_have_timer;
 
 			bool _M_handle_alarm;
 
-			bool _M_must_stop;
+			// Set by stop(), the event loop is woken up by the notifier.
+			volatile sig_atomic_t _M_must_stop;
+			stop_notifier _M_stop_notifier;
 
 			// Constructor.
 			tcp_server(bool client_writes_first, bool have_timer);
@@ -78,20 +205,29 @@ namespace net {
 			// Destructor.
 			virtual ~tcp_server();
 
-			// Create connections.
+			// Create connections (allocates a new slab of connections and
+			// adds them to the free list).
 			virtual bool create_connections() = 0;
 
+			// Release free connections (called when there are more than
+			// kMaxFreeConnections).
+			virtual void trim_connections();
+
 			// Listen.
 			bool listen(const socket_address& addr, void* data);
 
 			// Allow connection?
 			virtual bool allow_connection(const socket_address& addr, struct listener* listener);
 
+			// Are the connections of the listener encrypted? (their I/O is not
+			// completion-based).
+			virtual bool encrypted(const struct listener* listener) const;
+
 			// Handle alarm.
 			virtual void handle_alarm();
 
 			// Post-events-wait.
-			void post_events_wait();
+			void post_events_wait(unsigned nevents);
 
 		private:
 			// Add listener.
@@ -103,7 +239,8 @@ namespace net {
 
 	inline void tcp_server::stop()
 	{
-		_M_must_stop = true;
+		_M_must_stop = 1;
+		_M_stop_notifier.notify();
 	}
 
 	inline void tcp_server::on_alarm()
@@ -111,6 +248,119 @@ namespace net {
 		_M_handle_alarm = true;
 	}
 
+	inline void tcp_server::release_connection(tcp_connection* conn)
+	{
+		conn->_M_next = _M_free_connections;
+		_M_free_connections = conn;
+
+		_M_nfree_connections++;
+	}
+
+	inline bool tcp_server::reuse_port() const
+	{
+		return _M_reuse_port;
+	}
+
+	inline void tcp_server::share_listeners(const tcp_server& server)
+	{
+		_M_shared_listeners = &server;
+	}
+
+	inline unsigned tcp_server::accept_batch() const
+	{
+		return _M_accept_batch;
+	}
+
+	inline void tcp_server::accepted(unsigned count)
+	{
+		_M_accept_wakeups++;
+		_M_accepted_connections += count;
+
+		if (count > _M_max_accepted_per_wakeup) {
+			_M_max_accepted_per_wakeup = count;
+		}
+	}
+
+	inline unsigned long long tcp_server::accept_wakeups() const
+	{
+		return _M_accept_wakeups;
+	}
+
+	inline unsigned long long tcp_server::accepted_connections() const
+	{
+		return _M_accepted_connections;
+	}
+
+	inline unsigned tcp_server::max_accepted_per_wakeup() const
+	{
+		return _M_max_accepted_per_wakeup;
+	}
+
+	inline void tcp_server::request_completed(unsigned nreads)
+	{
+		_M_completed_requests++;
+		_M_request_reads += nreads;
+
+		if (nreads > _M_max_reads_per_request) {
+			_M_max_reads_per_request = nreads;
+		}
+	}
+
+	inline unsigned long long tcp_server::completed_requests() const
+	{
+		return _M_completed_requests;
+	}
+
+	inline unsigned long long tcp_server::request_reads() const
+	{
+		return _M_request_reads;
+	}
+
+	inline unsigned tcp_server::max_reads_per_request() const
+	{
+		return _M_max_reads_per_request;
+	}
+
+	inline void tcp_server::ktls_offloaded()
+	{
+		_M_ktls_connections++;
+	}
+
+	inline unsigned long long tcp_server::ktls_connections() const
+	{
+		return _M_ktls_connections;
+	}
+
+	inline string::buffer_pool& tcp_server::buffer_pool()
+	{
+		return _M_buffer_pool;
+	}
+
+	inline const string::buffer_pool& tcp_server::buffer_pool() const
+	{
+		return _M_buffer_pool;
+	}
+
+	inline bool tcp_server::collect_stats() const
+	{
+		return _M_collect_stats;
+	}
+
+	inline loop_stats& tcp_server::stats()
+	{
+		return _M_loop_stats;
+	}
+
+	inline const loop_stats& tcp_server::stats() const
+	{
+		return _M_loop_stats;
+	}
+
+	inline size_t tcp_server::allocated_connections() const
+	{
+		return _M_nconnections;
+	}
+
 	inline const struct tm& tcp_server::utc_time() const
 	{
 		return _M_gmtime;
@@ -121,6 +371,12 @@ namespace net {
 		return _M_localtime;
 	}
 
+	inline const char* tcp_server::gmt_date(unsigned short& len) const
+	{
+		len = _M_gmt_date_len;
+		return _M_gmt_date;
+	}
+
 	inline unsigned tcp_server::current_msec() const
 	{
 		return _M_current_msec;
@@ -131,16 +387,30 @@ namespace net {
 		return true;
 	}
 
+	inline bool tcp_server::encrypted(const struct listener* listener) const
+	{
+		return false;
+	}
+
+	inline void tcp_server::trim_connections()
+	{
+	}
+
 	inline void tcp_server::handle_alarm()
 	{
 		update_time();
 	}
 
-	inline void tcp_server::post_events_wait()
+	inline void tcp_server::post_events_wait(unsigned nevents)
 	{
 		if (!_M_have_timer) {
 			update_time();
 		}
+
+		if (_M_collect_stats) {
+			_M_loop_stats.add_wait(nevents);
+			_M_wait_end = loop_stats::now();
+		}
 	}
 }
 
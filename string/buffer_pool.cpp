@@ -0,0 +1,78 @@
+#include <new>
+#include "string/buffer_pool.h"
+
+const size_t string::buffer_pool::kClassSizes[kNumberClasses] = {4 * 1024, 16 * 1024, 64 * 1024};
+
+bool string::buffer_pool::create()
+{
+	for (unsigned i = 0; i < kNumberClasses; i++) {
+		if ((_M_buffers[i] = new (std::nothrow) buffer[kMaxFreeBuffers]) == NULL) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool string::buffer_pool::get(buffer& buf, size_t size)
+{
+	// If the buffer has already enough space...
+	if (buf.remaining() >= size) {
+		return true;
+	}
+
+	size += buf.length();
+
+	for (unsigned i = 0; i < kNumberClasses; i++) {
+		if (kClassSizes[i] >= size) {
+			// If there is a free buffer of this size class...
+			if (_M_used[i] > 0) {
+				buffer b;
+				b.swap(_M_buffers[i][--_M_used[i]]);
+
+				// Copy the data (if any) to the new buffer.
+				if (!buf.empty()) {
+					memcpy(b.data(), buf.data(), buf.length());
+				}
+
+				b.length(buf.length());
+
+				// Release the old storage.
+				buf.swap(b);
+				put(b);
+
+				return true;
+			}
+
+			return buf.allocate(kClassSizes[i] - buf.length());
+		}
+	}
+
+	// Too big for the pool.
+	return buf.allocate(size - buf.length());
+}
+
+void string::buffer_pool::put(buffer& buf)
+{
+	size_t capacity = buf.capacity();
+
+	// Don't keep buffers which are too big.
+	if (capacity <= 2 * kClassSizes[kNumberClasses - 1]) {
+		// Find the biggest size class which fits in the buffer.
+		for (unsigned i = kNumberClasses; i > 0; i--) {
+			if (capacity >= kClassSizes[i - 1]) {
+				if (_M_used[i - 1] < kMaxFreeBuffers) {
+					// The free slots of the pool have no storage.
+					buf.clear();
+					buf.swap(_M_buffers[i - 1][_M_used[i - 1]++]);
+
+					return;
+				}
+
+				break;
+			}
+		}
+	}
+
+	buf.free();
+}
@@ -0,0 +1,64 @@
+#ifndef STRING_BUFFER_POOL_H
+#define STRING_BUFFER_POOL_H
+
+#include "string/buffer.h"
+
+namespace string {
+	// Pool of buffers of fixed sizes (size classes). The buffers are lent by
+	// swapping their storage, so borrowing and releasing a buffer don't
+	// allocate memory once the pool is warm.
+	class buffer_pool {
+		public:
+			static const unsigned kNumberClasses = 3;
+			static const size_t kClassSizes[kNumberClasses];
+
+			// Maximum number of free buffers per size class.
+			static const size_t kMaxFreeBuffers = 256;
+
+			// Constructor.
+			buffer_pool();
+
+			// Destructor.
+			~buffer_pool();
+
+			// Create.
+			bool create();
+
+			// Get buffer (with at least 'size' bytes available).
+			bool get(buffer& buf, size_t size);
+
+			// Release buffer (the storage is returned to the pool or freed).
+			void put(buffer& buf);
+
+			// Get number of free buffers of a size class.
+			size_t count(unsigned sizeclass) const;
+
+		private:
+			buffer* _M_buffers[kNumberClasses];
+			size_t _M_used[kNumberClasses];
+	};
+
+	inline buffer_pool::buffer_pool()
+	{
+		for (unsigned i = 0; i < kNumberClasses; i++) {
+			_M_buffers[i] = NULL;
+			_M_used[i] = 0;
+		}
+	}
+
+	inline buffer_pool::~buffer_pool()
+	{
+		for (unsigned i = 0; i < kNumberClasses; i++) {
+			if (_M_buffers[i]) {
+				delete [] _M_buffers[i];
+			}
+		}
+	}
+
+	inline size_t buffer_pool::count(unsigned sizeclass) const
+	{
+		return _M_used[sizeclass];
+	}
+}
+
+#endif // STRING_BUFFER_POOL_H
@@ -0,0 +1,355 @@
+#include <stdint.h>
+#include "string/scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define HAVE_X86_SIMD 1
+	#include <immintrin.h>
+#endif
+
+static inline bool is_token(unsigned char c)
+{
+	if ((c <= ' ') || (c >= 127)) {
+		return false;
+	}
+
+	switch (c) {
+		case '(':
+		case ')':
+		case '<':
+		case '>':
+		case '@':
+		case ',':
+		case ';':
+		case ':':
+		case '\\':
+		case '"':
+		case '/':
+		case '[':
+		case ']':
+		case '?':
+		case '=':
+		case '{':
+		case '}':
+			return false;
+		default:
+			return true;
+	}
+}
+
+static inline bool is_field_content(unsigned char c)
+{
+	return ((c > ' ') && (c != 127));
+}
+
+static inline bool is_path(unsigned char c)
+{
+	return ((c > ' ') && (c != '?') && (c != '#'));
+}
+
+static inline bool is_query(unsigned char c)
+{
+	if (((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9'))) {
+		return true;
+	}
+
+	switch (c) {
+		// Unreserved.
+		case '-':
+		case '.':
+		case '_':
+		case '~':
+
+		// Sub-delimiters.
+		case '!':
+		case '$':
+		case '&':
+		case '\'':
+		case '(':
+		case ')':
+		case '*':
+		case '+':
+		case ',':
+		case ';':
+		case '=':
+			return true;
+		default:
+			return false;
+	}
+}
+
+static size_t token_scalar(const char* begin, const char* end)
+{
+	const char* ptr = begin;
+	while ((ptr < end) && (is_token((unsigned char) *ptr))) {
+		ptr++;
+	}
+
+	return ptr - begin;
+}
+
+static size_t field_content_scalar(const char* begin, const char* end)
+{
+	const char* ptr = begin;
+	while ((ptr < end) && (is_field_content((unsigned char) *ptr))) {
+		ptr++;
+	}
+
+	return ptr - begin;
+}
+
+static size_t path_scalar(const char* begin, const char* end)
+{
+	const char* ptr = begin;
+	while ((ptr < end) && (is_path((unsigned char) *ptr))) {
+		ptr++;
+	}
+
+	return ptr - begin;
+}
+
+static size_t query_scalar(const char* begin, const char* end)
+{
+	const char* ptr = begin;
+	while ((ptr < end) && (is_query((unsigned char) *ptr))) {
+		ptr++;
+	}
+
+	return ptr - begin;
+}
+
+string::scan::span_function string::scan::_M_token = token_scalar;
+string::scan::span_function string::scan::_M_field_content = field_content_scalar;
+string::scan::span_function string::scan::_M_path = path_scalar;
+string::scan::span_function string::scan::_M_query = query_scalar;
+
+#if HAVE_X86_SIMD
+	// SSE4.2: ranges of the characters which stop the scan (for the token
+	// and query sets the ranges include a few characters of the set, so
+	// they fit in 16 bytes).
+	static const char kTokenRanges[16] = {
+		'\0', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff'
+	};
+
+	static const char kFieldContentRanges[16] = {
+		'\0', ' ', '\x7f', '\x7f'
+	};
+
+	static const char kPathRanges[16] = {
+		'\0', ' ', '#', '#', '?', '?'
+	};
+
+	static const char kQueryRanges[16] = {
+		'\0', ' ', '"', '#', '%', '%', '/', '/', ':', '@', '[', '^', '`', '`', '{', '\xff'
+	};
+
+	__attribute__((target("sse4.2")))
+	static inline size_t span_sse42(const char* ranges, int len, const char* begin, const char* end)
+	{
+		const __m128i r = _mm_loadu_si128((const __m128i*) ranges);
+
+		const char* ptr = begin;
+		while (ptr + 16 <= end) {
+			const __m128i x = _mm_loadu_si128((const __m128i*) ptr);
+
+			int i = _mm_cmpestri(r, len, x, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+			if (i != 16) {
+				return (ptr - begin) + i;
+			}
+
+			ptr += 16;
+		}
+
+		return ptr - begin;
+	}
+
+	__attribute__((target("sse4.2")))
+	static size_t token_sse42(const char* begin, const char* end)
+	{
+		size_t n = span_sse42(kTokenRanges, 16, begin, end);
+		return ((begin + n + 16 > end) ? n + token_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("sse4.2")))
+	static size_t field_content_sse42(const char* begin, const char* end)
+	{
+		size_t n = span_sse42(kFieldContentRanges, 4, begin, end);
+		return ((begin + n + 16 > end) ? n + field_content_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("sse4.2")))
+	static size_t path_sse42(const char* begin, const char* end)
+	{
+		size_t n = span_sse42(kPathRanges, 6, begin, end);
+		return ((begin + n + 16 > end) ? n + path_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("sse4.2")))
+	static size_t query_sse42(const char* begin, const char* end)
+	{
+		size_t n = span_sse42(kQueryRanges, 16, begin, end);
+		return ((begin + n + 16 > end) ? n + query_scalar(begin + n, end) : n);
+	}
+
+	// AVX2: the token and query sets are looked up in a bitmap indexed by
+	// the low nibble (one bit per high nibble, characters >= 128 are not in
+	// the sets).
+	static uint8_t _M_token_bitmap[16];
+	static uint8_t _M_query_bitmap[16];
+
+	static void build_bitmap(bool (*in_set)(unsigned char), uint8_t* bitmap)
+	{
+		for (unsigned lo = 0; lo < 16; lo++) {
+			bitmap[lo] = 0;
+
+			for (unsigned hi = 0; hi < 8; hi++) {
+				if (in_set((unsigned char) ((hi << 4) | lo))) {
+					bitmap[lo] |= (1 << hi);
+				}
+			}
+		}
+	}
+
+	__attribute__((target("avx2")))
+	static inline size_t span_avx2(const uint8_t* bitmap, const char* begin, const char* end)
+	{
+		const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) bitmap));
+		const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+		                                      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i nibble = _mm256_set1_epi8(0x0f);
+		const __m256i zero = _mm256_setzero_si256();
+
+		const char* ptr = begin;
+		while (ptr + 32 <= end) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*) ptr);
+
+			__m256i row = _mm256_shuffle_epi8(table, _mm256_and_si256(x, nibble));
+			__m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+
+			unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), zero));
+			if (mask) {
+				return (ptr - begin) + __builtin_ctz(mask);
+			}
+
+			ptr += 32;
+		}
+
+		return ptr - begin;
+	}
+
+	// Characters > ' ' except 'c1' and 'c2'.
+	__attribute__((target("avx2")))
+	static inline size_t span_visible_avx2(char c1, char c2, const char* begin, const char* end)
+	{
+		const __m256i min = _mm256_set1_epi8('!');
+		const __m256i v1 = _mm256_set1_epi8(c1);
+		const __m256i v2 = _mm256_set1_epi8(c2);
+
+		const char* ptr = begin;
+		while (ptr + 32 <= end) {
+			const __m256i x = _mm256_loadu_si256((const __m256i*) ptr);
+
+			__m256i ok = _mm256_cmpeq_epi8(_mm256_max_epu8(x, min), x);
+			__m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(x, v1), _mm256_cmpeq_epi8(x, v2));
+
+			unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_andnot_si256(stop, ok)) ^ 0xffffffffu;
+			if (mask) {
+				return (ptr - begin) + __builtin_ctz(mask);
+			}
+
+			ptr += 32;
+		}
+
+		return ptr - begin;
+	}
+
+	__attribute__((target("avx2")))
+	static size_t token_avx2(const char* begin, const char* end)
+	{
+		size_t n = span_avx2(_M_token_bitmap, begin, end);
+		return ((begin + n + 32 > end) ? n + token_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("avx2")))
+	static size_t field_content_avx2(const char* begin, const char* end)
+	{
+		size_t n = span_visible_avx2('\x7f', '\x7f', begin, end);
+		return ((begin + n + 32 > end) ? n + field_content_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("avx2")))
+	static size_t path_avx2(const char* begin, const char* end)
+	{
+		size_t n = span_visible_avx2('?', '#', begin, end);
+		return ((begin + n + 32 > end) ? n + path_scalar(begin + n, end) : n);
+	}
+
+	__attribute__((target("avx2")))
+	static size_t query_avx2(const char* begin, const char* end)
+	{
+		size_t n = span_avx2(_M_query_bitmap, begin, end);
+		return ((begin + n + 32 > end) ? n + query_scalar(begin + n, end) : n);
+	}
+#endif // HAVE_X86_SIMD
+
+void string::scan::init()
+{
+	if (!select(AVX2)) {
+		select(SSE42);
+		return;
+	}
+
+#if HAVE_X86_SIMD
+	// Header field names are usually shorter than 32 bytes, which the AVX2
+	// scanner leaves to the scalar one: SSE4.2 is faster for them (see
+	// test/scan_bench.cpp).
+	if (__builtin_cpu_supports("sse4.2")) {
+		_M_token = token_sse42;
+	}
+#endif // HAVE_X86_SIMD
+}
+
+bool string::scan::select(implementation impl)
+{
+	switch (impl) {
+		case SCALAR:
+			_M_token = token_scalar;
+			_M_field_content = field_content_scalar;
+			_M_path = path_scalar;
+			_M_query = query_scalar;
+
+			return true;
+#if HAVE_X86_SIMD
+		case SSE42:
+			__builtin_cpu_init();
+
+			if (!__builtin_cpu_supports("sse4.2")) {
+				return false;
+			}
+
+			_M_token = token_sse42;
+			_M_field_content = field_content_sse42;
+			_M_path = path_sse42;
+			_M_query = query_sse42;
+
+			return true;
+		case AVX2:
+			__builtin_cpu_init();
+
+			if (!__builtin_cpu_supports("avx2")) {
+				return false;
+			}
+
+			build_bitmap(is_token, _M_token_bitmap);
+			build_bitmap(is_query, _M_query_bitmap);
+
+			_M_token = token_avx2;
+			_M_field_content = field_content_avx2;
+			_M_path = path_avx2;
+			_M_query = query_avx2;
+
+			return true;
+#endif // HAVE_X86_SIMD
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdlib.h>
+
+namespace string {
+	namespace scan {
+		enum implementation {
+			SCALAR,
+			SSE42,
+			AVX2
+		};
+
+		// Select the fastest implementation (AVX2, SSE4.2 or scalar) of each
+		// function for the CPU.
+		void init();
+
+		// Select an implementation (returns false if the CPU doesn't support
+		// it, the current one is kept).
+		bool select(implementation impl);
+
+		// Get length of the initial run of token characters (header field
+		// names).
+		size_t token(const char* begin, const char* end);
+
+		// Get length of the initial run of visible characters (header field
+		// values, without whitespace).
+		size_t field_content(const char* begin, const char* end);
+
+		// Get length of the initial run of path characters (up to whitespace,
+		// '?' or '#').
+		size_t path(const char* begin, const char* end);
+
+		// Get length of the initial run of unreserved characters and
+		// sub-delimiters (query and fragment).
+		size_t query(const char* begin, const char* end);
+
+		// The vectorized implementations might stop before a character which
+		// belongs to the set, but never skip a character which doesn't.
+		typedef size_t (*span_function)(const char* begin, const char* end);
+
+		extern span_function _M_token;
+		extern span_function _M_field_content;
+		extern span_function _M_path;
+		extern span_function _M_query;
+
+		inline size_t token(const char* begin, const char* end)
+		{
+			return _M_token(begin, end);
+		}
+
+		inline size_t field_content(const char* begin, const char* end)
+		{
+			return _M_field_content(begin, end);
+		}
+
+		inline size_t path(const char* begin, const char* end)
+		{
+			return _M_path(begin, end);
+		}
+
+		inline size_t query(const char* begin, const char* end)
+		{
+			return _M_query(begin, end);
+		}
+	}
+}
+
+#endif // SCAN_H
@@ -0,0 +1,278 @@
+// Benchmark of the lookup of standard header names (perfect hash) against
+// the binary search it replaced, on the header names sent by browsers. Both
+// lookups are checked to agree on the standard header names (in any case),
+// their prefixes and mutations and random names.
+//
+// Usage: headers_bench [iterations] (0: only check the lookups)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include "net/internet/http/headers.h"
+
+using net::internet::http::header_name;
+using net::internet::http::standard_header;
+
+static const unsigned kRuns = 5;
+
+// Header names of the requests sent by browsers.
+static const char* kChrome[] = {
+	"Host", "Connection", "Cache-Control", "sec-ch-ua", "sec-ch-ua-mobile",
+	"sec-ch-ua-platform", "Upgrade-Insecure-Requests", "User-Agent",
+	"Accept", "Sec-Fetch-Site", "Sec-Fetch-Mode", "Sec-Fetch-User",
+	"Sec-Fetch-Dest", "Accept-Encoding", "Accept-Language", "Cookie",
+	"If-None-Match", "If-Modified-Since", NULL
+};
+
+static const char* kFirefox[] = {
+	"Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+	"Referer", "Connection", "Cookie", "Upgrade-Insecure-Requests",
+	"Sec-Fetch-Dest", "Sec-Fetch-Mode", "Sec-Fetch-Site", "Priority",
+	"If-Modified-Since", "If-None-Match", "Cache-Control", NULL
+};
+
+static const char* kSafari[] = {
+	"Host", "Accept", "Sec-Fetch-Site", "Cookie", "Sec-Fetch-Dest",
+	"Accept-Language", "Sec-Fetch-Mode", "User-Agent", "Referer",
+	"Accept-Encoding", "Connection", NULL
+};
+
+static const char* kCurl[] = {
+	"Host", "User-Agent", "Accept", NULL
+};
+
+static const char** kBrowsers[] = {kChrome, kFirefox, kSafari, kCurl};
+static const char* kBrowserNames[] = {"chrome", "firefox", "safari", "curl"};
+
+// Gives access to the lookup and the table of standard headers.
+class lookup : public net::internet::http::headers {
+	public:
+		static unsigned char perfect_hash(const char* name, size_t len)
+		{
+			return search_standard_header(name, len);
+		}
+
+		static const standard_header* standard_headers()
+		{
+			return _M_standard_headers;
+		}
+};
+
+static unsigned errors;
+static unsigned long long checks;
+
+// Binary search of the standard header names (the previous implementation
+// of headers::search_standard_header()).
+static unsigned char binary_search(const char* name, size_t len)
+{
+	const standard_header* standard_headers = lookup::standard_headers();
+
+	int i = 0;
+	int j = header_name::NUMBER_STANDARD_HEADERS - 1;
+
+	while (i <= j) {
+		int pivot = (i + j) / 2;
+		int ret = strncasecmp(name, standard_headers[pivot].name, len);
+		if (ret < 0) {
+			j = pivot - 1;
+		} else if (ret == 0) {
+			if (len < standard_headers[pivot].len) {
+				j = pivot - 1;
+			} else if (len == standard_headers[pivot].len) {
+				return pivot;
+			} else {
+				i = pivot + 1;
+			}
+		} else {
+			i = pivot + 1;
+		}
+	}
+
+	return header_name::UNKNOWN;
+}
+
+static unsigned random_number(unsigned n)
+{
+	static unsigned long long state = 88172645463325252ULL;
+
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return (unsigned) (state % n);
+}
+
+static void check(const char* name, size_t len)
+{
+	unsigned char expected = binary_search(name, len);
+	unsigned char header = lookup::perfect_hash(name, len);
+
+	checks++;
+
+	if (header != expected) {
+		if (errors++ < 10) {
+			fprintf(stderr, "\"%.*s\": %u (binary search: %u).\n", (int) len, name, header, expected);
+		}
+	}
+}
+
+static bool check_lookups()
+{
+	const standard_header* standard_headers = lookup::standard_headers();
+
+	char name[header_name::MAX_LEN];
+
+	for (unsigned i = 0; i < header_name::NUMBER_STANDARD_HEADERS; i++) {
+		size_t len = standard_headers[i].len;
+
+		// As in the table.
+		memcpy(name, standard_headers[i].name, len);
+		check(name, len);
+
+		if (lookup::perfect_hash(name, len) != i) {
+			if (errors++ < 10) {
+				fprintf(stderr, "Standard header \"%s\" not found.\n", standard_headers[i].name);
+			}
+		}
+
+		// Lowercase, uppercase and mixed case.
+		for (size_t j = 0; j < len; j++) {
+			name[j] = (char) tolower((unsigned char) standard_headers[i].name[j]);
+		}
+
+		check(name, len);
+
+		for (size_t j = 0; j < len; j++) {
+			name[j] = (char) toupper((unsigned char) standard_headers[i].name[j]);
+		}
+
+		check(name, len);
+
+		for (unsigned k = 0; k < 100; k++) {
+			for (size_t j = 0; j < len; j++) {
+				unsigned char c = (unsigned char) standard_headers[i].name[j];
+				name[j] = (char) ((random_number(2) == 0) ? tolower(c) : toupper(c));
+			}
+
+			check(name, len);
+		}
+
+		// Prefixes and a character appended.
+		memcpy(name, standard_headers[i].name, len);
+		for (size_t j = 0; j < len; j++) {
+			check(name, j);
+		}
+
+		name[len] = 's';
+		check(name, len + 1);
+
+		// Single character mutations.
+		for (size_t j = 0; j < len; j++) {
+			for (unsigned c = 0x21; c < 0x7f; c++) {
+				memcpy(name, standard_headers[i].name, len);
+				name[j] = (char) c;
+				check(name, len);
+			}
+		}
+	}
+
+	// Random names.
+	static const char kCharacters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ-";
+
+	for (unsigned i = 0; i < 1000000; i++) {
+		size_t len = 1 + random_number(24);
+		for (size_t j = 0; j < len; j++) {
+			name[j] = kCharacters[random_number(sizeof(kCharacters) - 1)];
+		}
+
+		check(name, len);
+	}
+
+	// Header names of the browsers.
+	for (unsigned b = 0; b < sizeof(kBrowsers) / sizeof(kBrowsers[0]); b++) {
+		for (const char** n = kBrowsers[b]; *n; n++) {
+			check(*n, strlen(*n));
+		}
+	}
+
+	printf("%llu lookups compared, %u error(s).\n", checks, errors);
+
+	return (errors == 0);
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+// Look up the names 'iterations' times, return the best time per lookup
+// [nanoseconds].
+static double measure(unsigned char (*fn)(const char*, size_t), const char** names, unsigned iterations)
+{
+	size_t lens[64];
+	unsigned count = 0;
+	for (; names[count]; count++) {
+		lens[count] = strlen(names[count]);
+	}
+
+	double best = 0;
+
+	for (unsigned r = 0; r < kRuns; r++) {
+		unsigned found = 0;
+
+		double start = now();
+
+		for (unsigned i = 0; i < iterations; i++) {
+			for (unsigned j = 0; j < count; j++) {
+				found += (fn(names[j], lens[j]) != header_name::UNKNOWN);
+
+				// Don't let the compiler hoist the lookup.
+				__asm__ __volatile__("" : : "r" (names) : "memory");
+			}
+		}
+
+		double t = (now() - start) / ((double) iterations * count) * 1e9;
+
+		if ((r == 0) || (t < best)) {
+			best = t;
+		}
+
+		if (found == 0) {
+			return -1;
+		}
+	}
+
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned iterations = (argc > 1) ? (unsigned) atoi(argv[1]) : 200000;
+
+	if (!check_lookups()) {
+		return -1;
+	}
+
+	if (iterations == 0) {
+		return 0;
+	}
+
+	printf("%-8s %14s %14s\n", "", "binary search", "perfect hash");
+
+	for (unsigned b = 0; b < sizeof(kBrowsers) / sizeof(kBrowsers[0]); b++) {
+		double bs = measure(binary_search, kBrowsers[b], iterations);
+		double ph = measure(lookup::perfect_hash, kBrowsers[b], iterations);
+
+		printf("%-8s %11.1f ns %11.1f ns\n", kBrowserNames[b], bs, ph);
+	}
+
+	printf("Times per header name.\n");
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+// Benchmark of the overhead of the event loop statistics (net::loop_stats):
+// a loop dispatches the events of each wait to on_readable()/on_writable()
+// as tcp_server and tcp_connection do, with the statistics off and on.
+//
+// Usage: loop_stats_bench [waits]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "net/loop_stats.h"
+
+using net::loop_stats;
+
+static const unsigned kRuns = 5;
+
+// Events per wait.
+static const unsigned kEventsPerWait[] = {1, 8, 64};
+
+class handler {
+	public:
+		unsigned _M_calls;
+
+		handler()
+		{
+			_M_calls = 0;
+		}
+
+		virtual ~handler()
+		{
+		}
+
+		virtual bool on_readable();
+		virtual bool on_writable();
+};
+
+bool handler::on_readable()
+{
+	_M_calls++;
+
+	// Don't let the compiler optimize the call away.
+	__asm__ __volatile__("" : : "r" (this) : "memory");
+
+	return true;
+}
+
+bool handler::on_writable()
+{
+	_M_calls++;
+
+	__asm__ __volatile__("" : : "r" (this) : "memory");
+
+	return true;
+}
+
+// Same code as tcp_server::run() / post_events_wait() and
+// tcp_connection::on_readable() / on_writable().
+class loop {
+	public:
+		loop(bool collect_stats)
+		{
+			_M_collect_stats = collect_stats;
+			_M_wait_end = 0;
+		}
+
+		void run(handler* h, unsigned waits, unsigned nevents)
+		{
+			for (unsigned i = 0; i < waits; i++) {
+				post_events_wait(nevents);
+
+				for (unsigned j = 0; j < nevents; j++) {
+					readable(h);
+					writable(h);
+				}
+
+				if (_M_collect_stats) {
+					_M_stats.add_process_time(loop_stats::now() - _M_wait_end);
+				}
+			}
+		}
+
+		const loop_stats& stats() const
+		{
+			return _M_stats;
+		}
+
+	private:
+		loop_stats _M_stats;
+		bool _M_collect_stats;
+		uint64_t _M_wait_end;
+
+		void post_events_wait(unsigned nevents)
+		{
+			if (_M_collect_stats) {
+				_M_stats.add_wait(nevents);
+				_M_wait_end = loop_stats::now();
+			}
+		}
+
+		bool readable(handler* h)
+		{
+			if (!_M_collect_stats) {
+				return h->on_readable();
+			} else {
+				uint64_t start = loop_stats::now();
+				bool ret = h->on_readable();
+				_M_stats.add_readable(loop_stats::now() - start);
+
+				return ret;
+			}
+		}
+
+		bool writable(handler* h)
+		{
+			if (!_M_collect_stats) {
+				return h->on_writable();
+			} else {
+				uint64_t start = loop_stats::now();
+				bool ret = h->on_writable();
+				_M_stats.add_writable(loop_stats::now() - start);
+
+				return ret;
+			}
+		}
+};
+
+// Run the loop, return the best time per event [nanoseconds] (an event
+// is a call to on_readable() and a call to on_writable()).
+static double measure(bool collect_stats, unsigned waits, unsigned nevents)
+{
+	double best = 0;
+
+	for (unsigned r = 0; r < kRuns; r++) {
+		handler h;
+		loop l(collect_stats);
+
+		uint64_t start = loop_stats::now();
+		l.run(&h, waits, nevents);
+		double t = (double) (loop_stats::now() - start) / ((double) waits * nevents);
+
+		if ((r == 0) || (t < best)) {
+			best = t;
+		}
+
+		if ((h._M_calls != 2 * waits * nevents) || ((collect_stats) && (l.stats().iterations != waits))) {
+			fprintf(stderr, "Unexpected number of calls.\n");
+			return -1;
+		}
+	}
+
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned waits = (argc > 1) ? (unsigned) atoi(argv[1]) : 100000;
+	if (waits == 0) {
+		fprintf(stderr, "Invalid number of waits.\n");
+		return -1;
+	}
+
+	printf("%-8s %12s %12s %12s\n", "events", "off", "on", "overhead");
+
+	for (unsigned i = 0; i < sizeof(kEventsPerWait) / sizeof(kEventsPerWait[0]); i++) {
+		unsigned nevents = kEventsPerWait[i];
+
+		double off = measure(false, waits, nevents);
+		double on = measure(true, waits, nevents);
+
+		if ((off < 0) || (on < 0)) {
+			return -1;
+		}
+
+		printf("%-8u %9.1f ns %9.1f ns %9.1f ns\n", nevents, off, on, on - off);
+	}
+
+	printf("Times per event (on_readable() + on_writable()).\n");
+
+	return 0;
+}
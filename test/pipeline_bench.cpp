@@ -0,0 +1,175 @@
+// Benchmark of pipelined HTTP/1.1 requests: a client sends batches of
+// HEAD requests in a single write to a running server and reads the
+// responses (which have no body). The number of reads per batch shows
+// how many sends the server used.
+//
+// Usage: pipeline_bench host port path [depth] [seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const unsigned kMaxDepth = 256;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int connect_to(const char* host, unsigned short port)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(struct sockaddr_in));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		fprintf(stderr, "Invalid address %s.\n", host);
+		return -1;
+	}
+
+	int fd;
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		return -1;
+	}
+
+	if (connect(fd, (const struct sockaddr*) &addr, sizeof(struct sockaddr_in)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	int optval = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(int));
+
+	return fd;
+}
+
+// Read 'depth' responses, return the number of reads (-1 on error).
+static int read_responses(int fd, unsigned depth)
+{
+	static char buf[64 * 1024];
+
+	// End of the headers seen so far (the terminator might be split
+	// between two reads).
+	unsigned state = 0;
+
+	unsigned nresponses = 0;
+	int nreads = 0;
+
+	while (nresponses < depth) {
+		ssize_t ret;
+		if ((ret = recv(fd, buf, sizeof(buf), 0)) <= 0) {
+			return -1;
+		}
+
+		nreads++;
+
+		for (ssize_t i = 0; i < ret; i++) {
+			char c = buf[i];
+
+			if (c == ((state & 1) ? '\n' : '\r')) {
+				if (++state == 4) {
+					if (strncmp(buf, "HTTP/1.1 200", 12) != 0) {
+						if ((nresponses == 0) && (nreads == 1)) {
+							fprintf(stderr, "Unexpected response: %.*s\n", (int) (i + 1), buf);
+							return -1;
+						}
+					}
+
+					nresponses++;
+					state = 0;
+				}
+			} else {
+				state = (c == '\r') ? 1 : 0;
+			}
+		}
+	}
+
+	return nreads;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s host port path [depth] [seconds]\n", argv[0]);
+		return -1;
+	}
+
+	unsigned depth = (argc > 4) ? (unsigned) atoi(argv[4]) : 16;
+	if ((depth == 0) || (depth > kMaxDepth)) {
+		fprintf(stderr, "Invalid depth (1 - %u).\n", kMaxDepth);
+		return -1;
+	}
+
+	unsigned seconds = (argc > 5) ? (unsigned) atoi(argv[5]) : 5;
+
+	char request[1024];
+	int len = snprintf(request, sizeof(request), "HEAD %s HTTP/1.1\r\nHost: %s:%s\r\n\r\n", argv[3], argv[1], argv[2]);
+	if ((len < 0) || ((size_t) len >= sizeof(request))) {
+		fprintf(stderr, "Path too long.\n");
+		return -1;
+	}
+
+	// Batch of pipelined requests.
+	char* batch;
+	if ((batch = (char*) malloc(depth * len)) == NULL) {
+		return -1;
+	}
+
+	for (unsigned i = 0; i < depth; i++) {
+		memcpy(batch + (i * len), request, len);
+	}
+
+	int fd;
+	if ((fd = connect_to(argv[1], (unsigned short) atoi(argv[2]))) < 0) {
+		fprintf(stderr, "Couldn't connect to %s:%s.\n", argv[1], argv[2]);
+		free(batch);
+		return -1;
+	}
+
+	unsigned long long nbatches = 0;
+	unsigned long long nreads = 0;
+
+	double start = now();
+	double end = start + seconds;
+	double t;
+
+	do {
+		if (send(fd, batch, depth * len, 0) != (ssize_t) (depth * len)) {
+			fprintf(stderr, "Couldn't send the requests.\n");
+			break;
+		}
+
+		int ret;
+		if ((ret = read_responses(fd, depth)) < 0) {
+			fprintf(stderr, "Couldn't read the responses.\n");
+			break;
+		}
+
+		nbatches++;
+		nreads += ret;
+	} while ((t = now()) < end);
+
+	close(fd);
+	free(batch);
+
+	if (nbatches == 0) {
+		return -1;
+	}
+
+	t = now() - start;
+
+	printf("depth %u: %.0f req/s, %.2f reads per batch\n", depth, (nbatches * depth) / t, (double) nreads / nbatches);
+
+	return 0;
+}
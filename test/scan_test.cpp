@@ -0,0 +1,282 @@
+// Differential test of the implementations of string::scan (scalar,
+// SSE4.2 and AVX2) and of headers::parse() on top of them.
+//
+// Usage: scan_test [corpus...] (default: headers.txt)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string/scan.h"
+#include "string/buffer.h"
+#include "net/internet/http/headers.h"
+
+static const unsigned kNumberFunctions = 4;
+static const char* kFunctionNames[kNumberFunctions] = {"token", "field_content", "path", "query"};
+
+static const unsigned kNumberImplementations = 3;
+static const char* kImplementationNames[kNumberImplementations] = {"scalar", "sse4.2", "avx2"};
+
+// The SSE4.2 ranges of the token and query sets include a few characters of
+// the sets (the scan might stop before them), the rest must match the
+// scalar implementation exactly.
+static const bool kExact[kNumberImplementations][kNumberFunctions] = {
+	{true, true, true, true},
+	{false, true, true, false},
+	{true, true, true, true}
+};
+
+static const size_t kMaxLength = 16 * 1024;
+
+static const char kBrowserHeaders[] =
+	"Host: www.example.com\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+	"Accept-Language: en-US,en;q=0.5\r\n"
+	"Cookie: a=b; c=d; sessionid=abcdefghijklmnopqrstuvwxyz0123456789\r\n"
+	"Connection: keep-alive\r\n"
+	"\r\n";
+
+struct implementation {
+	bool supported;
+	string::scan::span_function functions[kNumberFunctions];
+};
+
+static implementation implementations[kNumberImplementations];
+
+static unsigned long long spans;
+static unsigned long long parses;
+static unsigned errors;
+
+static unsigned random_number(unsigned n)
+{
+	static unsigned long long state = 88172645463325252ULL;
+
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return (unsigned) (state % n);
+}
+
+static void use(unsigned impl)
+{
+	string::scan::select((string::scan::implementation) impl);
+}
+
+static bool load_implementations()
+{
+	for (unsigned i = 0; i < kNumberImplementations; i++) {
+		if ((implementations[i].supported = string::scan::select((string::scan::implementation) i))) {
+			implementations[i].functions[0] = string::scan::_M_token;
+			implementations[i].functions[1] = string::scan::_M_field_content;
+			implementations[i].functions[2] = string::scan::_M_path;
+			implementations[i].functions[3] = string::scan::_M_query;
+		}
+
+		printf("%s: %s\n", kImplementationNames[i], implementations[i].supported ? "tested" : "not supported by the CPU, skipped");
+	}
+
+	return implementations[0].supported;
+}
+
+// Compare the spans of all the implementations starting at every offset of
+// the data.
+static void check_spans(const char* name, const char* data, size_t len)
+{
+	for (size_t off = 0; off <= len; off++) {
+		const char* begin = data + off;
+		const char* end = data + len;
+
+		for (unsigned f = 0; f < kNumberFunctions; f++) {
+			size_t expected = implementations[0].functions[f](begin, end);
+
+			for (unsigned i = 1; i < kNumberImplementations; i++) {
+				if (!implementations[i].supported) {
+					continue;
+				}
+
+				size_t n = implementations[i].functions[f](begin, end);
+
+				spans++;
+
+				if ((n > expected) || ((kExact[i][f]) && (n != expected))) {
+					if (errors++ < 10) {
+						fprintf(stderr, "%s: %s %s at offset %lu: %lu (scalar: %lu).\n", name, kImplementationNames[i], kFunctionNames[f], (unsigned long) off, (unsigned long) n, (unsigned long) expected);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Parse the headers (in chunks of 'chunk' bytes, 0: at once) and dump the
+// result.
+static void parse(const char* data, size_t len, size_t chunk, bool ignore_errors, string::buffer& out)
+{
+	net::internet::http::headers headers(ignore_errors);
+
+	int ret;
+	if (chunk == 0) {
+		ret = headers.parse(data, len);
+	} else {
+		size_t l = 0;
+		do {
+			l = ((l + chunk < len) ? l + chunk : len);
+		} while (((ret = headers.parse(data, l)) == net::internet::http::headers::PARSE_NOT_END_OF_HEADER) && (l < len));
+	}
+
+	out.clear();
+	out.format("%d %lu\n", ret, (unsigned long) headers.size());
+	headers.serialize(out);
+}
+
+static void check_parse(const char* name, const char* data, size_t len)
+{
+	size_t chunk = ((random_number(2) == 0) ? 0 : 1 + random_number(64));
+	bool ignore_errors = (random_number(2) == 0);
+
+	string::buffer expected;
+	use(string::scan::SCALAR);
+	parse(data, len, chunk, ignore_errors, expected);
+
+	for (unsigned i = 1; i < kNumberImplementations; i++) {
+		if (!implementations[i].supported) {
+			continue;
+		}
+
+		string::buffer out;
+		use(i);
+		parse(data, len, chunk, ignore_errors, out);
+
+		parses++;
+
+		if ((out.length() != expected.length()) || (memcmp(out.data(), expected.data(), out.length()) != 0)) {
+			if (errors++ < 10) {
+				fprintf(stderr, "%s: headers::parse() differs with %s (chunk: %lu).\n", name, kImplementationNames[i], (unsigned long) chunk);
+			}
+		}
+	}
+}
+
+// Mutate data (characters which are interesting for the parsers).
+static void mutate(char* data, size_t len)
+{
+	static const char kCharacters[] = " \t\r\n:;,?#%/\"\\()<>@[]{}=\x7f\x80\xff";
+
+	if (len == 0) {
+		return;
+	}
+
+	unsigned count = random_number(4);
+	for (unsigned i = 0; i < count; i++) {
+		data[random_number(len)] = (random_number(2) == 0) ? (char) random_number(256) : kCharacters[random_number(sizeof(kCharacters) - 1)];
+	}
+}
+
+// Generate a request target.
+static size_t generate_target(char* data, size_t size)
+{
+	static const char kPath[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-._~!$&'()*+,;=:@/%";
+	static const char kQuery[] = "abcdefghijklmnopqrstuvwxyz0123456789-._~!$&'()*+,;=:@/?%";
+
+	size_t len = 0;
+	data[len++] = '/';
+
+	size_t n = random_number(200);
+	while ((n-- > 0) && (len < size)) {
+		data[len++] = kPath[random_number(sizeof(kPath) - 1)];
+	}
+
+	if ((random_number(2) == 0) && (len < size)) {
+		data[len++] = '?';
+
+		n = random_number(200);
+		while ((n-- > 0) && (len < size)) {
+			data[len++] = kQuery[random_number(sizeof(kQuery) - 1)];
+		}
+	}
+
+	if ((random_number(4) == 0) && (len < size)) {
+		data[len++] = '#';
+	}
+
+	return len;
+}
+
+int main(int argc, char** argv)
+{
+	if (!load_implementations()) {
+		return -1;
+	}
+
+	// Characters one by one.
+	for (unsigned c = 0; c < 256; c++) {
+		char data[64];
+		memset(data, c, sizeof(data));
+		check_spans("character", data, sizeof(data));
+	}
+
+	static char data[kMaxLength];
+	static char mutated[kMaxLength];
+
+	// Corpora given in the command line (default: headers.txt) and the
+	// headers of a browser.
+	const char* default_corpus = "headers.txt";
+	const char* const* corpora = (argc > 1) ? (const char* const*) argv + 1 : &default_corpus;
+	int ncorpora = (argc > 1) ? argc - 1 : 1;
+
+	for (int i = 0; i <= ncorpora; i++) {
+		const char* name;
+		size_t len;
+
+		if (i < ncorpora) {
+			name = corpora[i];
+
+			FILE* file;
+			if ((file = fopen(name, "rb")) == NULL) {
+				fprintf(stderr, "Couldn't open file %s.\n", name);
+				return -1;
+			}
+
+			len = fread(data, 1, sizeof(data), file);
+			fclose(file);
+		} else {
+			name = "browser";
+
+			len = sizeof(kBrowserHeaders) - 1;
+			memcpy(data, kBrowserHeaders, len);
+		}
+
+		check_spans(name, data, len);
+
+		for (unsigned j = 0; j < 5000; j++) {
+			memcpy(mutated, data, len);
+			mutate(mutated, len);
+
+			check_spans(name, mutated, len);
+			check_parse(name, mutated, len);
+		}
+	}
+
+	// Request targets.
+	for (unsigned i = 0; i < 50000; i++) {
+		size_t len = generate_target(data, 512);
+		mutate(data, len);
+
+		check_spans("target", data, len);
+	}
+
+	// Random bytes.
+	for (unsigned i = 0; i < 50000; i++) {
+		size_t len = random_number(128);
+		for (size_t j = 0; j < len; j++) {
+			data[j] = (char) random_number(256);
+		}
+
+		check_spans("random", data, len);
+	}
+
+	printf("%llu spans and %llu parses compared, %u error(s).\n", spans, parses, errors);
+
+	return (errors == 0) ? 0 : -1;
+}
@@ -0,0 +1,243 @@
+// Benchmark of the timing wheel (timer::timers) against the red-black tree
+// of timers it replaced (util::red_black_tree): insert, delete and expire.
+//
+// Usage: timers_bench [max timeout (milliseconds)]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "timer/timers.h"
+#include "util/red_black_tree.h"
+
+static const size_t kCounts[] = {100000, 500000, 1000000};
+
+// Default maximum timeout (the idle timers of the connections).
+static const unsigned kDefaultMaxTimeout = 60 * 1000; // [milliseconds]
+
+class handler : public timer::event_handler {
+	public:
+		size_t _M_expired;
+
+		handler()
+		{
+			_M_expired = 0;
+		}
+
+		bool on_timer(unsigned id)
+		{
+			_M_expired++;
+			return true;
+		}
+};
+
+// Timing wheel.
+class wheel : public timer::timers {
+	public:
+		void expire(unsigned current_msec)
+		{
+			handle_expired(current_msec);
+		}
+};
+
+// Red-black tree of timers (the previous implementation of timer::timers).
+class tree {
+	public:
+		struct entry {
+			unsigned msec;
+			timer::event_handler* handler;
+			unsigned id;
+
+			bool operator<(const entry& e) const
+			{
+				return ((int) (msec - e.msec) < 0);
+			}
+		};
+
+		typedef util::red_black_tree<entry>::iterator iterator;
+
+		bool add(unsigned msec, timer::event_handler* handler, unsigned id, iterator& it)
+		{
+			entry e;
+			e.msec = msec;
+			e.handler = handler;
+			e.id = id;
+
+			return _M_timers.insert(e, &it);
+		}
+
+		void del(iterator& it)
+		{
+			_M_timers.erase(it);
+		}
+
+		void expire(unsigned current_msec)
+		{
+			iterator it;
+
+			while (_M_timers.begin(it)) {
+				entry* e = it.data;
+
+				if ((int) (current_msec - e->msec) < 0) {
+					return;
+				}
+
+				e->handler->on_timer(e->id);
+
+				_M_timers.erase(it);
+			}
+		}
+
+	private:
+		util::red_black_tree<entry> _M_timers;
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static unsigned random_number(unsigned n)
+{
+	static unsigned long long state = 88172645463325252ULL;
+
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return (unsigned) (state % n);
+}
+
+// Times per timer [nanoseconds].
+struct result {
+	double insert;
+	double del;
+	double expire;
+	size_t expired;
+};
+
+static void run_wheel(const unsigned* timeouts, size_t count, unsigned max_timeout, result& res)
+{
+	wheel w;
+	handler h;
+	timer::timer* timers = new timer::timer[count];
+
+	unsigned start = 1000;
+	w.init(start);
+
+	for (size_t i = 0; i < count; i++) {
+		timers[i].handler = &h;
+		timers[i].id = i;
+	}
+
+	// Insert.
+	double t = now();
+	for (size_t i = 0; i < count; i++) {
+		w.add(timers[i], start + timeouts[i]);
+	}
+
+	res.insert = (now() - t) / count * 1e9;
+
+	// Delete.
+	t = now();
+	for (size_t i = 0; i < count; i++) {
+		w.del(timers[i]);
+	}
+
+	res.del = (now() - t) / count * 1e9;
+
+	for (size_t i = 0; i < count; i++) {
+		w.add(timers[i], start + timeouts[i]);
+	}
+
+	// Expire (the event loop checks the timers every millisecond).
+	t = now();
+	for (unsigned msec = start; msec <= start + max_timeout; msec++) {
+		w.expire(msec);
+	}
+
+	res.expire = (now() - t) / count * 1e9;
+	res.expired = h._M_expired;
+
+	delete [] timers;
+}
+
+static void run_tree(const unsigned* timeouts, size_t count, unsigned max_timeout, result& res)
+{
+	tree tr;
+	handler h;
+	tree::iterator* its = new tree::iterator[count];
+
+	unsigned start = 1000;
+
+	// Insert.
+	double t = now();
+	for (size_t i = 0; i < count; i++) {
+		tr.add(start + timeouts[i], &h, i, its[i]);
+	}
+
+	res.insert = (now() - t) / count * 1e9;
+
+	// Delete.
+	t = now();
+	for (size_t i = 0; i < count; i++) {
+		tr.del(its[i]);
+	}
+
+	res.del = (now() - t) / count * 1e9;
+
+	for (size_t i = 0; i < count; i++) {
+		tr.add(start + timeouts[i], &h, i, its[i]);
+	}
+
+	// Expire.
+	t = now();
+	for (unsigned msec = start; msec <= start + max_timeout; msec++) {
+		tr.expire(msec);
+	}
+
+	res.expire = (now() - t) / count * 1e9;
+	res.expired = h._M_expired;
+
+	delete [] its;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_timeout = (argc > 1) ? (unsigned) atoi(argv[1]) : kDefaultMaxTimeout;
+	if ((max_timeout == 0) || (max_timeout > timer::timers::kMaxTimeout)) {
+		fprintf(stderr, "Invalid maximum timeout %u.\n", max_timeout);
+		return -1;
+	}
+
+	printf("%-8s %8s %12s %12s %12s\n", "", "timers", "insert", "delete", "expire");
+
+	for (size_t i = 0; i < sizeof(kCounts) / sizeof(kCounts[0]); i++) {
+		size_t count = kCounts[i];
+
+		unsigned* timeouts = (unsigned*) malloc(count * sizeof(unsigned));
+		for (size_t j = 0; j < count; j++) {
+			timeouts[j] = 1 + random_number(max_timeout);
+		}
+
+		result w, t;
+		run_wheel(timeouts, count, max_timeout, w);
+		run_tree(timeouts, count, max_timeout, t);
+
+		free(timeouts);
+
+		printf("%-8s %8lu %9.1f ns %9.1f ns %9.1f ns\n", "wheel", (unsigned long) count, w.insert, w.del, w.expire);
+		printf("%-8s %8lu %9.1f ns %9.1f ns %9.1f ns\n", "rbtree", (unsigned long) count, t.insert, t.del, t.expire);
+
+		if ((w.expired != count) || (t.expired != count)) {
+			fprintf(stderr, "Expired timers: %lu (wheel), %lu (rbtree), expected %lu.\n", (unsigned long) w.expired, (unsigned long) t.expired, (unsigned long) count);
+			return -1;
+		}
+	}
+
+	printf("Times per timer.\n");
+
+	return 0;
+}
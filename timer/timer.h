@@ -1,6 +1,7 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <stdlib.h>
 #include "timer/event_handler.h"
 
 namespace timer {
@@ -9,25 +10,33 @@ namespace timer {
 		event_handler* handler;
 		unsigned id;
 
-		bool operator<(const timer& t) const;
-		bool operator==(const timer& t) const;
+		// Links in the slot of the timing wheel (intrusive, so adding and
+		// deleting a timer doesn't allocate memory).
+		timer* next;
+		timer** pprev;
+		unsigned slot;
 
-		int operator-(const timer& t) const;
+		// Constructor.
+		timer();
+
+		// Is the timer active?
+		bool active() const;
 	};
 
-	inline bool timer::operator<(const timer& t) const
+	inline timer::timer()
 	{
-		return ((int) (msec - t.msec) < 0);
-	}
+		msec = 0;
+		handler = NULL;
+		id = 0;
 
-	inline bool timer::operator==(const timer& t) const
-	{
-		return msec == t.msec;
+		next = NULL;
+		pprev = NULL;
+		slot = 0;
 	}
 
-	inline int timer::operator-(const timer& t) const
+	inline bool timer::active() const
 	{
-		return (int) (msec - t.msec);
+		return (pprev != NULL);
 	}
 }
 
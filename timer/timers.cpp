@@ -1,19 +1,115 @@
 #include <stdlib.h>
+#include <string.h>
 #include "timer/timers.h"
 
+timer::timers::timers()
+{
+	memset(_M_slots, 0, sizeof(_M_slots));
+	memset(_M_bitmaps, 0, sizeof(_M_bitmaps));
+
+	_M_current = 0;
+
+	_M_count = 0;
+
+	_M_expired = 0;
+}
+
 void timer::timers::handle_expired(unsigned current_msec)
 {
-	util::red_black_tree<timer>::iterator it;
+	while ((_M_count > 0) && ((int) (current_msec - _M_current) >= 0)) {
+		unsigned index = _M_current & kSlotMask;
 
-	while (_M_timers.begin(it)) {
-		timer* t = it.data;
+		// If the first level has wrapped around...
+		if (index == 0) {
+			cascade();
+		}
 
-		if (current_msec < t->msec) {
-			return;
+		// Expire the timers of the current slot.
+		timer* t;
+		while ((t = _M_slots[index]) != NULL) {
+			unlink(t);
+
+			_M_expired++;
+
+			t->handler->on_timer(t->id);
 		}
 
-		t->handler->on_timer(t->id);
+		// Skip to the next non-empty slot of the first level (or to the
+		// beginning of the next round).
+		uint64_t bitmap = _M_bitmaps[0] & ~((2ULL << index) - 1);
+		if (bitmap) {
+			_M_current = (_M_current & ~kSlotMask) + __builtin_ctzll(bitmap);
+		} else {
+			_M_current = (_M_current | kSlotMask) + 1;
+		}
+	}
 
-		_M_timers.erase(it);
+	// The slots up to the current millisecond are empty.
+	_M_current = current_msec + 1;
+}
+
+void timer::timers::link(timer* t)
+{
+	unsigned msec = t->msec;
+	unsigned delta = msec - _M_current;
+
+	// If the timer has already expired, it goes in the current slot.
+	if ((int) delta < 0) {
+		msec = _M_current;
+		delta = 0;
+	} else if (delta > kMaxTimeout) {
+		msec = _M_current + kMaxTimeout;
+		delta = kMaxTimeout;
+	}
+
+	unsigned level = 0;
+	while (delta >= (1U << ((level + 1) * kSlotBits))) {
+		level++;
+	}
+
+	unsigned index = (msec >> (level * kSlotBits)) & kSlotMask;
+	unsigned slot = (level << kSlotBits) + index;
+
+	if ((t->next = _M_slots[slot]) != NULL) {
+		t->next->pprev = &t->next;
+	} else {
+		_M_bitmaps[level] |= (1ULL << index);
+	}
+
+	_M_slots[slot] = t;
+	t->pprev = &_M_slots[slot];
+	t->slot = slot;
+
+	_M_count++;
+}
+
+void timer::timers::cascade()
+{
+	for (unsigned level = 1; level < kLevels; level++) {
+		unsigned index = (_M_current >> (level * kSlotBits)) & kSlotMask;
+		unsigned slot = (level << kSlotBits) + index;
+
+		// Move the timers of the current slot of this level to the lower
+		// levels.
+		timer* t = _M_slots[slot];
+
+		_M_slots[slot] = NULL;
+		_M_bitmaps[level] &= ~(1ULL << index);
+
+		while (t) {
+			timer* next = t->next;
+
+			_M_count--;
+
+			link(t);
+
+			t = next;
+		}
+
+		// If this level hasn't wrapped around, the upper levels don't have
+		// to be cascaded.
+		if (index != 0) {
+			return;
+		}
 	}
 }
@@ -1,59 +1,122 @@
 #ifndef TIMERS_H
 #define TIMERS_H
 
+#include <stdint.h>
 #include "timer/timer.h"
-#include "util/red_black_tree.h"
 
 namespace timer {
+	// Hierarchical timing wheel: kLevels wheels of kSlots slots, the slots of
+	// the level n span 64^n milliseconds. Adding and deleting a timer are
+	// O(1); the timers of the upper levels are moved down (cascaded) when the
+	// first level wraps around.
 	class timers {
 		public:
+			static const unsigned kSlotBits = 6;
+			static const unsigned kSlots = 1 << kSlotBits;
+			static const unsigned kSlotMask = kSlots - 1;
+			static const unsigned kLevels = 5;
+
+			// Maximum timeout (later timers are clamped).
+			static const unsigned kMaxTimeout = (1 << (kLevels * kSlotBits)) - 1; // [milliseconds]
+
 			// Constructor.
 			timers();
 
 			// Destructor.
 			~timers();
 
-			// Add timer.
-			bool add(unsigned msec, event_handler* handler, unsigned id, util::red_black_tree<timer>::iterator& it);
-			bool add(const timer& t, util::red_black_tree<timer>::iterator& it);
+			// Initialize.
+			void init(unsigned current_msec);
+
+			// Add timer (if the timer is already active, it is rescheduled).
+			void add(timer& t, unsigned msec);
 
 			// Delete timer.
-			void del(util::red_black_tree<timer>::iterator& it);
+			void del(timer& t);
+
+			// Get number of active timers.
+			size_t count() const;
+
+			// Get number of expired timers.
+			unsigned long long expired() const;
 
 		protected:
 			// Handle expired.
 			void handle_expired(unsigned current_msec);
 
 		private:
-			util::red_black_tree<timer> _M_timers;
+			timer* _M_slots[kLevels * kSlots];
+
+			// Non-empty slots (one bit per slot).
+			uint64_t _M_bitmaps[kLevels];
+
+			// Next millisecond to be processed.
+			unsigned _M_current;
+
+			size_t _M_count;
+
+			unsigned long long _M_expired;
+
+			// Link timer.
+			void link(timer* t);
+
+			// Unlink timer.
+			void unlink(timer* t);
+
+			// Cascade timers.
+			void cascade();
 	};
 
-	inline timers::timers()
+	inline timers::~timers()
 	{
 	}
 
-	inline timers::~timers()
+	inline void timers::init(unsigned current_msec)
 	{
+		_M_current = current_msec;
 	}
 
-	inline bool timers::add(unsigned msec, event_handler* handler, unsigned id, util::red_black_tree<timer>::iterator& it)
+	inline void timers::add(timer& t, unsigned msec)
 	{
-		timer t;
+		if (t.active()) {
+			unlink(&t);
+		}
+
 		t.msec = msec;
-		t.handler = handler;
-		t.id = id;
 
-		return _M_timers.insert(t, &it);
+		link(&t);
+	}
+
+	inline void timers::del(timer& t)
+	{
+		if (t.active()) {
+			unlink(&t);
+		}
 	}
 
-	inline bool timers::add(const timer& t, util::red_black_tree<timer>::iterator& it)
+	inline size_t timers::count() const
 	{
-		return _M_timers.insert(t, &it);
+		return _M_count;
 	}
 
-	inline void timers::del(util::red_black_tree<timer>::iterator& it)
+	inline unsigned long long timers::expired() const
 	{
-		_M_timers.erase(it);
+		return _M_expired;
+	}
+
+	inline void timers::unlink(timer* t)
+	{
+		if ((*t->pprev = t->next) != NULL) {
+			t->next->pprev = t->pprev;
+		} else if (!_M_slots[t->slot]) {
+			// The slot is now empty.
+			_M_bitmaps[t->slot >> kSlotBits] &= ~(1ULL << (t->slot & kSlotMask));
+		}
+
+		t->next = NULL;
+		t->pprev = NULL;
+
+		_M_count--;
 	}
 }
 
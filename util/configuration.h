@@ -260,6 +260,8 @@ namespace util {
 				case '_':
 				case '.':
 				case ':':
+				case '/':
+				case '+':
 					return true;
 				default:
 					return false;
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "util/ranges.h"
 
 void util::ranges::free()
@@ -32,3 +33,48 @@ bool util::ranges::add(off_t from, off_t to)
 
 	return true;
 }
+
+off_t util::ranges::length() const
+{
+	off_t len = 0;
+	for (size_t i = 0; i < _M_used; i++) {
+		len += (_M_ranges[i].to - _M_ranges[i].from + 1);
+	}
+
+	return len;
+}
+
+void util::ranges::coalesce()
+{
+	size_t i = 1;
+	while (i < _M_used) {
+		// Search a previous range which overlaps or is adjacent.
+		size_t j;
+		for (j = 0; j < i; j++) {
+			if ((_M_ranges[i].from <= _M_ranges[j].to + 1) && (_M_ranges[j].from <= _M_ranges[i].to + 1)) {
+				break;
+			}
+		}
+
+		if (j == i) {
+			i++;
+			continue;
+		}
+
+		if (_M_ranges[i].from < _M_ranges[j].from) {
+			_M_ranges[j].from = _M_ranges[i].from;
+		}
+
+		if (_M_ranges[i].to > _M_ranges[j].to) {
+			_M_ranges[j].to = _M_ranges[i].to;
+		}
+
+		// Remove the range.
+		if (i < --_M_used) {
+			memmove(&_M_ranges[i], &_M_ranges[i + 1], (_M_used - i) * sizeof(struct range));
+		}
+
+		// The merged range might overlap the ranges before it now.
+		i = 1;
+	}
+}
@@ -33,6 +33,13 @@ namespace util {
 			// Add range.
 			bool add(off_t from, off_t to);
 
+			// Get the total number of bytes of the ranges.
+			off_t length() const;
+
+			// Merge the ranges which overlap or are adjacent (into the
+			// first of them, the order of the others is kept).
+			void coalesce();
+
 		private:
 			static const size_t INITIAL_SIZE = 2;
 